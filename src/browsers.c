@@ -37,12 +37,15 @@
 #include "browsers.h"
 
 #include "error.h"
+#include "gacm.h"
 #include "settings.h"
 #include "util.h"
 #include "xmalloc.h"
 
-/* ###NOTE: The size of the list is proportional to the run time,
- * which makes this pretty slow */
+/* The user's browsers followed by the default ones, compiled into a
+ * single automaton so a user agent is scanned once against all of them.
+ * Entries keep the priority of their position within the lists */
+static GACM browsers_acm;
 
 static char ***browsers_hash = NULL;
 
@@ -296,6 +299,8 @@ free_browsers_hash (void) {
   if (conf.browsers_file) {
     free (conf.user_browsers_hash);
   }
+
+  acm_free (&browsers_acm);
 }
 
 static int
@@ -350,6 +355,21 @@ parse_browser_token (char ***list, char *line, int n) {
   conf.browsers_hash_idx++;
 }
 
+/* Compile the user's browsers, followed by the default ones, into the
+ * browsers automaton. */
+static void
+compile_browsers (void) {
+  size_t i;
+  int j;
+
+  acm_init (&browsers_acm);
+  for (j = 0; j < conf.browsers_hash_idx; ++j)
+    acm_add (&browsers_acm, conf.user_browsers_hash[j][0]);
+  for (i = 0; i < ARRAY_SIZE (browsers); ++i)
+    acm_add (&browsers_acm, browsers_hash[i][0]);
+  acm_build (&browsers_acm);
+}
+
 /* Parse our default array of browsers and put them on our hash including those
  * from the custom parsed browsers file.
  *
@@ -368,8 +388,10 @@ parse_browsers_file (void) {
     set_browser (browsers_hash, i, browsers[i][0], browsers[i][1]);
   }
 
-  if (!conf.browsers_file)
+  if (!conf.browsers_file) {
+    compile_browsers ();
     return;
+  }
 
   /* could not open browsers file */
   if ((file = fopen (conf.browsers_file, "r")) == NULL)
@@ -389,25 +411,8 @@ parse_browsers_file (void) {
     parse_browser_token (conf.user_browsers_hash, line, n);
   }
   fclose (file);
-}
 
-/* Determine if the user-agent is a crawler.
- *
- * On error or is not a crawler, 0 is returned.
- * If it is a crawler, 1 is returned . */
-int
-is_crawler (const char *agent) {
-  char type[BROWSER_TYPE_LEN];
-  char *browser, *a;
-
-  if (agent == NULL || *agent == '\0')
-    return 0;
-
-  if ((a = xstrdup (agent), browser = verify_browser (a, type)) != NULL)
-    free (browser);
-  free (a);
-
-  return strcmp (type, "Crawlers") == 0 ? 1 : 0;
+  compile_browsers ();
 }
 
 /* Return the Opera 15 and beyond.
@@ -531,37 +536,34 @@ parse_browser (char *match, char *type, int i, char ***hash) {
 }
 
 /* Given a user agent, determine the browser used.
- *
- * ###NOTE: The size of the list is proportional to the run time,
- * which makes this pretty slow
  *
  * On error, NULL is returned.
  * On success, a malloc'd  string containing the browser is returned. */
 char *
 verify_browser (char *str, char *type) {
+  const char *first = NULL;
   char *match = NULL, *token = NULL;
-  int i = 0;
-  size_t j = 0;
+  int idx = 0;
 
   if (str == NULL || *str == '\0')
     return NULL;
 
+  /* the first entry of all lists found within the agent */
+  idx = acm_first (&browsers_acm, str, &first);
+
   /* check user's list */
-  for (i = 0; i < conf.browsers_hash_idx; ++i) {
-    if ((match = strstr (str, conf.user_browsers_hash[i][0])) == NULL)
-      continue;
-    return parse_browser (match, type, i, conf.user_browsers_hash);
-  }
+  if (idx != -1 && idx < conf.browsers_hash_idx)
+    return parse_browser ((char *) first, type, idx, conf.user_browsers_hash);
 
   if ((match = check_http_crawler (str)) && (token = parse_crawler (str, match, type)))
     return token;
+  /* the agent may have been cut short while looking for a crawler */
+  if (match)
+    idx = acm_first (&browsers_acm, str, &first);
 
   /* fallback to default browser list */
-  for (j = 0; j < ARRAY_SIZE (browsers); ++j) {
-    if ((match = strstr (str, browsers_hash[j][0])) == NULL)
-      continue;
-    return parse_browser (match, type, j, browsers_hash);
-  }
+  if (idx != -1)
+    return parse_browser ((char *) first, type, idx - conf.browsers_hash_idx, browsers_hash);
 
   if (conf.unknowns_log)
     LOG_UNKNOWNS (("%-7s%s\n", "[BR]", str));
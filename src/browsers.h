@@ -41,7 +41,6 @@ typedef struct GBrowser_ {
 } GBrowser;
 
 char *verify_browser (char *str, char *browser_type);
-int is_crawler (const char *agent);
 void free_browsers_hash (void);
 void parse_browsers_file (void);
 
@@ -174,6 +174,12 @@ display_version (void) {
 #ifdef HAVE_LIBSSL
   fprintf (stdout, "  --with-openssl\n");
 #endif
+#ifdef HAVE_LIBZ
+  fprintf (stdout, "  --with-zlib\n");
+#endif
+#ifdef HAVE_LIBZSTD
+  fprintf (stdout, "  --with-zstd\n");
+#endif
 }
 
 /* Get the enumerated value given a string.
@@ -260,6 +260,12 @@ print_csv_summary (FILE * fp) {
   total = ht_get_excluded_ips ();
   fprintf (fp, fmt, i++, GENER_ID, total, OVERALL_EXCL_HITS);
 
+  /* prefiltered lines */
+  if (conf.prefilter_idx > 0) {
+    total = ht_get_prefiltered ();
+    fprintf (fp, fmt, i++, GENER_ID, total, OVERALL_PREFILTER);
+  }
+
   /* referrers */
   total = ht_get_size_datamap (REFERRERS);
   fprintf (fp, fmt, i++, GENER_ID, total, OVERALL_REF);
@@ -0,0 +1,168 @@
+/**
+ * gacm.c -- Aho-Corasick multi-pattern matcher
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gacm.h"
+
+#include "xmalloc.h"
+
+/* Append a new state to the automaton, without any transitions.
+ *
+ * On success, the new state is returned. */
+static uint32_t
+new_acm_state (GACM * acm) {
+  uint32_t s = acm->states;
+
+  if (acm->states == acm->size) {
+    acm->size *= 2;
+    acm->go = xrealloc (acm->go, acm->size * ACM_ALPHABET * sizeof (uint32_t));
+    acm->best = xrealloc (acm->best, acm->size * sizeof (int));
+  }
+
+  memset (acm->go + (size_t) s * ACM_ALPHABET, 0, ACM_ALPHABET * sizeof (uint32_t));
+  acm->best[s] = -1;
+  acm->states++;
+
+  return s;
+}
+
+/* Initialize an empty automaton made of its root state. */
+void
+acm_init (GACM * acm) {
+  memset (acm, 0, sizeof (*acm));
+  acm->size = 64;
+  acm->go = xmalloc (acm->size * ACM_ALPHABET * sizeof (uint32_t));
+  acm->best = xmalloc (acm->size * sizeof (int));
+  new_acm_state (acm);
+}
+
+/* Free all states and patterns of the given automaton. */
+void
+acm_free (GACM * acm) {
+  free (acm->go);
+  free (acm->best);
+  free (acm->fail);
+  free (acm->lens);
+  memset (acm, 0, sizeof (*acm));
+}
+
+/* Add a pattern to the automaton. Patterns are indexed in the order
+ * they are added and a lower index takes priority on a match.
+ * Note: acm_build() has to run once all patterns are added. */
+void
+acm_add (GACM * acm, const char *pattern) {
+  const unsigned char *p = (const unsigned char *) pattern;
+  uint32_t s = 0, next = 0;
+
+  for (; *p; ++p) {
+    /* state 0 is the root, thus never the target of a trie edge */
+    if ((next = acm->go[(size_t) s * ACM_ALPHABET + *p]) == 0) {
+      next = new_acm_state (acm);
+      acm->go[(size_t) s * ACM_ALPHABET + *p] = next;
+    }
+    s = next;
+  }
+
+  if (acm->best[s] == -1)
+    acm->best[s] = acm->patterns;
+
+  acm->lens = xrealloc (acm->lens, (acm->patterns + 1) * sizeof (size_t));
+  acm->lens[acm->patterns++] = strlen (pattern);
+}
+
+/* Compute the failure state of every state breadth-first and fold it
+ * into the transition table. Each state keeps the lowest pattern index
+ * that ends at it, or at any of its suffixes. */
+void
+acm_build (GACM * acm) {
+  uint32_t *queue = xmalloc (acm->states * sizeof (uint32_t));
+  uint32_t head = 0, tail = 0, s = 0, t = 0, f = 0;
+  int c = 0;
+
+  acm->fail = xrealloc (acm->fail, acm->states * sizeof (uint32_t));
+  acm->fail[0] = 0;
+
+  for (c = 0; c < ACM_ALPHABET; ++c) {
+    if ((t = acm->go[c]) == 0)
+      continue;
+    acm->fail[t] = 0;
+    queue[tail++] = t;
+  }
+
+  while (head < tail) {
+    s = queue[head++];
+    f = acm->fail[s];
+    if (acm->best[f] != -1 && (acm->best[s] == -1 || acm->best[f] < acm->best[s]))
+      acm->best[s] = acm->best[f];
+
+    for (c = 0; c < ACM_ALPHABET; ++c) {
+      t = acm->go[(size_t) s * ACM_ALPHABET + c];
+      if (t == 0) {
+        acm->go[(size_t) s * ACM_ALPHABET + c] = acm->go[(size_t) f * ACM_ALPHABET + c];
+        continue;
+      }
+      acm->fail[t] = acm->go[(size_t) f * ACM_ALPHABET + c];
+      queue[tail++] = t;
+    }
+  }
+
+  free (queue);
+  free (acm->fail);
+  acm->fail = NULL;
+}
+
+/* Find the pattern with the lowest index that occurs within the given
+ * string, the same one a strstr() over each pattern, in order, would
+ * find first.
+ *
+ * If no pattern occurs, -1 is returned.
+ * Otherwise, the index of the pattern is returned and match points to
+ * its first occurrence within the string. */
+int
+acm_first (const GACM * acm, const char *str, const char **match) {
+  const unsigned char *p = (const unsigned char *) str;
+  uint32_t s = 0;
+  int best = acm->best[0];
+
+  /* an empty pattern occurs at the beginning */
+  *match = best == -1 ? NULL : str;
+  for (; *p && best != 0; ++p) {
+    s = acm->go[(size_t) s * ACM_ALPHABET + *p];
+    /* only the first occurrence of a better pattern is kept */
+    if (acm->best[s] != -1 && (best == -1 || acm->best[s] < best)) {
+      best = acm->best[s];
+      *match = (const char *) p - acm->lens[best] + 1;
+    }
+  }
+
+  return best;
+}
@@ -0,0 +1,57 @@
+/**
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GACM_H_INCLUDED
+#define GACM_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ACM_ALPHABET 256
+
+/* Aho-Corasick automaton over a list of patterns. The goto and failure
+ * functions are folded into a single transition table, thus a string
+ * is matched against all patterns in one pass over it */
+typedef struct GACM_ {
+  uint32_t *go;                 /* ACM_ALPHABET transitions per state */
+  int *best;                    /* lowest pattern index ending at a state */
+  uint32_t *fail;               /* failure state, used while building */
+  size_t *lens;                 /* length of each pattern */
+  uint32_t states;              /* number of states */
+  uint32_t size;                /* number of states allocated */
+  int patterns;                 /* number of patterns */
+} GACM;
+
+int acm_first (const GACM * acm, const char *str, const char **match);
+void acm_add (GACM * acm, const char *pattern);
+void acm_build (GACM * acm);
+void acm_free (GACM * acm);
+void acm_init (GACM * acm);
+
+#endif // for #ifndef GACM_H
@@ -0,0 +1,210 @@
+/**
+ * gagent.c -- user agent classification cache
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gagent.h"
+
+#include "error.h"
+#include "xmalloc.h"
+
+static GAgentCache agent_cache;
+
+/* Allocate the slots of the user agent cache. */
+void
+init_agent_cache (void) {
+  uint32_t i;
+
+  memset (&agent_cache, 0, sizeof (agent_cache));
+  agent_cache.slots = xcalloc (AGENT_CACHE_SIZE, sizeof (GAgentSlot));
+  for (i = 0; i < AGENT_CACHE_LOCKS; ++i) {
+    if (pthread_mutex_init (&(agent_cache.locks[i]), NULL))
+      FATAL ("Failed init thread mutex");
+  }
+}
+
+/* Drop the user agent and the classification held by the given slot. */
+static void
+clear_agent_slot (GAgentSlot * slot) {
+  free (slot->agent);
+  free (slot->browser);
+  free (slot->os);
+  memset (slot, 0, sizeof (*slot));
+}
+
+/* Free the user agent cache. */
+void
+free_agent_cache (void) {
+  uint32_t i;
+
+  if (agent_cache.slots == NULL)
+    return;
+
+  for (i = 0; i < AGENT_CACHE_SIZE; ++i)
+    clear_agent_slot (&agent_cache.slots[i]);
+  free (agent_cache.slots);
+  agent_cache.slots = NULL;
+
+  for (i = 0; i < AGENT_CACHE_LOCKS; ++i)
+    pthread_mutex_destroy (&agent_cache.locks[i]);
+}
+
+/* Get the number of cache hits and misses so far. */
+void
+agent_cache_stats (uint64_t * hits, uint64_t * misses) {
+  uint32_t i;
+
+  *hits = *misses = 0;
+  for (i = 0; i < AGENT_CACHE_LOCKS; ++i) {
+    pthread_mutex_lock (&agent_cache.locks[i]);
+    *hits += agent_cache.hits[i];
+    *misses += agent_cache.misses[i];
+    pthread_mutex_unlock (&agent_cache.locks[i]);
+  }
+}
+
+/* Lock the slot the given user agent maps to, taking the slot over if
+ * it holds a different agent. The lock is held upon return.
+ *
+ * On success, the locked slot is returned. */
+static GAgentSlot *
+lock_agent_slot (const char *agent, uint32_t hash) {
+  GAgentSlot *slot = &agent_cache.slots[hash & (AGENT_CACHE_SIZE - 1)];
+  uint32_t lock = hash & (AGENT_CACHE_LOCKS - 1);
+
+  pthread_mutex_lock (&agent_cache.locks[lock]);
+  /* the hash may collide, thus the agent is compared as well */
+  if (slot->agent && slot->hash == hash && !strcmp (slot->agent, agent))
+    return slot;
+
+  clear_agent_slot (slot);
+  slot->agent = xstrdup (agent);
+  slot->hash = hash;
+
+  return slot;
+}
+
+/* Release the lock of a slot taken through lock_agent_slot(). */
+static void
+unlock_agent_slot (uint32_t hash) {
+  pthread_mutex_unlock (&agent_cache.locks[hash & (AGENT_CACHE_LOCKS - 1)]);
+}
+
+/* Classify the browser of the agent held by the given slot, unless it
+ * was classified already. */
+static void
+set_slot_browser (GAgentSlot * slot, uint32_t hash) {
+  uint32_t lock = hash & (AGENT_CACHE_LOCKS - 1);
+  char *agent = NULL;
+
+  if (slot->has_browser) {
+    agent_cache.hits[lock]++;
+    return;
+  }
+  agent_cache.misses[lock]++;
+
+  /* verify_browser() may write into the agent it is given */
+  agent = xstrdup (slot->agent);
+  slot->browser = verify_browser (agent, slot->browser_type);
+  slot->has_browser = 1;
+  free (agent);
+}
+
+/* Classify the operating system of the agent held by the given slot,
+ * unless it was classified already. */
+static void
+set_slot_os (GAgentSlot * slot, uint32_t hash) {
+  uint32_t lock = hash & (AGENT_CACHE_LOCKS - 1);
+  char *agent = NULL;
+
+  if (slot->has_os) {
+    agent_cache.hits[lock]++;
+    return;
+  }
+  agent_cache.misses[lock]++;
+
+  /* verify_os() may write into the agent it is given */
+  agent = xstrdup (slot->agent);
+  slot->os = verify_os (agent, slot->os_type);
+  slot->has_os = 1;
+  free (agent);
+}
+
+/* Get the browser and browser type/category of the given user agent.
+ * Both strings are allocated off the given arena. */
+void
+get_agent_browser (GArena * arena, const char *agent, uint32_t hash, char **browser,
+                   char **type) {
+  GAgentSlot *slot = lock_agent_slot (agent, hash);
+
+  set_slot_browser (slot, hash);
+  *browser = slot->browser ? arena_strdup (arena, slot->browser) : NULL;
+  *type = arena_strdup (arena, slot->browser_type);
+
+  unlock_agent_slot (hash);
+}
+
+/* Get the operating system and OS type/category of the given user
+ * agent. Both strings are allocated off the given arena. */
+void
+get_agent_os (GArena * arena, const char *agent, uint32_t hash, char **os, char **type) {
+  GAgentSlot *slot = lock_agent_slot (agent, hash);
+
+  set_slot_os (slot, hash);
+  *os = slot->os ? arena_strdup (arena, slot->os) : NULL;
+  *type = arena_strdup (arena, slot->os_type);
+
+  unlock_agent_slot (hash);
+}
+
+/* Determine if the given user agent is a crawler.
+ *
+ * If it is not a crawler, 0 is returned.
+ * If it is a crawler, 1 is returned. */
+int
+is_agent_crawler (const char *agent, uint32_t hash) {
+  GAgentSlot *slot = NULL;
+  int bot = 0;
+
+  if (agent == NULL || *agent == '\0')
+    return 0;
+
+  slot = lock_agent_slot (agent, hash);
+  set_slot_browser (slot, hash);
+  bot = strcmp (slot->browser_type, "Crawlers") == 0;
+  unlock_agent_slot (hash);
+
+  return bot;
+}
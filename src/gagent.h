@@ -0,0 +1,72 @@
+/**
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GAGENT_H_INCLUDED
+#define GAGENT_H_INCLUDED
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "browsers.h"
+#include "garena.h"
+#include "opesys.h"
+
+#define AGENT_CACHE_SIZE  65536u        /* slots, a power of 2 */
+#define AGENT_CACHE_LOCKS 256u  /* slots are guarded by lock stripes */
+
+/* A user agent and its classification. The browser and the OS are
+ * classified only as they are needed */
+typedef struct GAgentSlot_ {
+  char *agent;
+  uint32_t hash;
+  char *browser;
+  char *os;
+  char browser_type[BROWSER_TYPE_LEN];
+  char os_type[OPESYS_TYPE_LEN];
+  uint8_t has_browser:1;
+  uint8_t has_os:1;
+} GAgentSlot;
+
+/* Direct-mapped cache of user agents keyed by their hash, thus each
+ * distinct agent is classified once unless its slot is taken over */
+typedef struct GAgentCache_ {
+  GAgentSlot *slots;
+  pthread_mutex_t locks[AGENT_CACHE_LOCKS];
+  uint64_t hits[AGENT_CACHE_LOCKS];     /* hits per lock stripe */
+  uint64_t misses[AGENT_CACHE_LOCKS];   /* misses per lock stripe */
+} GAgentCache;
+
+int is_agent_crawler (const char *agent, uint32_t hash);
+void agent_cache_stats (uint64_t * hits, uint64_t * misses);
+void free_agent_cache (void);
+void get_agent_browser (GArena * arena, const char *agent, uint32_t hash, char **browser, char **type);
+void get_agent_os (GArena * arena, const char *agent, uint32_t hash, char **os, char **type);
+void init_agent_cache (void);
+
+#endif // for #ifndef GAGENT_H
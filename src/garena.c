@@ -0,0 +1,154 @@
+/**
+ * garena.c -- a bump (arena) allocator
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "garena.h"
+
+#include "xmalloc.h"
+
+/* Allocate a new arena chunk able to hold at least the given number of
+ * bytes.
+ *
+ * On error, aborts if the chunk can't be malloc'd.
+ * On success, the new chunk is returned. */
+static GArenaChunk *
+new_arena_chunk (size_t size) {
+  GArenaChunk *chunk = xmalloc (sizeof (GArenaChunk));
+
+  chunk->size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+  chunk->data = xmalloc (chunk->size);
+  chunk->used = 0;
+  chunk->next = NULL;
+
+  return chunk;
+}
+
+/* Allocate the given number of bytes off the arena, starting at an offset
+ * multiple of align (a power of two). The memory is not initialized and
+ * it remains valid until the arena is reset or freed.
+ *
+ * On error, aborts if a new chunk can't be malloc'd.
+ * On success, a pointer to the allocated memory is returned. */
+static void *
+arena_alloc_aligned (GArena * arena, size_t size, size_t align) {
+  GArenaChunk *chunk = NULL;
+  size_t off = 0;
+
+  if (arena->cur == NULL)
+    arena->head = arena->cur = new_arena_chunk (size);
+
+  /* move on to the next chunks kept from a previous reset, or append a
+   * new one if none has enough room left */
+  chunk = arena->cur;
+  while ((off = (chunk->used + align - 1) & ~(align - 1)) > chunk->size ||
+         chunk->size - off < size) {
+    if (chunk->next == NULL)
+      chunk->next = new_arena_chunk (size);
+    chunk = chunk->next;
+  }
+  arena->cur = chunk;
+  chunk->used = off + size;
+
+  return chunk->data + off;
+}
+
+/* Allocate the given number of bytes off the arena, aligned to
+ * ARENA_ALIGN. The memory is not initialized and it remains valid until
+ * the arena is reset or freed.
+ *
+ * On error, aborts if a new chunk can't be malloc'd.
+ * On success, a pointer to the allocated memory is returned. */
+void *
+arena_alloc (GArena * arena, size_t size) {
+  return arena_alloc_aligned (arena, size, ARENA_ALIGN);
+}
+
+/* Copy at most len bytes from the given string into the arena.
+ *
+ * On success, the null-terminated copy is returned. */
+char *
+arena_strndup (GArena * arena, const char *s, size_t len) {
+  char *str = arena_alloc (arena, len + 1);
+
+  memcpy (str, s, len);
+  str[len] = '\0';
+
+  return str;
+}
+
+/* Copy len bytes from the given string into the arena right after the
+ * previous allocation, with no alignment padding. Meant for arenas that
+ * only hold strings.
+ *
+ * On success, the null-terminated copy is returned. */
+char *
+arena_strndup_packed (GArena * arena, const char *s, size_t len) {
+  char *str = arena_alloc_aligned (arena, len + 1, 1);
+
+  memcpy (str, s, len);
+  str[len] = '\0';
+
+  return str;
+}
+
+/* Copy the given string into the arena.
+ *
+ * On success, the copy is returned. */
+char *
+arena_strdup (GArena * arena, const char *s) {
+  return arena_strndup (arena, s, strlen (s));
+}
+
+/* Release all the memory allocated off the arena at once. Its chunks are
+ * kept so subsequent allocations don't hit malloc(3). */
+void
+arena_reset (GArena * arena) {
+  GArenaChunk *chunk = NULL;
+
+  for (chunk = arena->head; chunk; chunk = chunk->next)
+    chunk->used = 0;
+  arena->cur = arena->head;
+}
+
+/* Free all chunks of the given arena. */
+void
+arena_free (GArena * arena) {
+  GArenaChunk *chunk = arena->head, *next = NULL;
+
+  while (chunk) {
+    next = chunk->next;
+    free (chunk->data);
+    free (chunk);
+    chunk = next;
+  }
+  arena->head = arena->cur = NULL;
+}
@@ -0,0 +1,60 @@
+/**
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GARENA_H_INCLUDED
+#define GARENA_H_INCLUDED
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE 65536u /* bytes per arena chunk */
+#define ARENA_ALIGN      16u    /* alignment of every arena allocation */
+
+/* A chunk of memory from which arena allocations are carved out */
+typedef struct GArenaChunk_ {
+  char *data;
+  size_t size;                  /* bytes allocated for data */
+  size_t used;                  /* bytes handed out from data */
+  struct GArenaChunk_ *next;
+} GArenaChunk;
+
+/* Bump allocator. Memory is released all at once through arena_reset()
+ * while its chunks are kept around to be reused */
+typedef struct GArena_ {
+  GArenaChunk *head;
+  GArenaChunk *cur;             /* chunk currently allocating from */
+} GArena;
+
+char *arena_strdup (GArena * arena, const char *s);
+char *arena_strndup (GArena * arena, const char *s, size_t len);
+char *arena_strndup_packed (GArena * arena, const char *s, size_t len);
+void *arena_alloc (GArena * arena, size_t size);
+void arena_free (GArena * arena);
+void arena_reset (GArena * arena);
+
+#endif // for #ifndef GARENA_H
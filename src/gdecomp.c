@@ -0,0 +1,375 @@
+/**
+ * gdecomp.c -- decompress gzip/zstd logs on a dedicated thread
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+#include "gdecomp.h"
+
+#include "error.h"
+#include "xmalloc.h"
+
+/* Get the name of the given compression format. */
+const char *
+compression_name (GCompression type) {
+  switch (type) {
+  case COMPRESS_GZIP:
+    return "gzip";
+  case COMPRESS_ZSTD:
+    return "zstd";
+  default:
+    return "none";
+  }
+}
+
+/* Determine the compression format of a log given its first bytes.
+ *
+ * If not compressed, COMPRESS_NONE is returned.
+ * Otherwise, the compression format is returned. */
+GCompression
+detect_compression (const char *buf, size_t len) {
+  const unsigned char *b = (const unsigned char *) buf;
+
+  if (len >= 2 && b[0] == 0x1f && b[1] == 0x8b)
+    return COMPRESS_GZIP;
+  if (len >= 4 && b[0] == 0x28 && b[1] == 0xb5 && b[2] == 0x2f && b[3] == 0xfd)
+    return COMPRESS_ZSTD;
+  return COMPRESS_NONE;
+}
+
+/* Determine if goaccess was built with support for the given
+ * compression format.
+ *
+ * If supported, 1 is returned, else 0 is returned. */
+int
+has_decompressor (GCompression type) {
+  switch (type) {
+#ifdef HAVE_LIBZ
+  case COMPRESS_GZIP:
+    return 1;
+#endif
+#ifdef HAVE_LIBZSTD
+  case COMPRESS_ZSTD:
+    return 1;
+#endif
+  default:
+    return 0;
+  }
+}
+
+#if defined(HAVE_LIBZ) || defined(HAVE_LIBZSTD)
+/* Read the next compressed bytes from the log.
+ *
+ * On error, -1 is returned.
+ * On success, the number of bytes read is returned, 0 at the end. */
+static ssize_t
+read_compressed (int fd, unsigned char *buf, size_t len) {
+  ssize_t bytes = 0;
+
+  do {
+    bytes = read (fd, buf, len);
+  } while (bytes == -1 && errno == EINTR);
+
+  return bytes;
+}
+
+/* Wait for a free buffer to decompress into.
+ *
+ * If the reader is gone, NULL is returned.
+ * Otherwise, the buffer to fill is returned. */
+static char *
+get_free_buf (GDecomp * dc) {
+  char *buf = NULL;
+
+  pthread_mutex_lock (&dc->mutex);
+  while (dc->count == DECOMP_BUFS && !dc->stop)
+    pthread_cond_wait (&dc->not_full, &dc->mutex);
+  if (!dc->stop)
+    buf = dc->bufs[dc->tail];
+  pthread_mutex_unlock (&dc->mutex);
+
+  return buf;
+}
+
+/* Hand the buffer that was just filled over to the reader. */
+static void
+put_full_buf (GDecomp * dc, size_t len) {
+  if (len == 0)
+    return;
+
+  pthread_mutex_lock (&dc->mutex);
+  dc->lens[dc->tail] = len;
+  dc->tail = (dc->tail + 1) % DECOMP_BUFS;
+  dc->count++;
+  pthread_cond_signal (&dc->not_empty);
+  pthread_mutex_unlock (&dc->mutex);
+}
+#endif
+
+#ifdef HAVE_LIBZ
+/* Inflate a gzip log, including logs made of several concatenated
+ * gzip members.
+ *
+ * On error, 1 is returned.
+ * On success, 0 is returned. */
+static int
+inflate_log (GDecomp * dc, unsigned char *in) {
+  z_stream zs;
+  ssize_t bytes = 0;
+  char *out = NULL;
+  int ret = Z_OK, eof = 0;
+
+  memset (&zs, 0, sizeof (zs));
+  /* 15 + 32, maximum window size with gzip/zlib header detection */
+  if (inflateInit2 (&zs, 15 + 32) != Z_OK)
+    return 1;
+
+  while ((out = get_free_buf (dc)) != NULL) {
+    zs.next_out = (Bytef *) out;
+    zs.avail_out = DECOMP_BUF_SIZE;
+
+    while (zs.avail_out) {
+      if (zs.avail_in == 0 && !eof) {
+        if ((bytes = read_compressed (dc->fd, in, DECOMP_IN_SIZE)) < 0)
+          goto error;
+        eof = bytes == 0;
+        zs.next_in = in;
+        zs.avail_in = bytes;
+      }
+      if (zs.avail_in == 0 && eof)
+        break;
+
+      ret = inflate (&zs, Z_NO_FLUSH);
+      /* next gzip member, if any */
+      if (ret == Z_STREAM_END)
+        ret = inflateReset (&zs);
+      if (ret != Z_OK && ret != Z_BUF_ERROR)
+        goto error;
+      /* truncated log, no further progress can be made */
+      if (ret == Z_BUF_ERROR && eof && zs.avail_in == 0)
+        break;
+    }
+
+    put_full_buf (dc, DECOMP_BUF_SIZE - zs.avail_out);
+    if (zs.avail_out)
+      break;
+  }
+  inflateEnd (&zs);
+
+  return 0;
+
+error:
+  inflateEnd (&zs);
+  return 1;
+}
+#endif
+
+#ifdef HAVE_LIBZSTD
+/* Decompress a zstd log, frame after frame.
+ *
+ * On error, 1 is returned.
+ * On success, 0 is returned. */
+static int
+unzstd_log (GDecomp * dc, unsigned char *in) {
+  ZSTD_DStream *zds = NULL;
+  ZSTD_inBuffer zin = { in, 0, 0 };
+  ZSTD_outBuffer zout;
+  ssize_t bytes = 0;
+  size_t ret = 0;
+  char *out = NULL;
+  int eof = 0;
+
+  if ((zds = ZSTD_createDStream ()) == NULL)
+    return 1;
+
+  while ((out = get_free_buf (dc)) != NULL) {
+    zout.dst = out;
+    zout.size = DECOMP_BUF_SIZE;
+    zout.pos = 0;
+
+    while (zout.pos < zout.size) {
+      if (zin.pos == zin.size && !eof) {
+        if ((bytes = read_compressed (dc->fd, in, DECOMP_IN_SIZE)) < 0)
+          goto error;
+        eof = bytes == 0;
+        zin.size = bytes;
+        zin.pos = 0;
+      }
+      if (zin.pos == zin.size && eof)
+        break;
+
+      ret = ZSTD_decompressStream (zds, &zout, &zin);
+      if (ZSTD_isError (ret))
+        goto error;
+    }
+
+    put_full_buf (dc, zout.pos);
+    if (zout.pos < zout.size)
+      break;
+  }
+  ZSTD_freeDStream (zds);
+
+  return 0;
+
+error:
+  ZSTD_freeDStream (zds);
+  return 1;
+}
+#endif
+
+/* Decompressor thread - Decompress the whole log into the queue of
+ * buffers, waiting for the reader to drain them as needed. */
+static void *
+decomp_worker (void *ptr_data) {
+  GDecomp *dc = (GDecomp *) ptr_data;
+  unsigned char *in = xmalloc (DECOMP_IN_SIZE);
+  int ret = 1;
+
+  switch (dc->type) {
+#ifdef HAVE_LIBZ
+  case COMPRESS_GZIP:
+    ret = inflate_log (dc, in);
+    break;
+#endif
+#ifdef HAVE_LIBZSTD
+  case COMPRESS_ZSTD:
+    ret = unzstd_log (dc, in);
+    break;
+#endif
+  default:
+    break;
+  }
+  free (in);
+
+  pthread_mutex_lock (&dc->mutex);
+  dc->error = ret;
+  dc->done = 1;
+  pthread_cond_signal (&dc->not_empty);
+  pthread_mutex_unlock (&dc->mutex);
+
+  return NULL;
+}
+
+/* Copy up to len decompressed bytes into the given buffer, waiting for
+ * the decompressor thread if no buffer is ready yet.
+ *
+ * On error, -1 is returned.
+ * On success, the number of bytes copied is returned, 0 at the end of
+ * the log. */
+ssize_t
+decomp_read (GDecomp * dc, char *buf, size_t len) {
+  size_t avail = 0, n = 0;
+
+  pthread_mutex_lock (&dc->mutex);
+  while (dc->count == 0 && !dc->done)
+    pthread_cond_wait (&dc->not_empty, &dc->mutex);
+
+  if (dc->count == 0) {
+    pthread_mutex_unlock (&dc->mutex);
+    return dc->error ? -1 : 0;
+  }
+  pthread_mutex_unlock (&dc->mutex);
+
+  /* the head buffer belongs to the reader until it's handed back */
+  avail = dc->lens[dc->head] - dc->off;
+  n = len < avail ? len : avail;
+  memcpy (buf, dc->bufs[dc->head] + dc->off, n);
+  dc->off += n;
+
+  if (dc->off == dc->lens[dc->head]) {
+    pthread_mutex_lock (&dc->mutex);
+    dc->head = (dc->head + 1) % DECOMP_BUFS;
+    dc->count--;
+    dc->off = 0;
+    pthread_cond_signal (&dc->not_full);
+    pthread_mutex_unlock (&dc->mutex);
+  }
+
+  return n;
+}
+
+/* Start decompressing the log from the given file descriptor, which
+ * must be positioned at its beginning. */
+void
+start_decomp (GDecomp * dc, int fd, GCompression type) {
+  int i, th;
+
+  memset (dc, 0, sizeof (*dc));
+  dc->fd = fd;
+  dc->type = type;
+  for (i = 0; i < DECOMP_BUFS; ++i)
+    dc->bufs[i] = xmalloc (DECOMP_BUF_SIZE);
+
+  if (pthread_mutex_init (&(dc->mutex), NULL))
+    FATAL ("Failed init thread mutex");
+  if (pthread_cond_init (&(dc->not_empty), NULL))
+    FATAL ("Failed init thread condition");
+  if (pthread_cond_init (&(dc->not_full), NULL))
+    FATAL ("Failed init thread condition");
+
+  th = pthread_create (&(dc->thread), NULL, decomp_worker, dc);
+  if (th)
+    FATAL ("Return code from pthread_create(): %d", th);
+}
+
+/* Stop the decompressor thread, even if the log wasn't fully read, and
+ * release its buffers. */
+void
+stop_decomp (GDecomp * dc) {
+  int i;
+
+  pthread_mutex_lock (&dc->mutex);
+  dc->stop = 1;
+  pthread_cond_signal (&dc->not_full);
+  pthread_mutex_unlock (&dc->mutex);
+
+  pthread_join (dc->thread, NULL);
+
+  pthread_mutex_destroy (&dc->mutex);
+  pthread_cond_destroy (&dc->not_empty);
+  pthread_cond_destroy (&dc->not_full);
+
+  for (i = 0; i < DECOMP_BUFS; ++i)
+    free (dc->bufs[i]);
+}
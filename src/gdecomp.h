@@ -0,0 +1,79 @@
+/**
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GDECOMP_H_INCLUDED
+#define GDECOMP_H_INCLUDED
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define DECOMP_BUFS     4       /* decompressed buffers in flight */
+#define DECOMP_BUF_SIZE 1048576u        /* bytes per decompressed buffer */
+#define DECOMP_IN_SIZE  262144u /* compressed bytes read at once */
+
+/* Compression format of a log, detected by its magic bytes */
+typedef enum {
+  COMPRESS_NONE,
+  COMPRESS_GZIP,
+  COMPRESS_ZSTD,
+} GCompression;
+
+/* A compressed log decompressed by a dedicated thread into a queue of
+ * large buffers, which the line reader drains */
+typedef struct GDecomp_ {
+  int fd;
+  GCompression type;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t not_empty;     /* a decompressed buffer is ready */
+  pthread_cond_t not_full;      /* a buffer is free to decompress into */
+
+  char *bufs[DECOMP_BUFS];
+  size_t lens[DECOMP_BUFS];     /* bytes decompressed into each buffer */
+  int head;                     /* next buffer to drain */
+  int tail;                     /* next buffer to fill */
+  int count;                    /* buffers ready to drain */
+  size_t off;                   /* bytes drained from the head buffer */
+
+  uint8_t done:1;               /* decompressor reached the end of the log */
+  uint8_t error:1;              /* the log couldn't be decompressed */
+  uint8_t stop:1;               /* reader is gone, stop decompressing */
+} GDecomp;
+
+const char *compression_name (GCompression type);
+GCompression detect_compression (const char *buf, size_t len);
+int has_decompressor (GCompression type);
+ssize_t decomp_read (GDecomp * dc, char *buf, size_t len);
+void start_decomp (GDecomp * dc, int fd, GCompression type);
+void stop_decomp (GDecomp * dc);
+
+#endif // for #ifndef GDECOMP_H
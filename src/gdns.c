@@ -57,11 +57,24 @@
 #include "error.h"
 #include "gkhash.h"
 #include "goaccess.h"
+#include "persistence.h"
 #include "util.h"
 #include "xmalloc.h"
 
 GDnsThread gdns_thread;
 static GDnsQueue *gdns_queue;
+/* addresses queued or being resolved, keys are owned by this set */
+static khash_t (si08) * gdns_pending = NULL;
+/* resolved and failed lookups */
+static khash_t (sdns) * gdns_cache = NULL;
+/* IP => hostname, given a --dns-hosts-file */
+static khash_t (ss32) * gdns_hosts = NULL;
+static GDnsStats gdns_stat;
+/* addresses dequeued and not yet resolved */
+static int gdns_inflight = 0;
+
+static int resolve_dns (const char *ip, char **host);
+static GDnsResolver gdns_resolver = resolve_dns;
 
 /* Initialize the queue. */
 void
@@ -102,39 +115,22 @@ gqueue_destroy (GDnsQueue * q) {
   free (q);
 }
 
-/* Add at the end of the queue a string item.
+/* Add at the end of the queue a string item. The queue does not take
+ * ownership of the item.
  *
  * If the queue is full, -1 is returned.
  * If added to the queue, 0 is returned. */
 int
-gqueue_enqueue (GDnsQueue * q, const char *item) {
+gqueue_enqueue (GDnsQueue * q, char *item) {
   if (gqueue_full (q))
     return -1;
 
   q->tail = (q->tail + 1) % q->capacity;
-  strncpy (q->buffer[q->tail], item, sizeof (q->buffer[q->tail]));
-  q->buffer[q->tail][sizeof (q->buffer[q->tail]) - 1] = '\0';
+  q->buffer[q->tail] = item;
   q->size++;
   return 0;
 }
 
-/* Find a string item in the queue.
- *
- * If the queue is empty, or the item is not in the queue, 0 is returned.
- * If found, 1 is returned. */
-int
-gqueue_find (GDnsQueue * q, const char *item) {
-  int i;
-  if (gqueue_empty (q))
-    return 0;
-
-  for (i = 0; i < q->size; i++) {
-    if (strcmp (item, q->buffer[i]) == 0)
-      return 1;
-  }
-  return 0;
-}
-
 /* Remove a string item from the head of the queue.
  *
  * If the queue is empty, NULL is returned.
@@ -151,79 +147,329 @@ gqueue_dequeue (GDnsQueue * q) {
   return item;
 }
 
-/* Get the corresponding hostname given an IP address.
+/* Get the hostname of an IP address through the system resolver.
  *
- * On error, a string error message is returned.
- * On success, a malloc'd hostname is returned. */
-static char *
-reverse_host (const struct sockaddr *a, socklen_t length) {
-  char h[H_SIZE];
-  int flags, st;
-
-  flags = NI_NAMEREQD;
-  st = getnameinfo (a, length, h, H_SIZE, NULL, 0, flags);
-  if (!st)
-    return alloc_string (h);
-  return alloc_string (gai_strerror (st));
-}
-
-/* Determine if IPv4 or IPv6 and resolve.
- *
- * On error, NULL is returned.
- * On success, a malloc'd hostname is returned. */
-char *
-reverse_ip (char *str) {
+ * If the address is invalid, host is set to NULL and 1 is returned.
+ * If not resolved, host is set to the error message and 1 is returned.
+ * On success, host is set to the hostname and 0 is returned. */
+static int
+resolve_dns (const char *ip, char **host) {
   union {
     struct sockaddr addr;
     struct sockaddr_in6 addr6;
     struct sockaddr_in addr4;
   } a;
+  char h[H_SIZE];
+  socklen_t len = 0;
+  int st = 0;
 
-  if (str == NULL || *str == '\0')
-    return NULL;
-
+  *host = NULL;
   memset (&a, 0, sizeof (a));
-  if (1 == inet_pton (AF_INET, str, &a.addr4.sin_addr)) {
+  if (1 == inet_pton (AF_INET, ip, &a.addr4.sin_addr)) {
     a.addr4.sin_family = AF_INET;
-    return reverse_host (&a.addr, sizeof (a.addr4));
-  } else if (1 == inet_pton (AF_INET6, str, &a.addr6.sin6_addr)) {
+    len = sizeof (a.addr4);
+  } else if (1 == inet_pton (AF_INET6, ip, &a.addr6.sin6_addr)) {
     a.addr6.sin6_family = AF_INET6;
-    return reverse_host (&a.addr, sizeof (a.addr6));
+    len = sizeof (a.addr6);
+  } else {
+    return 1;
+  }
+
+  if ((st = getnameinfo (&a.addr, len, h, H_SIZE, NULL, 0, NI_NAMEREQD)) == 0) {
+    *host = alloc_string (h);
+    return 0;
+  }
+  *host = alloc_string (gai_strerror (st));
+
+  return 1;
+}
+
+/* Get the hostname of an IP address out of the --dns-hosts-file.
+ *
+ * If the address is invalid, host is set to NULL and 1 is returned.
+ * If not found, host is set to the error message and 1 is returned.
+ * On success, host is set to the hostname and 0 is returned. */
+static int
+resolve_hosts_file (const char *ip, char **host) {
+  unsigned char addr[sizeof (struct in6_addr)];
+  khint_t k;
+
+  *host = NULL;
+  if (1 != inet_pton (AF_INET, ip, addr) && 1 != inet_pton (AF_INET6, ip, addr))
+    return 1;
+
+  k = kh_get (ss32, gdns_hosts, ip);
+  if (k != kh_end (gdns_hosts)) {
+    *host = xstrdup (kh_val (gdns_hosts, k));
+    return 0;
   }
-  return NULL;
+  *host = alloc_string (gai_strerror (EAI_NONAME));
+
+  return 1;
+}
+
+/* Load an /etc/hosts-style file, an IP address followed by its
+ * hostname on each line, as the resolver. The first hostname of an
+ * address is kept.
+ *
+ * On error, it aborts. */
+static void
+load_hosts_file (const char *path) {
+  char line[H_SIZE * 2], *ip = NULL, *name = NULL, *save = NULL;
+  FILE *fp = NULL;
+  khint_t k;
+  int ret;
+
+  if ((fp = fopen (path, "r")) == NULL)
+    FATAL ("Unable to open the hosts file %s: %s", path, strerror (errno));
+
+  gdns_hosts = kh_init (ss32);
+  while (fgets (line, sizeof (line), fp) != NULL) {
+    line[strcspn (line, "#")] = '\0';
+    if ((ip = strtok_r (line, " \t\r\n", &save)) == NULL)
+      continue;
+    if ((name = strtok_r (NULL, " \t\r\n", &save)) == NULL)
+      continue;
+
+    k = kh_put (ss32, gdns_hosts, ip, &ret);
+    if (ret <= 0)
+      continue;
+    kh_key (gdns_hosts, k) = xstrdup (ip);
+    kh_val (gdns_hosts, k) = xstrdup (name);
+  }
+  fclose (fp);
+
+  gdns_resolver = resolve_hosts_file;
+}
+
+/* Get the lookup of the given IP address, whether it expired or not.
+ * The DNS mutex has to be held.
+ *
+ * If not cached, NULL is returned.
+ * On success, the cached entry is returned. */
+static GDnsEntry *
+get_dns_entry (const char *ip) {
+  khint_t k;
+
+  if (gdns_cache == NULL)
+    return NULL;
+
+  k = kh_get (sdns, gdns_cache, ip);
+  if (k == kh_end (gdns_cache))
+    return NULL;
+
+  return &kh_val (gdns_cache, k);
+}
+
+/* Determine if the given lookup is still within its TTL. Failed
+ * lookups expire sooner so they are retried.
+ *
+ * If expired, 0 is returned.
+ * If fresh, 1 is returned. */
+static int
+is_fresh_dns_entry (const GDnsEntry * entry) {
+  time_t ttl = entry->failed ? DNS_NEGATIVE_TTL : DNS_POSITIVE_TTL;
+  return entry->resolved + ttl > time (NULL);
+}
+
+/* Cache the lookup of the given IP address, done at the given time,
+ * taking over the host string. The DNS mutex has to be held, unless no
+ * resolver thread runs yet. */
+static void
+set_dns_entry (const char *ip, char *host, int failed, time_t resolved) {
+  GDnsEntry *entry = NULL;
+  khint_t k;
+  int ret;
+
+  if (gdns_cache == NULL) {
+    free (host);
+    return;
+  }
+
+  k = kh_put (sdns, gdns_cache, ip, &ret);
+  if (ret == -1) {
+    free (host);
+    return;
+  }
+
+  entry = &kh_val (gdns_cache, k);
+  if (ret == 0)
+    free (entry->host);
+  else
+    kh_key (gdns_cache, k) = xstrdup (ip);
+
+  entry->host = host;
+  entry->failed = failed ? 1 : 0;
+  entry->resolved = resolved;
+}
+
+/* Add an IP address to the queue unless its lookup is fresh or it is
+ * already pending. If the queue is full, wait for a slot if block is
+ * set, otherwise drop it. The DNS mutex has to be held. */
+static void
+enqueue_ip (const char *ip, int block) {
+  GDnsEntry *entry = NULL;
+  char *item = NULL;
+  khint_t k;
+  int ret;
+
+  while (gdns_queue != NULL) {
+    if ((entry = get_dns_entry (ip)) != NULL && is_fresh_dns_entry (entry)) {
+      gdns_stat.cached++;
+      return;
+    }
+    if (kh_get (si08, gdns_pending, ip) != kh_end (gdns_pending)) {
+      gdns_stat.pending++;
+      return;
+    }
+    if (!gqueue_full (gdns_queue))
+      break;
+
+    if (!block || !active_gdns) {
+      gdns_stat.dropped++;
+      return;
+    }
+    gdns_stat.waited++;
+    pthread_cond_wait (&gdns_thread.not_full, &gdns_thread.mutex);
+  }
+  if (gdns_queue == NULL)
+    return;
+
+  item = xstrdup (ip);
+  k = kh_put (si08, gdns_pending, item, &ret);
+  kh_val (gdns_pending, k) = 1;
+  gqueue_enqueue (gdns_queue, item);
+
+  gdns_stat.queued++;
+  if (gqueue_size (gdns_queue) > gdns_stat.max_size)
+    gdns_stat.max_size = gqueue_size (gdns_queue);
+  pthread_cond_signal (&gdns_thread.not_empty);
 }
 
 /* Producer - Resolve an IP address and add it to the queue. */
 void
 dns_resolver (char *addr) {
   pthread_mutex_lock (&gdns_thread.mutex);
-  /* queue is not full and the IP address is not in the queue */
-  if (!gqueue_full (gdns_queue) && !gqueue_find (gdns_queue, addr)) {
-    /* add the IP to the queue */
-    gqueue_enqueue (gdns_queue, addr);
-    pthread_cond_broadcast (&gdns_thread.not_empty);
+  enqueue_ip (addr, 0);
+  pthread_mutex_unlock (&gdns_thread.mutex);
+}
+
+/* Queue an IP address to be resolved by the resolver threads, which
+ * are started if needed. Unlike dns_resolver(), this waits for a slot
+ * in the queue rather than dropping the address. */
+void
+gdns_prefetch (const char *ip) {
+  if (gdns_thread.nthreads == 0)
+    gdns_thread_create ();
+
+  pthread_mutex_lock (&gdns_thread.mutex);
+  enqueue_ip (ip, 1);
+  pthread_mutex_unlock (&gdns_thread.mutex);
+}
+
+/* Wait until all queued IP addresses have been resolved. */
+void
+gdns_wait (void) {
+  pthread_mutex_lock (&gdns_thread.mutex);
+  while (active_gdns && gdns_queue && (gdns_inflight > 0 || !gqueue_empty (gdns_queue)))
+    pthread_cond_wait (&gdns_thread.idle, &gdns_thread.mutex);
+  pthread_mutex_unlock (&gdns_thread.mutex);
+}
+
+/* Get the cached hostname, or the reason it failed to resolve, of the
+ * given IP address. An expired lookup is still returned, and queued to
+ * be refreshed in the background.
+ *
+ * If not cached, NULL is returned.
+ * On success, a malloc'd string is returned. */
+char *
+gdns_get_hostname (const char *ip) {
+  GDnsEntry *entry = NULL;
+  char *host = NULL;
+
+  pthread_mutex_lock (&gdns_thread.mutex);
+  if ((entry = get_dns_entry (ip)) != NULL) {
+    host = entry->host ? xstrdup (entry->host) : NULL;
+    if (!is_fresh_dns_entry (entry)) {
+      gdns_stat.stale++;
+      enqueue_ip (ip, 0);
+    }
+  }
+  pthread_mutex_unlock (&gdns_thread.mutex);
+
+  return host;
+}
+
+/* Get the hostname, or the reason it failed to resolve, of the given
+ * IP address, resolving and caching it in the calling thread if it
+ * isn't cached or it expired.
+ *
+ * If the address is invalid, NULL is returned.
+ * On success, a malloc'd string is returned. */
+char *
+gdns_resolve (const char *ip) {
+  GDnsEntry *entry = NULL;
+  char *host = NULL;
+  int failed = 0;
+
+  pthread_mutex_lock (&gdns_thread.mutex);
+  if ((entry = get_dns_entry (ip)) != NULL && is_fresh_dns_entry (entry)) {
+    host = entry->host ? xstrdup (entry->host) : NULL;
+    gdns_stat.cached++;
+    pthread_mutex_unlock (&gdns_thread.mutex);
+    return host;
   }
   pthread_mutex_unlock (&gdns_thread.mutex);
+
+  failed = gdns_resolver (ip, &host);
+
+  pthread_mutex_lock (&gdns_thread.mutex);
+  set_dns_entry (ip, host ? xstrdup (host) : NULL, failed, time (NULL));
+  if (failed)
+    gdns_stat.failed++;
+  else
+    gdns_stat.resolved++;
+  pthread_mutex_unlock (&gdns_thread.mutex);
+
+  return host;
+}
+
+/* Get a copy of the resolver counters. */
+void
+gdns_stats (GDnsStats * stats) {
+  pthread_mutex_lock (&gdns_thread.mutex);
+  *stats = gdns_stat;
+  pthread_mutex_unlock (&gdns_thread.mutex);
 }
 
-/* Consumer - Once an IP has been resolved, add it to dwithe hostnames
- * hash structure. */
+/* Consumer - Once an IP has been resolved, add it to the cache of
+ * lookups. */
 static void
 dns_worker (void GO_UNUSED (*ptr_data)) {
   char *ip = NULL, *host = NULL;
+  int failed = 0;
+  khint_t k;
 
   while (1) {
     pthread_mutex_lock (&gdns_thread.mutex);
     /* wait until an item has been added to the queue */
-    while (gqueue_empty (gdns_queue))
+    while (active_gdns && gqueue_empty (gdns_queue))
       pthread_cond_wait (&gdns_thread.not_empty, &gdns_thread.mutex);
 
+    if (!active_gdns) {
+      pthread_mutex_unlock (&gdns_thread.mutex);
+      return;
+    }
+
     ip = gqueue_dequeue (gdns_queue);
+    gdns_inflight++;
+    pthread_cond_signal (&gdns_thread.not_full);
 
     pthread_mutex_unlock (&gdns_thread.mutex);
-    host = reverse_ip (ip);
+    failed = gdns_resolver (ip, &host);
     pthread_mutex_lock (&gdns_thread.mutex);
 
+    /* the pending set, and thus ip, is gone */
     if (!active_gdns) {
       pthread_mutex_unlock (&gdns_thread.mutex);
       free (host);
@@ -231,21 +477,35 @@ dns_worker (void GO_UNUSED (*ptr_data)) {
     }
 
     /* insert the corresponding IP -> hostname map */
-    if (host != NULL && active_gdns) {
-      ht_insert_hostname (ip, host);
-      free (host);
-    }
-
-    pthread_cond_signal (&gdns_thread.not_full);
+    set_dns_entry (ip, host, failed, time (NULL));
+    if (failed)
+      gdns_stat.failed++;
+    else
+      gdns_stat.resolved++;
+
+    if ((k = kh_get (si08, gdns_pending, ip)) != kh_end (gdns_pending))
+      kh_del (si08, gdns_pending, k);
+    free (ip);
+
+    if (--gdns_inflight == 0 && gqueue_empty (gdns_queue))
+      pthread_cond_broadcast (&gdns_thread.idle);
     pthread_mutex_unlock (&gdns_thread.mutex);
   }
 }
 
-/* Initialize queue and dns thread */
+/* Initialize queue, cache and dns threads */
 void
 gdns_init (void) {
   gdns_queue = xmalloc (sizeof (GDnsQueue));
   gqueue_init (gdns_queue, QUEUE_SIZE);
+  gdns_pending = kh_init (si08);
+  gdns_cache = kh_init (sdns);
+
+  /* lookups stubbed by a hosts file are not worth keeping around */
+  if (conf.dns_hosts_file)
+    load_hosts_file (conf.dns_hosts_file);
+  else if (conf.restore)
+    restore_hostnames (gdns_cache);
 
   if (pthread_cond_init (&(gdns_thread.not_empty), NULL))
     FATAL ("Failed init thread condition");
@@ -253,24 +513,79 @@ gdns_init (void) {
   if (pthread_cond_init (&(gdns_thread.not_full), NULL))
     FATAL ("Failed init thread condition");
 
+  if (pthread_cond_init (&(gdns_thread.idle), NULL))
+    FATAL ("Failed init thread condition");
+
   if (pthread_mutex_init (&(gdns_thread.mutex), NULL))
     FATAL ("Failed init thread mutex");
 }
 
-/* Destroy (free) queue */
+/* Destroy (free) queue and the pending addresses. Resolver threads are
+ * woken up so they exit once active_gdns is unset. */
 void
 gdns_free_queue (void) {
+  khint_t k;
+
+  if (gdns_pending) {
+    for (k = kh_begin (gdns_pending); k != kh_end (gdns_pending); ++k) {
+      if (kh_exist (gdns_pending, k))
+        free ((char *) kh_key (gdns_pending, k));
+    }
+    kh_destroy (si08, gdns_pending);
+  }
+  gdns_pending = NULL;
+
   gqueue_destroy (gdns_queue);
+  gdns_queue = NULL;
+
+  pthread_cond_broadcast (&gdns_thread.not_empty);
+  pthread_cond_broadcast (&gdns_thread.not_full);
+  pthread_cond_broadcast (&gdns_thread.idle);
 }
 
-/* Create a DNS thread and make it active */
+/* Free the cache of lookups, persisting it first if needed, and the
+ * loaded hosts file. */
+void
+gdns_free_cache (void) {
+  khint_t k;
+
+  if (gdns_cache && conf.persist && !conf.dns_hosts_file)
+    persist_hostnames (gdns_cache);
+
+  if (gdns_cache) {
+    for (k = kh_begin (gdns_cache); k != kh_end (gdns_cache); ++k) {
+      if (!kh_exist (gdns_cache, k))
+        continue;
+      free ((char *) kh_key (gdns_cache, k));
+      free (kh_val (gdns_cache, k).host);
+    }
+    kh_destroy (sdns, gdns_cache);
+  }
+  gdns_cache = NULL;
+
+  if (gdns_hosts) {
+    for (k = kh_begin (gdns_hosts); k != kh_end (gdns_hosts); ++k) {
+      if (!kh_exist (gdns_hosts, k))
+        continue;
+      free ((char *) kh_key (gdns_hosts, k));
+      free (kh_val (gdns_hosts, k));
+    }
+    kh_destroy (ss32, gdns_hosts);
+  }
+  gdns_hosts = NULL;
+}
+
+/* Create the pool of DNS threads and make it active */
 void
 gdns_thread_create (void) {
-  int th;
+  int th, i, n = conf.dns_threads > 0 ? conf.dns_threads : DNS_THREADS;
 
   active_gdns = 1;
-  th = pthread_create (&(gdns_thread.thread), NULL, (void *) &dns_worker, NULL);
-  if (th)
-    FATAL ("Return code from pthread_create(): %d", th);
-  pthread_detach (gdns_thread.thread);
+  for (i = 0; i < n; ++i) {
+    th = pthread_create (&(gdns_thread.threads[i]), NULL, (void *) &dns_worker, NULL);
+    if (th)
+      FATAL ("Return code from pthread_create(): %d", th);
+    pthread_detach (gdns_thread.threads[i]);
+  }
+  gdns_thread.nthreads = n;
 }
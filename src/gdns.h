@@ -30,14 +30,29 @@
 #ifndef GDNS_H_INCLUDED
 #define GDNS_H_INCLUDED
 
-#define H_SIZE     1025
-#define QUEUE_SIZE 400
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#define H_SIZE           1025
+#define QUEUE_SIZE       400
+#define DNS_THREADS      4      /* default number of resolver threads */
+#define MAX_DNS_THREADS  64
+#define DNS_POSITIVE_TTL 3600   /* seconds a resolved hostname is kept */
+#define DNS_NEGATIVE_TTL 300    /* seconds a failed lookup is kept */
+
+/* Resolve an IP address. Set host to a malloc'd hostname and return 0
+ * on success, or set it to a malloc'd error message, or NULL if the
+ * address is invalid, and return 1 on failure */
+typedef int (*GDnsResolver) (const char *ip, char **host);
 
 typedef struct GDnsThread_ {
   pthread_cond_t not_empty;     /* not empty queue condition */
   pthread_cond_t not_full;      /* not full queue condition */
+  pthread_cond_t idle;          /* nothing pending condition */
   pthread_mutex_t mutex;
-  pthread_t thread;
+  pthread_t threads[MAX_DNS_THREADS];
+  int nthreads;                 /* number of resolver threads */
 } GDnsThread;
 
 typedef struct GDnsQueue_ {
@@ -45,23 +60,46 @@ typedef struct GDnsQueue_ {
   int tail;                     /* index to tail of queue */
   int size;                     /* queue size */
   int capacity;                 /* length at most */
-  char buffer[QUEUE_SIZE][H_SIZE];      /* data item */
+  char *buffer[QUEUE_SIZE];     /* data item */
 } GDnsQueue;
 
+/* A cached lookup, either a hostname or the reason it failed */
+typedef struct GDnsEntry_ {
+  char *host;                   /* hostname or error message */
+  time_t resolved;              /* when the lookup was done */
+  uint8_t failed:1;
+} GDnsEntry;
+
+/* Counters of the resolver pool */
+typedef struct GDnsStats_ {
+  uint64_t queued;              /* addresses added to the queue */
+  uint64_t pending;             /* already queued or being resolved */
+  uint64_t cached;              /* still fresh in the cache */
+  uint64_t stale;               /* expired, refreshed in the background */
+  uint64_t dropped;             /* not queued as the queue was full */
+  uint64_t waited;              /* producers blocked on a full queue */
+  uint64_t resolved;            /* successful lookups */
+  uint64_t failed;              /* failed lookups */
+  int max_size;                 /* highest number of queued addresses */
+} GDnsStats;
+
 extern GDnsThread gdns_thread;
 
+char *gdns_get_hostname (const char *ip);
+char *gdns_resolve (const char *ip);
 char *gqueue_dequeue (GDnsQueue * q);
-char *reverse_ip (char *str);
 int gqueue_empty (GDnsQueue * q);
-int gqueue_enqueue (GDnsQueue * q, const char *item);
-int gqueue_find (GDnsQueue * q, const char *item);
+int gqueue_enqueue (GDnsQueue * q, char *item);
 int gqueue_full (GDnsQueue * q);
 int gqueue_size (GDnsQueue * q);
 void dns_resolver (char *addr);
+void gdns_free_cache (void);
 void gdns_free_queue (void);
 void gdns_init (void);
-void gdns_queue_free (void);
+void gdns_prefetch (const char *ip);
+void gdns_stats (GDnsStats * stats);
 void gdns_thread_create (void);
+void gdns_wait (void);
 void gqueue_destroy (GDnsQueue * q);
 void gqueue_init (GDnsQueue * q, int capacity);
 
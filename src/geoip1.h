@@ -34,6 +34,8 @@
 #ifndef GEOIP_H_INCLUDED
 #define GEOIP_H_INCLUDED
 
+#include <stdint.h>
+
 #include "commons.h"
 
 #define CITY_LEN       47 + 1   /* max string length for a city */
@@ -54,4 +56,8 @@ void geoip_get_continent (const char *ip, char *location, GTypeIP type_ip);
 void geoip_get_country (const char *ip, char *location, GTypeIP type_ip);
 void init_geoip (void);
 
+#ifdef HAVE_LIBMAXMINDDB
+void geoip_cache_stats (uint64_t * hits, uint64_t * misses);
+#endif
+
 #endif // for #ifndef GEOIP_H
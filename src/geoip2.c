@@ -32,8 +32,12 @@
 #include <config.h>
 #endif
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <errno.h>
 
 #ifdef HAVE_LIBMAXMINDDB
@@ -46,9 +50,40 @@
 #include "util.h"
 #include "xmalloc.h"
 
+#define GEO_CACHE_SETS  4096u   /* sets, a power of 2 */
+#define GEO_CACHE_WAYS  4u      /* entries per set */
+#define GEO_CACHE_LOCKS 64u     /* sets are guarded by lock stripes */
+
+/* The location of an IP address, looked up once for all panels */
+typedef struct GGeoEntry_ {
+  unsigned char addr[16];       /* binary address, network byte order */
+  char country[COUNTRY_LEN];
+  char continent[CONTINENT_LEN];
+  char city[CITY_LEN];
+  uint8_t family;               /* AF_INET or AF_INET6 */
+  uint8_t used:1;
+  uint8_t ref:1;                /* hit since the clock hand last passed */
+} GGeoEntry;
+
+/* A set of entries evicted in CLOCK order */
+typedef struct GGeoSet_ {
+  GGeoEntry ways[GEO_CACHE_WAYS];
+  uint32_t hand;
+} GGeoSet;
+
+/* Set-associative cache of locations keyed by the binary address, thus
+ * the database is queried once per address unless it is evicted */
+typedef struct GGeoCache_ {
+  GGeoSet *sets;
+  pthread_mutex_t locks[GEO_CACHE_LOCKS];
+  uint64_t hits[GEO_CACHE_LOCKS];       /* hits per lock stripe */
+  uint64_t misses[GEO_CACHE_LOCKS];     /* misses per lock stripe */
+} GGeoCache;
+
 /* should be reused across lookups */
 int geoip_city_type = 0;
 static MMDB_s *mmdb = NULL;
+static GGeoCache geo_cache;
 
 /* Determine if we have a valid geoip resource.
  *
@@ -59,12 +94,57 @@ is_geoip_resource (void) {
   return mmdb != NULL ? 1 : 0;
 }
 
+/* Allocate the sets of the location cache. */
+static void
+init_geoip_cache (void) {
+  uint32_t i;
+
+  memset (&geo_cache, 0, sizeof (geo_cache));
+  geo_cache.sets = xcalloc (GEO_CACHE_SETS, sizeof (GGeoSet));
+  for (i = 0; i < GEO_CACHE_LOCKS; ++i) {
+    if (pthread_mutex_init (&(geo_cache.locks[i]), NULL))
+      FATAL ("Failed init thread mutex");
+  }
+}
+
+/* Free the location cache. */
+static void
+free_geoip_cache (void) {
+  uint32_t i;
+
+  if (geo_cache.sets == NULL)
+    return;
+
+  free (geo_cache.sets);
+  geo_cache.sets = NULL;
+  for (i = 0; i < GEO_CACHE_LOCKS; ++i)
+    pthread_mutex_destroy (&geo_cache.locks[i]);
+}
+
+/* Get the number of location cache hits and misses so far. */
+void
+geoip_cache_stats (uint64_t * hits, uint64_t * misses) {
+  uint32_t i;
+
+  *hits = *misses = 0;
+  if (geo_cache.sets == NULL)
+    return;
+
+  for (i = 0; i < GEO_CACHE_LOCKS; ++i) {
+    pthread_mutex_lock (&geo_cache.locks[i]);
+    *hits += geo_cache.hits[i];
+    *misses += geo_cache.misses[i];
+    pthread_mutex_unlock (&geo_cache.locks[i]);
+  }
+}
+
 /* Free up GeoIP resources */
 void
 geoip_free (void) {
   if (!is_geoip_resource ())
     return;
 
+  free_geoip_cache ();
   MMDB_close (mmdb);
   free (mmdb);
   mmdb = NULL;
@@ -91,6 +171,7 @@ init_geoip (void) {
 
   if (strcmp (mmdb->metadata.database_type, "GeoLite2-City") == 0)
     geoip_city_type = 1;
+  init_geoip_cache ();
 }
 
 /* Look up an IP address that is passed in as a null-terminated string.
@@ -115,6 +196,41 @@ geoip_lookup (MMDB_lookup_result_s * res, const char *ip) {
   return 0;
 }
 
+/* Look up a binary IP address of the given family, skipping the
+ * address resolution MMDB_lookup_string() goes through.
+ *
+ * On error, it aborts.
+ * If no entry is found, 1 is returned.
+ * On success, MMDB_lookup_result_s struct is set and 0 is returned. */
+static int
+geoip_lookup_addr (MMDB_lookup_result_s * res, int family, const unsigned char *addr) {
+  struct sockaddr_in sa4;
+  struct sockaddr_in6 sa6;
+  const struct sockaddr *sa = NULL;
+  int mmdb_err;
+
+  if (family == AF_INET) {
+    memset (&sa4, 0, sizeof (sa4));
+    sa4.sin_family = AF_INET;
+    memcpy (&sa4.sin_addr, addr, 4);
+    sa = (const struct sockaddr *) &sa4;
+  } else {
+    memset (&sa6, 0, sizeof (sa6));
+    sa6.sin6_family = AF_INET6;
+    memcpy (&sa6.sin6_addr, addr, 16);
+    sa = (const struct sockaddr *) &sa6;
+  }
+
+  *res = MMDB_lookup_sockaddr (mmdb, sa, &mmdb_err);
+  if (MMDB_SUCCESS != mmdb_err)
+    FATAL ("Error from libmaxminddb: %s\n", MMDB_strerror (mmdb_err));
+
+  if (!(*res).found_entry)
+    return 1;
+
+  return 0;
+}
+
 /* Get continent name concatenated with code.
  *
  * If continent not found, "Unknown" is returned.
@@ -245,22 +361,98 @@ geoip_query_continent (MMDB_lookup_result_s res, char *location) {
   free (code);
 }
 
+/* Set the country, continent and, given a city database, the city of
+ * a looked up result into the given entry. */
+static void
+geoip_query_location (MMDB_lookup_result_s res, GGeoEntry * loc) {
+  geoip_query_country (res, loc->country);
+  geoip_query_continent (res, loc->continent);
+  if (geoip_city_type)
+    geoip_query_city (res, loc->city);
+}
+
+/* Hash a binary IP address into a set of the location cache. */
+static uint32_t
+hash_geoip_addr (const unsigned char *addr, int family) {
+  uint32_t hash = 2166136261u;
+  int i, len = family == AF_INET ? 4 : 16;
+
+  for (i = 0; i < len; ++i)
+    hash = (hash ^ addr[i]) * 16777619u;
+
+  return hash ^ (hash >> 16);
+}
+
+/* Get the location of the given IP address, country, continent and
+ * city at once. A cached location is copied, otherwise the database is
+ * queried and the result takes over the first entry of the set that
+ * wasn't hit since the clock hand last passed it. */
+static void
+geoip_get_location (const char *ip, GGeoEntry * loc) {
+  MMDB_lookup_result_s res;
+  unsigned char addr[16] = { 0 };
+  GGeoSet *set = NULL;
+  GGeoEntry *e = NULL;
+  uint32_t hash = 0, lock = 0, i;
+  int family = strchr (ip, ':') ? AF_INET6 : AF_INET;
+
+  /* not an address, e.g., a hostname, thus not cached */
+  if (geo_cache.sets == NULL || inet_pton (family, ip, addr) != 1) {
+    geoip_lookup (&res, ip);
+    geoip_query_location (res, loc);
+    return;
+  }
+
+  hash = hash_geoip_addr (addr, family);
+  set = &geo_cache.sets[hash & (GEO_CACHE_SETS - 1)];
+  lock = hash & (GEO_CACHE_LOCKS - 1);
+
+  pthread_mutex_lock (&geo_cache.locks[lock]);
+  for (i = 0; i < GEO_CACHE_WAYS; ++i) {
+    e = &set->ways[i];
+    if (e->used && e->family == family && !memcmp (e->addr, addr, sizeof (addr))) {
+      e->ref = 1;
+      geo_cache.hits[lock]++;
+      *loc = *e;
+      pthread_mutex_unlock (&geo_cache.locks[lock]);
+      return;
+    }
+  }
+  geo_cache.misses[lock]++;
+
+  while (set->ways[set->hand].used && set->ways[set->hand].ref) {
+    set->ways[set->hand].ref = 0;
+    set->hand = (set->hand + 1) % GEO_CACHE_WAYS;
+  }
+  e = &set->ways[set->hand];
+  set->hand = (set->hand + 1) % GEO_CACHE_WAYS;
+
+  memset (e, 0, sizeof (*e));
+  geoip_lookup_addr (&res, family, addr);
+  geoip_query_location (res, e);
+  memcpy (e->addr, addr, sizeof (addr));
+  e->family = family;
+  e->used = 1;
+  *loc = *e;
+  pthread_mutex_unlock (&geo_cache.locks[lock]);
+}
+
 /* Set country data by record into the given `location` buffer */
 void
 geoip_get_country (const char *ip, char *location, GO_UNUSED GTypeIP type_ip) {
-  MMDB_lookup_result_s res;
+  GGeoEntry loc;
 
-  geoip_lookup (&res, ip);
-  geoip_query_country (res, location);
+  geoip_get_location (ip, &loc);
+  memcpy (location, loc.country, COUNTRY_LEN);
 }
 
 /* A wrapper to fetch the looked up result and set the continent. */
 void
 geoip_get_continent (const char *ip, char *location, GO_UNUSED GTypeIP type_ip) {
-  MMDB_lookup_result_s res;
+  GGeoEntry loc;
 
-  geoip_lookup (&res, ip);
-  geoip_query_continent (res, location);
+  geoip_get_location (ip, &loc);
+  memcpy (location, loc.continent, CONTINENT_LEN);
 }
 
 /* Entry point to set GeoIP location into the corresponding buffers,
@@ -270,16 +462,16 @@ geoip_get_continent (const char *ip, char *location, GO_UNUSED GTypeIP type_ip)
  * On success, buffers are set and 0 is returned */
 int
 set_geolocation (char *host, char *continent, char *country, char *city) {
-  MMDB_lookup_result_s res;
+  GGeoEntry loc;
 
   if (!is_geoip_resource ())
     return 1;
 
-  geoip_lookup (&res, host);
-  geoip_query_country (res, country);
-  geoip_query_continent (res, continent);
+  geoip_get_location (host, &loc);
+  memcpy (country, loc.country, COUNTRY_LEN);
+  memcpy (continent, loc.continent, CONTINENT_LEN);
   if (geoip_city_type)
-    geoip_query_city (res, city);
+    memcpy (city, loc.city, CITY_LEN);
 
   return 0;
 }
@@ -366,7 +366,7 @@ set_host_sub_list (GHolder * h, GSubList * sub_list) {
 
   /* hostname */
   if (conf.enable_html_resolver && conf.output_stdout && !conf.no_ip_validation) {
-    hostname = reverse_ip (host);
+    hostname = gdns_resolve (host);
     set_host_child_metrics (hostname, MTRC_ID_HOSTNAME, &nmetrics);
     add_sub_item_back (sub_list, h->module, nmetrics);
     h->items[h->idx].sub_list = sub_list;
@@ -390,9 +390,7 @@ add_host_child_to_holder (GHolder * h) {
   /* add child nodes */
   set_host_sub_list (h, sub_list);
 
-  pthread_mutex_lock (&gdns_thread.mutex);
-  hostname = ht_get_hostname (ip);
-  pthread_mutex_unlock (&gdns_thread.mutex);
+  hostname = gdns_get_hostname (ip);
 
   /* determine if we have the IP's hostname */
   if (!hostname) {
@@ -433,6 +431,23 @@ map_data (GModule module, GRawDataItem item, datatype type, char **data, uint32_
   return 0;
 }
 
+/* Queue the IPs of the hosts about to be added to the holder to the
+ * resolver threads and wait for them, so they are resolved in parallel
+ * rather than one by one as each host is added. */
+static void
+prefetch_hostnames (GRawData * raw_data, uint32_t size) {
+  char *data = NULL;
+  uint32_t i, hits = 0;
+
+  for (i = 0; i < size; i++) {
+    data = NULL;
+    if (map_data (HOSTS, raw_data->items[i], raw_data->type, &data, &hits) == 0)
+      gdns_prefetch (data);
+    free (data);
+  }
+  gdns_wait ();
+}
+
 /* Given a data item, store it into a holder structure. */
 static void
 set_single_metrics (GRawDataItem item, GHolder * h, char *data, uint32_t hits) {
@@ -645,6 +660,11 @@ load_holder_data (GRawData * raw_data, GHolder * h, GModule module, GSort sort)
   h->sub_items_size = 0;
   h->items = new_gholder_item (h->holder_size);
 
+  /* anonymized IPs are resolved as they are added */
+  if (module == HOSTS && conf.enable_html_resolver && conf.output_stdout &&
+      !conf.no_ip_validation && !conf.anonymize_ip)
+    prefetch_hostnames (raw_data, h->holder_size);
+
   for (i = 0; i < h->holder_size; i++) {
     panel->insert (raw_data->items[i], h, raw_data->type, panel);
   }
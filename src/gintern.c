@@ -0,0 +1,195 @@
+/**
+ * gintern.c -- a string intern pool
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gintern.h"
+
+#include "xmalloc.h"
+
+/* Hash len bytes of the given string eight bytes at a time. Each word is
+ * folded in through a multiply and a xor-shift, and the 64-bit result
+ * goes through a final avalanche before it's folded into 32 bits. */
+#if defined(__clang__) && defined(__clang_major__) && (__clang_major__ >= 4)
+__attribute__((no_sanitize ("unsigned-integer-overflow")))
+#endif
+static uint32_t
+hash_str (const char *s, size_t len) {
+  const uint64_t m = 0x9fb21c651e98df25ULL;
+  uint64_t h = 0x243f6a8885a308d3ULL ^ (len * m), w = 0;
+
+  for (; len >= 8; s += 8, len -= 8) {
+    memcpy (&w, s, 8);
+    h = (h ^ w) * m;
+    h ^= h >> 29;
+  }
+  w = 0;
+  memcpy (&w, s, len);
+  h = (h ^ w) * m;
+
+  h ^= h >> 32;
+  h *= m;
+  h ^= h >> 29;
+
+  return (uint32_t) (h ^ (h >> 32));
+}
+
+/* Allocate a new, empty, string intern pool.
+ *
+ * On success, the new pool is returned. */
+GIntern *
+new_intern (void) {
+  GIntern *pool = xcalloc (1, sizeof (GIntern));
+
+  pool->nslots = INTERN_INIT_SLOTS;
+  pool->slots = xcalloc (pool->nslots, sizeof (GInternSlot));
+  pool->size = INTERN_INIT_SLOTS;
+  pool->strs = xcalloc (pool->size, sizeof (char *));
+  pool->len = 1;
+
+  return pool;
+}
+
+/* Free the given pool along with all the strings it holds. */
+void
+free_intern (GIntern * pool) {
+  if (!pool)
+    return;
+
+  arena_free (&pool->arena);
+  free (pool->slots);
+  free (pool->strs);
+  free (pool);
+}
+
+/* Find the slot of the given string, or the empty slot where it would go.
+ *
+ * On success, the index of the slot is returned. */
+static uint32_t
+find_slot (const GIntern * pool, const char *str, uint32_t hash) {
+  uint32_t mask = pool->nslots - 1, i = hash & mask;
+  const GInternSlot *slot = NULL;
+
+  for (;; i = (i + 1) & mask) {
+    slot = &pool->slots[i];
+    if (slot->id == 0)
+      return i;
+    if (slot->hash == hash && strcmp (pool->strs[slot->id], str) == 0)
+      return i;
+  }
+}
+
+/* Double the number of slots of the given pool and move the existing
+ * slots over. */
+static void
+grow_slots (GIntern * pool) {
+  GInternSlot *old = pool->slots;
+  uint32_t i, j, n = pool->nslots, mask = 0;
+
+  pool->nslots = n * 2;
+  pool->slots = xcalloc (pool->nslots, sizeof (GInternSlot));
+  mask = pool->nslots - 1;
+
+  for (i = 0; i < n; ++i) {
+    if (old[i].id == 0)
+      continue;
+    for (j = old[i].hash & mask; pool->slots[j].id; j = (j + 1) & mask);
+    pool->slots[j] = old[i];
+  }
+  free (old);
+}
+
+/* Get the string of the given id.
+ *
+ * On error, or unknown id, NULL is returned.
+ * On success, the interned string is returned. */
+char *
+intern_get (const GIntern * pool, uint32_t id) {
+  if (!pool || id == 0 || id >= pool->len)
+    return NULL;
+  return pool->strs[id];
+}
+
+/* Find the id of the given string without interning it.
+ *
+ * If the string is not in the pool, 0 is returned.
+ * On success, the id of the string is returned. */
+uint32_t
+intern_find (const GIntern * pool, const char *str) {
+  size_t len = 0;
+
+  if (!pool || !str)
+    return 0;
+
+  len = strlen (str);
+  return pool->slots[find_slot (pool, str, hash_str (str, len))].id;
+}
+
+/* Intern the given string. It is copied into the pool the first time it
+ * is seen, after that, the id of the existing copy is returned.
+ *
+ * On error, 0 is returned.
+ * On success, the id of the string is returned. */
+uint32_t
+intern_str (GIntern * pool, const char *str) {
+  GInternSlot *slot = NULL;
+  uint32_t hash = 0, id = 0;
+  size_t len = 0;
+
+  if (!pool || !str)
+    return 0;
+
+  len = strlen (str);
+  hash = hash_str (str, len);
+  slot = &pool->slots[find_slot (pool, str, hash)];
+  if (slot->id != 0)
+    return slot->id;
+
+  /* ids are uint32_t, 0 is reserved */
+  if (pool->len == UINT32_MAX)
+    return 0;
+
+  if (pool->len == pool->size) {
+    pool->size *= 2;
+    pool->strs = xrealloc (pool->strs, pool->size * sizeof (char *));
+  }
+  id = pool->len++;
+  pool->strs[id] = arena_strndup_packed (&pool->arena, str, len);
+
+  slot->hash = hash;
+  slot->id = id;
+
+  /* keep the load factor under 3/4 */
+  if (pool->len > pool->nslots / 4 * 3)
+    grow_slots (pool);
+
+  return id;
+}
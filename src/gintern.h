@@ -0,0 +1,68 @@
+/**
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GINTERN_H_INCLUDED
+#define GINTERN_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "garena.h"
+
+#define INTERN_INIT_SLOTS 1024u /* initial number of slots, a power of two */
+
+/* A slot of the open addressing table. An id of 0 marks an empty slot.
+ * The 64-bit hash is folded into 32 bits to keep the slots small, it
+ * picks the slot and filters out most mismatches before the string is
+ * compared */
+typedef struct GInternSlot_ {
+  uint32_t hash;                /* folded 64-bit hash of the string */
+  uint32_t id;                  /* id of the string */
+} GInternSlot;
+
+/* String intern pool. It keeps a single copy of each distinct string and
+ * hands out dense uint32_t ids (starting at 1) for them. Lookups compare
+ * the hash first and the whole string on a hash match, thus two strings
+ * never share an id. */
+typedef struct GIntern_ {
+  GArena arena;                 /* packed copies of the strings */
+  GInternSlot *slots;           /* linear probing table */
+  uint32_t nslots;              /* number of slots, a power of two */
+  char **strs;                  /* string of each id, id 0 is unused */
+  uint32_t len;                 /* next id to be handed out */
+  uint32_t size;                /* entries allocated in strs */
+} GIntern;
+
+GIntern *new_intern (void);
+char *intern_get (const GIntern * pool, uint32_t id);
+uint32_t intern_find (const GIntern * pool, const char *str);
+uint32_t intern_str (GIntern * pool, const char *str);
+void free_intern (GIntern * pool);
+
+#endif // for #ifndef GINTERN_H
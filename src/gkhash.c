@@ -117,6 +117,9 @@ get_mtr_type_str (GSMetricType type) {
     {"IGKH", MTRC_TYPE_IGKH},
     {"U648", MTRC_TYPE_U648},
     {"IGLP", MTRC_TYPE_IGLP},
+    {"IGRC", MTRC_TYPE_IGRC},
+    {"BI32", MTRC_TYPE_BI32},
+    {"KI32", MTRC_TYPE_KI32},
   };
   return enum2str (enum_metric_types, ARRAY_SIZE (enum_metric_types), type);
 }
@@ -184,17 +187,24 @@ new_si08_ht (void) {
   return h;
 }
 
-/* Initialize a new string key - uint32_t value hash table */
+/* Initialize a new string key - string value hash table */
 static void *
-new_ii08_ht (void) {
-  khash_t (ii08) * h = kh_init (ii08);
+new_ss32_ht (void) {
+  khash_t (ss32) * h = kh_init (ss32);
   return h;
 }
 
-/* Initialize a new string key - string value hash table */
+/* Initialize a new uint32_t key - GKeyRecord value hash table */
 static void *
-new_ss32_ht (void) {
-  khash_t (ss32) * h = kh_init (ss32);
+new_igrc_ht (void) {
+  khash_t (igrc) * h = kh_init (igrc);
+  return h;
+}
+
+/* Initialize a new GUniqKey key - uint32_t value hash table */
+static void *
+new_bi32_ht (void) {
+  khash_t (bi32) * h = kh_init (bi32);
   return h;
 }
 
@@ -398,57 +408,81 @@ del_ii32 (void *h, GO_UNUSED uint8_t free_data) {
 
 /* Destroys the hash structure */
 static void
-des_ii08 (void *h, GO_UNUSED uint8_t free_data) {
-  khash_t (ii08) * hash = h;
+des_u648 (void *h, GO_UNUSED uint8_t free_data) {
+  khash_t (u648) * hash = h;
+  if (!hash)
+    return;
+  kh_destroy (u648, hash);
+}
+
+/* Destroys the hash structure */
+static void
+des_iglp (void *h, GO_UNUSED uint8_t free_data) {
+  khash_t (iglp) * hash = h;
   if (!hash)
     return;
-  kh_destroy (ii08, hash);
+  kh_destroy (iglp, hash);
 }
 
 /* Deletes all entries from the hash table */
 static void
-del_ii08 (void *h, GO_UNUSED uint8_t free_data) {
+del_u648 (void *h, GO_UNUSED uint8_t free_data) {
   khint_t k;
-  khash_t (ii08) * hash = h;
+  khash_t (u648) * hash = h;
   if (!hash)
     return;
 
   for (k = 0; k < kh_end (hash); ++k) {
     if (kh_exist (hash, k)) {
-      kh_del (ii08, hash, k);
+      kh_del (u648, hash, k);
     }
   }
 }
 
 /* Destroys the hash structure */
 static void
-des_u648 (void *h, GO_UNUSED uint8_t free_data) {
-  khash_t (u648) * hash = h;
+des_igrc (void *h, GO_UNUSED uint8_t free_data) {
+  khash_t (igrc) * hash = h;
   if (!hash)
     return;
-  kh_destroy (u648, hash);
+  kh_destroy (igrc, hash);
+}
+
+/* Deletes all entries from the hash table */
+static void
+del_igrc (void *h, GO_UNUSED uint8_t free_data) {
+  khint_t k;
+  khash_t (igrc) * hash = h;
+  if (!hash)
+    return;
+
+  for (k = 0; k < kh_end (hash); ++k) {
+    if (kh_exist (hash, k)) {
+      kh_del (igrc, hash, k);
+    }
+  }
 }
 
 /* Destroys the hash structure */
 static void
-des_iglp (void *h, GO_UNUSED uint8_t free_data) {
-  khash_t (iglp) * hash = h;
+des_bi32 (void *h, GO_UNUSED uint8_t free_data) {
+  khash_t (bi32) * hash = h;
   if (!hash)
     return;
-  kh_destroy (iglp, hash);
+  kh_destroy (bi32, hash);
 }
 
 /* Deletes all entries from the hash table */
 static void
-del_u648 (void *h, GO_UNUSED uint8_t free_data) {
+del_bi32 (void *h, GO_UNUSED uint8_t free_data) {
   khint_t k;
-  khash_t (u648) * hash = h;
+  khash_t (bi32) * hash = h;
   if (!hash)
     return;
 
   for (k = 0; k < kh_end (hash); ++k) {
     if (kh_exist (hash, k)) {
-      kh_del (u648, hash, k);
+      kh_del (bi32, hash, k);
     }
   }
 }
@@ -565,7 +599,6 @@ const GKHashMetric app_metrics[] = {
   { .metric.dbm=MTRC_DATES       , MTRC_TYPE_IGKH , new_igkh_ht , NULL          , NULL          , 1 , NULL , NULL                  } ,
   { .metric.dbm=MTRC_SEQS        , MTRC_TYPE_SI32 , new_si32_ht , des_si32_free , del_si32_free , 1 , NULL , "SI32_SEQS.db"        } ,
   { .metric.dbm=MTRC_CNT_OVERALL , MTRC_TYPE_SI32 , new_si32_ht , des_si32_free , del_si32_free , 1 , NULL , "SI32_CNT_OVERALL.db" } ,
-  { .metric.dbm=MTRC_HOSTNAMES   , MTRC_TYPE_SS32 , new_ss32_ht , des_ss32_free , del_ss32_free , 1 , NULL , NULL                  } ,
   { .metric.dbm=MTRC_LAST_PARSE  , MTRC_TYPE_IGLP , new_iglp_ht , des_iglp      , NULL          , 1 , NULL , "IGLP_LAST_PARSE.db"  } ,
   { .metric.dbm=MTRC_JSON_LOGFMT , MTRC_TYPE_SS32 , new_ss32_ht , des_ss32_free , del_ss32_free , 1 , NULL , NULL                  } ,
   { .metric.dbm=MTRC_METH_PROTO  , MTRC_TYPE_SI08 , new_si08_ht , des_si08_free , del_si08_free , 1 , NULL , "SI08_METH_PROTO.db"  } ,
@@ -574,7 +607,7 @@ const GKHashMetric app_metrics[] = {
 
 /* Per module - These metrics are not dated */
 const GKHashMetric global_metrics[] = {
-  { .metric.storem=MTRC_UNIQUE_KEYS , MTRC_TYPE_SI32 , new_si32_ht , des_si32_free , del_si32_free , 1 , NULL , "SI32_UNIQUE_KEYS.db" } ,
+  { .metric.storem=MTRC_UNIQUE_KEYS , MTRC_TYPE_BI32 , new_bi32_ht , des_bi32      , del_bi32      , 0 , NULL , "BI32_UNIQUE_KEYS.db" } ,
   { .metric.storem=MTRC_AGENT_KEYS  , MTRC_TYPE_II32 , new_ii32_ht , des_ii32      , del_ii32      , 0 , NULL , "II32_AGENT_KEYS.db"  } ,
   { .metric.storem=MTRC_AGENT_VALS  , MTRC_TYPE_IS32 , new_is32_ht , des_is32_free , del_is32_free , 1 , NULL , "IS32_AGENT_VALS.db"  } ,
   { .metric.storem=MTRC_CNT_VALID   , MTRC_TYPE_II32 , new_ii32_ht , des_ii32      , del_ii32      , 1 , NULL , "II32_CNT_VALID.db"   } ,
@@ -583,36 +616,44 @@ const GKHashMetric global_metrics[] = {
 
 /* Per module & per date */
 GKHashMetric module_metrics[] = {
-  { .metric.storem=MTRC_KEYMAP    , MTRC_TYPE_II32 , new_ii32_ht , des_ii32      , del_ii32      , 1 , NULL , NULL } ,
-  { .metric.storem=MTRC_ROOTMAP   , MTRC_TYPE_IS32 , new_is32_ht , des_is32_free , del_is32_free , 1 , NULL , NULL } ,
-  { .metric.storem=MTRC_DATAMAP   , MTRC_TYPE_IS32 , new_is32_ht , des_is32_free , del_is32_free , 1 , NULL , NULL } ,
+  { .metric.storem=MTRC_KEYMAP    , MTRC_TYPE_KI32 , new_ii32_ht , des_ii32      , del_ii32      , 1 , NULL , NULL } ,
+  { .metric.storem=MTRC_ROOTMAP   , MTRC_TYPE_IS32 , new_is32_ht , des_is32_free , del_is32_free , 0 , NULL , NULL } ,
+  { .metric.storem=MTRC_DATAMAP   , MTRC_TYPE_IS32 , new_is32_ht , des_is32_free , del_is32_free , 0 , NULL , NULL } ,
   { .metric.storem=MTRC_UNIQMAP   , MTRC_TYPE_U648 , new_u648_ht , des_u648      , del_u648      , 1 , NULL , NULL } ,
-  { .metric.storem=MTRC_ROOT      , MTRC_TYPE_II32 , new_ii32_ht , des_ii32      , del_ii32      , 1 , NULL , NULL } ,
-  { .metric.storem=MTRC_HITS      , MTRC_TYPE_II32 , new_ii32_ht , des_ii32      , del_ii32      , 1 , NULL , NULL } ,
-  { .metric.storem=MTRC_VISITORS  , MTRC_TYPE_II32 , new_ii32_ht , des_ii32      , del_ii32      , 1 , NULL , NULL } ,
-  { .metric.storem=MTRC_BW        , MTRC_TYPE_IU64 , new_iu64_ht , des_iu64      , del_iu64      , 1 , NULL , NULL } ,
-  { .metric.storem=MTRC_CUMTS     , MTRC_TYPE_IU64 , new_iu64_ht , des_iu64      , del_iu64      , 1 , NULL , NULL } ,
-  { .metric.storem=MTRC_MAXTS     , MTRC_TYPE_IU64 , new_iu64_ht , des_iu64      , del_iu64      , 1 , NULL , NULL } ,
-  { .metric.storem=MTRC_METHODS   , MTRC_TYPE_II08 , new_ii08_ht , des_ii08      , del_ii08      , 0 , NULL , NULL } ,
-  { .metric.storem=MTRC_PROTOCOLS , MTRC_TYPE_II08 , new_ii08_ht , des_ii08      , del_ii08      , 0 , NULL , NULL } ,
+  { .metric.storem=MTRC_RECORDS   , MTRC_TYPE_IGRC , new_igrc_ht , des_igrc      , del_igrc      , 0 , NULL , NULL } ,
   { .metric.storem=MTRC_AGENTS    , MTRC_TYPE_IGSL , new_igsl_ht , des_igsl_free , del_igsl_free , 1 , NULL , NULL } ,
   { .metric.storem=MTRC_METADATA  , MTRC_TYPE_SU64 , new_su64_ht , des_su64_free , del_su64_free , 1 , NULL , NULL } ,
 };
 
+/* Fields of a MTRC_RECORDS record - Each one is persisted on its own */
+const GKHashMetric record_metrics[] = {
+  { .metric.storem=MTRC_ROOT      , MTRC_TYPE_II32 } ,
+  { .metric.storem=MTRC_HITS      , MTRC_TYPE_II32 } ,
+  { .metric.storem=MTRC_VISITORS  , MTRC_TYPE_II32 } ,
+  { .metric.storem=MTRC_BW        , MTRC_TYPE_IU64 } ,
+  { .metric.storem=MTRC_CUMTS     , MTRC_TYPE_IU64 } ,
+  { .metric.storem=MTRC_MAXTS     , MTRC_TYPE_IU64 } ,
+  { .metric.storem=MTRC_METHODS   , MTRC_TYPE_II08 } ,
+  { .metric.storem=MTRC_PROTOCOLS , MTRC_TYPE_II08 } ,
+};
+
 size_t global_metrics_len = ARRAY_SIZE (global_metrics);
 size_t module_metrics_len = ARRAY_SIZE (module_metrics);
 size_t app_metrics_len = ARRAY_SIZE (app_metrics);
+size_t record_metrics_len = ARRAY_SIZE (record_metrics);
 /* *INDENT-ON* */
 
-/* Initialize module metrics and mallocs its hash structure */
+/* Initialize module metrics. If alloc is set, it mallocs their hash
+ * structures, else they are malloc'd on their first write */
 static void
-init_tables (GModule module, GKHashModule * storage) {
+init_tables (GModule module, GKHashModule * storage, uint8_t alloc) {
   int n = 0, i;
 
   n = module_metrics_len;
   for (i = 0; i < n; i++) {
     storage[module].metrics[i] = module_metrics[i];
-    storage[module].metrics[i].hash = module_metrics[i].alloc ();
+    if (alloc)
+      storage[module].metrics[i].hash = module_metrics[i].alloc ();
   }
 }
 
@@ -667,19 +708,6 @@ free_module_metrics (GKHashModule * mhash, GModule module, uint8_t free_data) {
   }
 }
 
-/* For each module metric, deletes all entries from the hash table */
-static void
-del_module_metrics (GKHashModule * mhash, GModule module, uint8_t free_data) {
-  int i, n = 0;
-  GKHashMetric mtrc;
-
-  n = module_metrics_len;
-  for (i = 0; i < n; i++) {
-    mtrc = mhash[module].metrics[i];
-    mtrc.del (mtrc.hash, free_data);
-  }
-}
-
 /* Destroys all hash tables and possibly all the malloc'd data within */
 static void
 free_stores (GKHashStorage * store) {
@@ -743,31 +771,65 @@ get_store (khash_t (igkh) * hash, uint32_t key) {
   return store;
 }
 
-/* Given a store, a module and the metric, get the hash table
+/* Given a store, a module and the metric, get the metric entry
  *
  * On error or not found, NULL is returned.
- * On success, a pointer to that hash table is returned. */
-static void *
-get_hash_from_store (GKHashStorage * store, int module, GSMetric metric) {
-  int mtrc = 0, cnt = 0;
+ * On success, a pointer to that metric is returned. */
+static GKHashMetric *
+get_store_metric (GKHashStorage * store, int module, GSMetric metric) {
+  int mtrc = 0;
   if (!store)
     return NULL;
 
   if (module == -1) {
     mtrc = metric - MTRC_METADATA - 1;
-    cnt = MTRC_CNT_BW - MTRC_UNIQUE_KEYS + 1;
-    if (mtrc >= cnt) {
+    if (mtrc < 0 || mtrc >= GSMTRC_GLOBAL_TOTAL) {
       LOG_DEBUG (("Out of bounds when attempting to get hash %d\n", metric));
       return NULL;
     }
+  } else if (metric >= GSMTRC_MODULE_TOTAL) {
+    LOG_DEBUG (("Out of bounds when attempting to get hash %d\n", metric));
+    return NULL;
   }
 
   /* ###NOTE: BE CAREFUL here, to avoid the almost unnecessary loop, we simply
    * use the index from the enum to make it O(1). The metrics array has to be
    * created in the same order as the GSMetric enum */
   if (module < 0)
-    return store->ghash->metrics[mtrc].hash;
-  return store->mhash[module].metrics[metric].hash;
+    return &store->ghash->metrics[mtrc];
+  return &store->mhash[module].metrics[metric];
+}
+
+/* Given a store, a module and the metric, get the hash table. Tables of a
+ * date store are only malloc'd on their first write, thus a table that
+ * hasn't been written yet is reported as not found.
+ *
+ * On error or not found, NULL is returned.
+ * On success, a pointer to that hash table is returned. */
+static void *
+get_hash_from_store (GKHashStorage * store, int module, GSMetric metric) {
+  GKHashMetric *mtrc = NULL;
+
+  if (!(mtrc = get_store_metric (store, module, metric)))
+    return NULL;
+  return mtrc->hash;
+}
+
+/* Given a store, a module and the metric, get the hash table to write to,
+ * mallocing it if it hasn't been written before.
+ *
+ * On error, NULL is returned.
+ * On success, a pointer to that hash table is returned. */
+static void *
+put_hash_in_store (GKHashStorage * store, int module, GSMetric metric) {
+  GKHashMetric *mtrc = NULL;
+
+  if (!(mtrc = get_store_metric (store, module, metric)))
+    return NULL;
+  /* modules not in use have no metrics */
+  if (!mtrc->hash && mtrc->alloc)
+    mtrc->hash = mtrc->alloc ();
+  return mtrc->hash;
 }
 
 /* Given a module a key (date) and the metric, get the hash table
@@ -785,6 +847,22 @@ get_hash (int module, uint64_t key, GSMetric metric) {
   return get_hash_from_store (store, module, metric);
 }
 
+/* Given a module a key (date) and the metric, get the hash table to write
+ * to, mallocing it on its first write.
+ *
+ * On error or date not found, NULL is returned.
+ * On success, a pointer to that hash table is returned. */
+void *
+put_hash (int module, uint64_t key, GSMetric metric) {
+  GKHashStorage *store = NULL;
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+
+  if ((store = get_store (hash, key)) == NULL)
+    return NULL;
+  return put_hash_in_store (store, module, metric);
+}
+
 /* Given a module and a metric, get the cache hash table
  *
  * On success, a pointer to that hash table is returned. */
@@ -820,7 +898,8 @@ init_gkhashdb (void) {
   return storage;
 }
 
-/* Initialize a global hash structure.
+/* Initialize a global hash structure. Its hash tables are malloc'd on
+ * their first write.
  *
  * On success, a pointer to that hash structure is returned. */
 static GKHashGlobal *
@@ -831,19 +910,18 @@ init_gkhashglobal (void) {
 
   storage = new_gkhglobal ();
   n = global_metrics_len;
-  for (i = 0; i < n; i++) {
+  for (i = 0; i < n; i++)
     storage->metrics[i] = global_metrics[i];
-    storage->metrics[i].hash = global_metrics[i].alloc ();
-  }
 
   return storage;
 }
 
-/* Initialize a module hash structure.
+/* Initialize a module hash structure. If alloc is not set, its hash
+ * tables are malloc'd on their first write.
  *
  * On success, a pointer to that hash structure is returned. */
 static GKHashModule *
-init_gkhashmodule (void) {
+init_gkhashmodule (uint8_t alloc) {
   GKHashModule *storage = NULL;
   GModule module;
   size_t idx = 0;
@@ -853,7 +931,7 @@ init_gkhashmodule (void) {
     module = module_list[idx];
 
     storage[module].module = module;
-    init_tables (module, storage);
+    init_tables (module, storage, alloc);
   }
 
   return storage;
@@ -882,7 +960,7 @@ ins_igkh (khash_t (igkh) * hash, uint32_t key) {
     return 1;
 
   store = new_gkhstorage ();
-  store->mhash = init_gkhashmodule ();
+  store->mhash = init_gkhashmodule (0);
   store->ghash = init_gkhashglobal ();
 
   kh_val (hash, k) = store;
@@ -939,6 +1017,7 @@ new_db (khash_t (igdb) * hash, uint32_t key) {
   db->cache = NULL;
   db->store = NULL;
   db->logs = NULL;
+  db->strings = new_intern ();
   kh_val (hash, k) = db;
 
   return db;
@@ -1017,13 +1096,13 @@ ins_si32 (khash_t (si32) * hash, const char *key, uint32_t value) {
   return 0;
 }
 
-/* Increment a string key and with the corresponding incremental uint32_t value.
+/* Insert a GUniqKey key and the corresponding incremental uint32_t value.
  * Note: If the key exists, the value is not replaced.
  *
  * On error, 0 is returned.
  * On success or if the key exists, the value is returned */
 static uint32_t
-ins_si32_inc (khash_t (si32) * hash, const char *key,
+ins_bi32_inc (khash_t (bi32) * hash, const GUniqKey * key,
               uint32_t (*cb) (khash_t (si32) *, const char *), khash_t (si32) * seqs,
               const char *seqk) {
   khint_t k;
@@ -1033,13 +1112,17 @@ ins_si32_inc (khash_t (si32) * hash, const char *key,
   if (!hash)
     return 0;
 
-  k = kh_put (si32, hash, key, &ret);
-  /* operation failed, or key exists */
-  if (ret == -1 || ret == 0)
+  k = kh_put (bi32, hash, *key, &ret);
+  if (ret == -1)
     return 0;
+  /* key exists, a single probe to find it or to insert it */
+  if (ret == 0)
+    return kh_val (hash, k);
 
-  if ((value = cb (seqs, seqk)) == 0)
+  if ((value = cb (seqs, seqk)) == 0) {
+    kh_del (bi32, hash, k);
     return 0;
+  }
   kh_val (hash, k) = value;
 
   return value;
@@ -1095,53 +1178,20 @@ ins_is32 (khash_t (is32) * hash, uint32_t key, char *value) {
   return 0;
 }
 
-/* Insert a string key and the corresponding string value.
- * Note: If the key exists, the value is not replaced.
- *
- * On error, -1 is returned.
- * If key exists, 1 is returned.
- * On success 0 is returned */
-static int
-ins_ss32 (khash_t (ss32) * hash, const char *key, const char *value) {
-  khint_t k;
-  int ret;
-  char *dupkey = NULL;
-
-  if (!hash)
-    return -1;
-
-  dupkey = xstrdup (key);
-  k = kh_put (ss32, hash, dupkey, &ret);
-  /* operation failed */
-  if (ret == -1) {
-    free (dupkey);
-    return -1;
-  }
-  /* key exists */
-  if (ret == 0) {
-    free (dupkey);
-    return 1;
-  }
-
-  kh_val (hash, k) = xstrdup (value);
-
-  return 0;
-}
-
-/* Insert an uint32_t key and an uint32_t value
+/* Insert a GUniqKey key and an uint32_t value
  * Note: If the key exists, its value is replaced by the given value.
  *
  * On error, -1 is returned.
  * On success 0 is returned */
 int
-ins_ii32 (khash_t (ii32) * hash, uint32_t key, uint32_t value) {
+ins_bi32 (khash_t (bi32) * hash, GUniqKey key, uint32_t value) {
   khint_t k;
   int ret;
 
   if (!hash)
     return -1;
 
-  k = kh_put (ii32, hash, key, &ret);
+  k = kh_put (bi32, hash, key, &ret);
   if (ret == -1)
     return -1;
 
@@ -1150,20 +1200,20 @@ ins_ii32 (khash_t (ii32) * hash, uint32_t key, uint32_t value) {
   return 0;
 }
 
-/* Insert an uint32_t key and an uint8_t value
+/* Insert an uint32_t key and an uint32_t value
  * Note: If the key exists, its value is replaced by the given value.
  *
  * On error, -1 is returned.
  * On success 0 is returned */
 int
-ins_ii08 (khash_t (ii08) * hash, uint32_t key, uint8_t value) {
+ins_ii32 (khash_t (ii32) * hash, uint32_t key, uint32_t value) {
   khint_t k;
   int ret;
 
   if (!hash)
     return -1;
 
-  k = kh_put (ii08, hash, key, &ret);
+  k = kh_put (ii32, hash, key, &ret);
   if (ret == -1)
     return -1;
 
@@ -1361,24 +1411,21 @@ inc_si32 (khash_t (si32) * hash, const char *key, uint32_t inc) {
   return value;
 }
 
-/* Insert a string key and auto increment int value.
+/* Insert an uint32_t key and auto increment int value. The value is
+ * taken from the given sequence rather than from the size of the hash,
+ * so values of deleted keys are never handed out again.
  *
  * On error, 0 is returned.
  * On key found, the stored value is returned
  * On success the value of the key inserted is returned */
 static uint32_t
-ins_ii32_ai (khash_t (ii32) * hash, uint32_t key) {
-  int size = 0, value = 0;
+ins_ii32_ai (khash_t (ii32) * hash, uint32_t key, uint32_t * seq) {
   int ret;
   khint_t k;
 
   if (!hash)
     return 0;
 
-  size = kh_size (hash);
-  /* the auto increment value starts at SIZE (hash table) + 1 */
-  value = size > 0 ? size + 1 : 1;
-
   k = kh_put (ii32, hash, key, &ret);
   /* operation failed */
   if (ret == -1)
@@ -1387,9 +1434,101 @@ ins_ii32_ai (khash_t (ii32) * hash, uint32_t key) {
   if (ret == 0)
     return kh_val (hash, k);
 
-  kh_val (hash, k) = value;
+  kh_val (hash, k) = ++(*seq);
 
-  return value;
+  return kh_val (hash, k);
+}
+
+/* Get the record of a given uint32_t key and create an empty one if the
+ * key does not exist.
+ *
+ * Note: The returned pointer is only valid until the next insertion into
+ * the same hash table.
+ *
+ * On error, NULL is returned.
+ * On success a pointer to the record within the hash table is returned */
+static GKeyRecord *
+put_igrc (khash_t (igrc) * hash, uint32_t key) {
+  GKeyRecord empty = { 0 };
+  khint_t k;
+  int ret;
+
+  if (!hash)
+    return NULL;
+
+  k = kh_put (igrc, hash, key, &ret);
+  if (ret == -1)
+    return NULL;
+
+  /* new key, start with all metrics unset */
+  if (ret != 0)
+    kh_val (hash, k) = empty;
+
+  return &kh_val (hash, k);
+}
+
+/* Insert a single metric into the record of a given uint32_t key.
+ * Note: If the metric is already set, its value is replaced by the given
+ * value.
+ *
+ * On error, -1 is returned.
+ * On success 0 is returned */
+int
+ins_igrc (khash_t (igrc) * hash, uint32_t key, GSMetric metric, uint64_t value) {
+  GKeyRecord *record = NULL;
+
+  if (!(record = put_igrc (hash, key)))
+    return -1;
+
+  switch (metric) {
+  case MTRC_ROOT:
+    record->root = value;
+    break;
+  case MTRC_HITS:
+    record->hits = value;
+    break;
+  case MTRC_VISITORS:
+    record->visitors = value;
+    break;
+  case MTRC_BW:
+    record->bw = value;
+    break;
+  case MTRC_CUMTS:
+    record->cumts = value;
+    break;
+  case MTRC_MAXTS:
+    record->maxts = value;
+    break;
+  case MTRC_METHODS:
+    record->method = value;
+    break;
+  case MTRC_PROTOCOLS:
+    record->protocol = value;
+    break;
+  default:
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Merge the metrics of a record into another record. Counters are added up,
+ * the maximum time served is kept, and the root, method and protocol are
+ * replaced when set. */
+static void
+merge_igrc (GKeyRecord * dst, const GKeyRecord * src, uint32_t root) {
+  dst->hits += src->hits;
+  dst->visitors += src->visitors;
+  dst->bw += src->bw;
+  dst->cumts += src->cumts;
+  if (dst->maxts < src->maxts)
+    dst->maxts = src->maxts;
+  if (root)
+    dst->root = root;
+  if (src->method)
+    dst->method = src->method;
+  if (src->protocol)
+    dst->protocol = src->protocol;
 }
 
 /* Compare if the given needle is in the haystack
@@ -1474,25 +1613,6 @@ get_si08 (khash_t (si08) * hash, const char *key) {
   return 0;
 }
 
-/* Get the uint8_t value of a given string key.
- *
- * On error, 0 is returned.
- * On success the uint8_t value for the given key is returned */
-static uint8_t
-get_ii08 (khash_t (ii08) * hash, uint32_t key) {
-  khint_t k;
-
-  if (!hash)
-    return 0;
-
-  k = kh_get (ii08, hash, key);
-  /* key found, return current value */
-  if (k != kh_end (hash))
-    return kh_val (hash, k);
-
-  return 0;
-}
-
 /* Get the string value of a given uint32_t key.
  *
  * On error, NULL is returned.
@@ -1513,26 +1633,6 @@ get_is32 (khash_t (is32) * hash, uint32_t key) {
   return NULL;
 }
 
-/* Get the string value of a given string key.
- *
- * On error, NULL is returned.
- * On success the string value for the given key is returned */
-static char *
-get_ss32 (khash_t (ss32) * hash, const char *key) {
-  khint_t k;
-  char *value = NULL;
-
-  if (!hash)
-    return NULL;
-
-  k = kh_get (ss32, hash, key);
-  /* key found, return current value */
-  if (k != kh_end (hash) && (value = kh_val (hash, k)))
-    return xstrdup (value);
-
-  return NULL;
-}
-
 /* Get the uint32_t value of a given uint32_t key.
  *
  * If key is not found, 0 is returned.
@@ -1617,6 +1717,56 @@ get_iglp (khash_t (iglp) * hash, uint32_t key) {
   return lp;
 }
 
+/* Get the record of a given uint32_t key.
+ *
+ * On error, or if key is not found, NULL is returned.
+ * On success a pointer to the record within the hash table is returned */
+static const GKeyRecord *
+get_igrc (khash_t (igrc) * hash, uint32_t key) {
+  khint_t k;
+
+  if (!hash)
+    return NULL;
+
+  k = kh_get (igrc, hash, key);
+  /* key found, return current record */
+  if (k != kh_end (hash))
+    return &kh_val (hash, k);
+
+  return NULL;
+}
+
+/* Get the value of a single metric of a record.
+ *
+ * On error, or if record is NULL, 0 is returned.
+ * On success the value of the metric is returned */
+uint64_t
+get_igrc_field (const GKeyRecord * record, GSMetric metric) {
+  if (!record)
+    return 0;
+
+  switch (metric) {
+  case MTRC_ROOT:
+    return record->root;
+  case MTRC_HITS:
+    return record->hits;
+  case MTRC_VISITORS:
+    return record->visitors;
+  case MTRC_BW:
+    return record->bw;
+  case MTRC_CUMTS:
+    return record->cumts;
+  case MTRC_MAXTS:
+    return record->maxts;
+  case MTRC_METHODS:
+    return record->method;
+  case MTRC_PROTOCOLS:
+    return record->protocol;
+  default:
+    return 0;
+  }
+}
+
 GSLList *
 ht_get_keymap_list_from_key (GModule module, uint32_t key) {
   GKDB *db = get_db_instance (DB_INSTANCE);
@@ -1643,26 +1793,28 @@ ht_get_keymap_list_from_key (GModule module, uint32_t key) {
   return list;
 }
 
-/* Iterate over all the key/value pairs for the given hash structure
- * and set the maximum and minimum values found on an integer key and
- * integer value.
+/* Iterate over all the records for the given hash structure and set the
+ * maximum and minimum values found on the given metric.
  *
- * Note: This are expensive calls since it has to iterate over all
- * key-value pairs
+ * Note: Bandwidth and time served are always set on a record, while the rest
+ * of the metrics only count when they are not zero, as if they were stored
+ * on their own hash structure.
  *
  * If the hash structure is empty, no values are set.
  * On success the minimum and maximum values are set. */
 static void
-get_ii32_min_max (khash_t (ii32) * hash, uint32_t * min, uint32_t * max) {
+get_igrc_min_max (khash_t (igrc) * hash, GSMetric metric, uint64_t * min, uint64_t * max) {
   khint_t k;
-  uint32_t curvalue = 0;
+  uint64_t curvalue = 0;
   int i;
 
   for (i = 0, k = kh_begin (hash); k != kh_end (hash); ++k) {
     if (!kh_exist (hash, k))
       continue;
 
-    curvalue = kh_value (hash, k);
+    curvalue = get_igrc_field (&kh_val (hash, k), metric);
+    if (curvalue == 0 && metric != MTRC_BW && metric != MTRC_CUMTS)
+      continue;
     if (i++ == 0)
       *min = curvalue;
     if (curvalue > *max)
@@ -1672,58 +1824,40 @@ get_ii32_min_max (khash_t (ii32) * hash, uint32_t * min, uint32_t * max) {
   }
 }
 
-/* Iterate over all the key/value pairs for the given hash structure
- * and set the maximum and minimum values found on an integer key and
- * a uint64_t value.
- *
- * Note: This are expensive calls since it has to iterate over all
- * key-value pairs
+/* Get the number of elements in a dates hash.
  *
- * If the hash structure is empty, no values are set.
- * On success the minimum and maximum values are set. */
-static void
-get_iu64_min_max (khash_t (iu64) * hash, uint64_t * min, uint64_t * max) {
-  khint_t k;
-  uint64_t curvalue = 0;
-  int i;
+ * Return 0 if the operation fails, else number of elements. */
+uint32_t
+ht_get_size_dates (void) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
 
-  for (i = 0, k = kh_begin (hash); k != kh_end (hash); ++k) {
-    if (!kh_exist (hash, k))
-      continue;
+  if (!hash)
+    return 0;
 
-    curvalue = kh_value (hash, k);
-    if (i++ == 0)
-      *min = curvalue;
-    if (curvalue > *max)
-      *max = curvalue;
-    if (curvalue < *min)
-      *min = curvalue;
-  }
+  return kh_size (hash);
 }
 
-/* Get the number of elements in a dates hash.
- *
- * Return 0 if the operation fails, else number of elements. */
 uint32_t
-ht_get_size_dates (void) {
+ht_get_excluded_ips (void) {
   GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  khash_t (si32) * hash = get_hdb (db, MTRC_CNT_OVERALL);
 
   if (!hash)
     return 0;
 
-  return kh_size (hash);
+  return get_si32 (hash, "excluded_ip");
 }
 
 uint32_t
-ht_get_excluded_ips (void) {
+ht_get_prefiltered (void) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (si32) * hash = get_hdb (db, MTRC_CNT_OVERALL);
 
   if (!hash)
     return 0;
 
-  return get_si32 (hash, "excluded_ip");
+  return get_si32 (hash, "prefiltered");
 }
 
 uint32_t
@@ -1801,6 +1935,21 @@ ht_sum_bw (void) {
   return sum;
 }
 
+/* Get the numeric value of a given method or protocol string.
+ *
+ * On error, or if key is not found, 0 is returned.
+ * On success the uint8_t value for the given key is returned */
+uint8_t
+ht_get_meth_proto (const char *key) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (si08) * hash = get_hdb (db, MTRC_METH_PROTO);
+
+  if (!hash)
+    return 0;
+
+  return get_si08 (hash, key);
+}
+
 uint8_t
 ht_insert_meth_proto (const char *key) {
   GKDB *db = get_db_instance (DB_INSTANCE);
@@ -1854,7 +2003,7 @@ ht_inc_cnt_overall (const char *key, uint32_t val) {
 
 uint32_t
 ht_inc_cnt_valid (uint32_t date, uint32_t inc) {
-  khash_t (ii32) * hash = get_hash (-1, date, MTRC_CNT_VALID);
+  khash_t (ii32) * hash = put_hash (-1, date, MTRC_CNT_VALID);
 
   if (!hash)
     return 0;
@@ -1864,7 +2013,7 @@ ht_inc_cnt_valid (uint32_t date, uint32_t inc) {
 
 int
 ht_inc_cnt_bw (uint32_t date, uint64_t inc) {
-  khash_t (iu64) * hash = get_hash (-1, date, MTRC_CNT_BW);
+  khash_t (iu64) * hash = put_hash (-1, date, MTRC_CNT_BW);
 
   if (!hash)
     return 0;
@@ -1904,30 +2053,22 @@ u64decode (uint64_t n, uint32_t * x, uint32_t * y) {
   *y = (uint64_t) n & 0xFFFFFFFF;
 }
 
-/* Insert a unique visitor key string (IP/DATE/UA), mapped to an auto
+/* Insert a unique visitor binary key (DATE/UA/IP), mapped to an auto
  * incremented value.
  *
  * If the given key exists, its value is returned.
  * On error, 0 is returned.
  * On success the value of the key inserted is returned */
 uint32_t
-ht_insert_unique_key (uint32_t date, const char *key) {
+ht_insert_unique_key (uint32_t date, const GUniqKey * key) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (si32) * seqs = get_hdb (db, MTRC_SEQS);
-  khash_t (si32) * hash = get_hash (-1, date, MTRC_UNIQUE_KEYS);
-  uint32_t val = 0;
-  char *dupkey = NULL;
+  khash_t (bi32) * hash = put_hash (-1, date, MTRC_UNIQUE_KEYS);
 
   if (!hash)
     return 0;
 
-  if ((val = get_si32 (hash, key)) != 0)
-    return val;
-
-  dupkey = xstrdup (key);
-  if ((val = ins_si32_inc (hash, dupkey, ht_ins_seq, seqs, "ht_unique_keys")) == 0)
-    free (dupkey);
-  return val;
+  return ins_bi32_inc (hash, key, ht_ins_seq, seqs, "ht_unique_keys");
 }
 
 /* Insert a user agent key string, mapped to an auto incremented value.
@@ -1939,7 +2080,7 @@ uint32_t
 ht_insert_agent_key (uint32_t date, uint32_t key) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (si32) * seqs = get_hdb (db, MTRC_SEQS);
-  khash_t (ii32) * hash = get_hash (-1, date, MTRC_AGENT_KEYS);
+  khash_t (ii32) * hash = put_hash (-1, date, MTRC_AGENT_KEYS);
   uint32_t val = 0;
 
   if (!hash)
@@ -1957,7 +2098,7 @@ ht_insert_agent_key (uint32_t date, uint32_t key) {
  * On success 0 is returned */
 int
 ht_insert_agent_value (uint32_t date, uint32_t key, char *value) {
-  khash_t (is32) * hash = get_hash (-1, date, MTRC_AGENT_VALS);
+  khash_t (is32) * hash = put_hash (-1, date, MTRC_AGENT_VALS);
   char *dupval = NULL;
 
   if (!hash)
@@ -1972,7 +2113,7 @@ ht_insert_agent_value (uint32_t date, uint32_t key, char *value) {
   return 0;
 }
 
-/* Insert a keymap string key.
+/* Insert a keymap interned string key.
  *
  * If the given key exists, its value is returned.
  * On error, 0 is returned.
@@ -1981,7 +2122,7 @@ uint32_t
 ht_insert_keymap (GModule module, uint32_t date, uint32_t key, uint32_t * ckey) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (si32) * seqs = get_hdb (db, MTRC_SEQS);
-  khash_t (ii32) * hash = get_hash (module, date, MTRC_KEYMAP);
+  khash_t (ii32) * hash = put_hash (module, date, MTRC_KEYMAP);
   khash_t (ii32) * cache = get_hash_from_cache (module, MTRC_KEYMAP);
 
   uint32_t val = 0;
@@ -2000,12 +2141,22 @@ ht_insert_keymap (GModule module, uint32_t date, uint32_t key, uint32_t * ckey)
     free (modstr);
     return val;
   }
-  *ckey = ins_ii32_ai (cache, key);
+  *ckey = ins_ii32_ai (cache, key, &db->cache_seqs[module]);
   free (modstr);
 
   return val;
 }
 
+/* Intern the given data or root key string.
+ *
+ * On error, 0 is returned.
+ * On success the id of the interned string is returned */
+uint32_t
+ht_insert_string (const char *str) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  return intern_str (db->strings, str);
+}
+
 /* Insert a uniqmap string key.
  *
  * If the given key exists, 0 is returned.
@@ -2013,7 +2164,7 @@ ht_insert_keymap (GModule module, uint32_t date, uint32_t key, uint32_t * ckey)
  * On success the value of the key inserted is returned */
 int
 ht_insert_uniqmap (GModule module, uint32_t date, uint32_t key, uint32_t value) {
-  khash_t (u648) * hash = get_hash (module, date, MTRC_UNIQMAP);
+  khash_t (u648) * hash = put_hash (module, date, MTRC_UNIQMAP);
   uint64_t k = 0;
 
   if (!hash)
@@ -2030,19 +2181,23 @@ ht_insert_uniqmap (GModule module, uint32_t date, uint32_t key, uint32_t value)
 int
 ht_insert_datamap (GModule module, uint32_t date, uint32_t key, const char *value,
                    uint32_t ckey) {
-  khash_t (is32) * hash = get_hash (module, date, MTRC_DATAMAP);
+  khash_t (is32) * hash = put_hash (module, date, MTRC_DATAMAP);
   khash_t (is32) * cache = get_hash_from_cache (module, MTRC_DATAMAP);
-  char *dupval = NULL;
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  char *str = NULL;
   int ret = 0;
 
   if (!hash)
     return -1;
 
-  dupval = xstrdup (value);
-  if ((ret = ins_is32 (hash, key, dupval)) == 0)
-    ins_is32 (cache, ckey, dupval);
-  else
-    free (dupval);
+  /* intern the value only when inserting a new key */
+  if ((kh_get (is32, hash, key)) != kh_end (hash))
+    return -1;
+
+  if (!(str = intern_get (db->strings, intern_str (db->strings, value))))
+    return -1;
+  if ((ret = ins_is32 (hash, key, str)) == 0)
+    ins_is32 (cache, ckey, str);
 
   return ret;
 }
@@ -2055,175 +2210,63 @@ ht_insert_datamap (GModule module, uint32_t date, uint32_t key, const char *valu
 int
 ht_insert_rootmap (GModule module, uint32_t date, uint32_t key, const char *value,
                    uint32_t ckey) {
-  khash_t (is32) * hash = get_hash (module, date, MTRC_ROOTMAP);
+  khash_t (is32) * hash = put_hash (module, date, MTRC_ROOTMAP);
   khash_t (is32) * cache = get_hash_from_cache (module, MTRC_ROOTMAP);
-  char *dupval = NULL;
-  int ret = 0;
-
-  if (!hash)
-    return -1;
-
-  dupval = xstrdup (value);
-  if ((ret = ins_is32 (hash, key, dupval)) == 0)
-    ins_is32 (cache, ckey, dupval);
-  else
-    free (dupval);
-
-  return ret;
-}
-
-/* Insert a data uint32_t key mapped to the corresponding uint32_t root key.
- *
- * On error, -1 is returned.
- * On success 0 is returned */
-int
-ht_insert_root (GModule module, uint32_t date, uint32_t key, uint32_t value, uint32_t dkey,
-                uint32_t rkey) {
-  khash_t (ii32) * hash = get_hash (module, date, MTRC_ROOT);
-  khash_t (ii32) * cache = get_hash_from_cache (module, MTRC_ROOT);
-
-  if (!hash)
-    return -1;
-
-  ins_ii32 (cache, dkey, rkey);
-  return ins_ii32 (hash, key, value);
-}
-
-/* Increases hits counter from a uint32_t key.
- *
- * On error, 0 is returned.
- * On success the inserted value is returned */
-uint32_t
-ht_insert_hits (GModule module, uint32_t date, uint32_t key, uint32_t inc, uint32_t ckey) {
-  khash_t (ii32) * hash = get_hash (module, date, MTRC_HITS);
-  khash_t (ii32) * cache = get_hash_from_cache (module, MTRC_HITS);
-
-  if (!hash)
-    return 0;
-
-  inc_ii32 (cache, ckey, inc);
-  return inc_ii32 (hash, key, inc);
-}
-
-/* Increases visitors counter from a uint32_t key.
- *
- * On error, 0 is returned.
- * On success the inserted value is returned */
-uint32_t
-ht_insert_visitor (GModule module, uint32_t date, uint32_t key, uint32_t inc, uint32_t ckey) {
-  khash_t (ii32) * hash = get_hash (module, date, MTRC_VISITORS);
-  khash_t (ii32) * cache = get_hash_from_cache (module, MTRC_VISITORS);
-
-  if (!hash)
-    return 0;
-
-  inc_ii32 (cache, ckey, inc);
-  return inc_ii32 (hash, key, inc);
-}
-
-/* Increases bandwidth counter from a uint32_t key.
- *
- * On error, -1 is returned.
- * On success 0 is returned */
-int
-ht_insert_bw (GModule module, uint32_t date, uint32_t key, uint64_t inc, uint32_t ckey) {
-  khash_t (iu64) * hash = get_hash (module, date, MTRC_BW);
-  khash_t (iu64) * cache = get_hash_from_cache (module, MTRC_BW);
-
-  if (!hash)
-    return -1;
-
-  inc_iu64 (cache, ckey, inc);
-  return inc_iu64 (hash, key, inc);
-}
-
-/* Increases cumulative time served counter from a uint32_t key.
- *
- * On error, -1 is returned.
- * On success 0 is returned */
-int
-ht_insert_cumts (GModule module, uint32_t date, uint32_t key, uint64_t inc, uint32_t ckey) {
-  khash_t (iu64) * hash = get_hash (module, date, MTRC_CUMTS);
-  khash_t (iu64) * cache = get_hash_from_cache (module, MTRC_CUMTS);
-
-  if (!hash)
-    return -1;
-
-  inc_iu64 (cache, ckey, inc);
-  return inc_iu64 (hash, key, inc);
-}
-
-/* Insert the maximum time served counter from a uint32_t key.
- * Note: it compares the current value with the given value.
- *
- * On error, -1 is returned.
- * On success 0 is returned */
-int
-ht_insert_maxts (GModule module, uint32_t date, uint32_t key, uint64_t value, uint32_t ckey) {
-  khash_t (iu64) * hash = get_hash (module, date, MTRC_MAXTS);
-  khash_t (iu64) * cache = get_hash_from_cache (module, MTRC_MAXTS);
-
-  if (!hash)
-    return -1;
-
-  if (get_iu64 (cache, ckey) < value)
-    ins_iu64 (cache, ckey, value);
-  if (get_iu64 (hash, key) < value)
-    ins_iu64 (hash, key, value);
-
-  return 0;
-}
-
-/* Insert a method given an uint32_t key and string value.
- *
- * On error, or if key exists, -1 is returned.
- * On success 0 is returned */
-int
-ht_insert_method (GModule module, uint32_t date, uint32_t key, const char *value,
-                  uint32_t ckey) {
   GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (ii08) * hash = get_hash (module, date, MTRC_METHODS);
-  khash_t (ii08) * cache = get_hash_from_cache (module, MTRC_METHODS);
-  khash_t (si08) * mtpr = get_hdb (db, MTRC_METH_PROTO);
+  char *str = NULL;
   int ret = 0;
-  uint8_t val = 0;
 
   if (!hash)
     return -1;
 
-  if (!(val = get_si08 (mtpr, value)))
+  /* intern the value only when inserting a new key */
+  if ((kh_get (is32, hash, key)) != kh_end (hash))
     return -1;
 
-  if ((ret = ins_ii08 (hash, key, val)) == 0)
-    ins_ii08 (cache, ckey, val);
+  if (!(str = intern_get (db->strings, intern_str (db->strings, value))))
+    return -1;
+  if ((ret = ins_is32 (hash, key, str)) == 0)
+    ins_is32 (cache, ckey, str);
 
   return ret;
 }
 
-/* Insert a protocol given an uint32_t key and string value.
+/* Insert all the numeric metrics of a data key given a record collected while
+ * processing a log line. The date store is looked up once and the record is
+ * found with a single probe on both, the date store and the cache. It also
+ * increases the module meta data counters.
  *
- * On error, or if key exists, -1 is returned.
+ * On error, -1 is returned.
  * On success 0 is returned */
 int
-ht_insert_protocol (GModule module, uint32_t date, uint32_t key, const char *value,
-                    uint32_t ckey) {
+ht_insert_record (GModule module, uint32_t date, uint32_t key, uint32_t ckey, uint32_t crkey,
+                  const GKeyRecord * record) {
   GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (ii08) * hash = get_hash (module, date, MTRC_PROTOCOLS);
-  khash_t (ii08) * cache = get_hash_from_cache (module, MTRC_PROTOCOLS);
-  khash_t (si08) * mtpr = get_hdb (db, MTRC_METH_PROTO);
-  int ret = 0;
-  uint8_t val = 0;
-
-  if (!hash)
-    return -1;
+  GKHashStorage *store = get_store (get_hdb (db, MTRC_DATES), date);
+  khash_t (igrc) * hash = put_hash_in_store (store, module, MTRC_RECORDS);
+  khash_t (igrc) * cache = db->cache[module].metrics[MTRC_RECORDS].hash;
+  khash_t (su64) * meta = put_hash_in_store (store, module, MTRC_METADATA);
+  GKeyRecord *dst = NULL;
 
-  if (!(val = get_si08 (mtpr, value)))
+  if (!(dst = put_igrc (hash, key)))
     return -1;
+  merge_igrc (dst, record, record->root);
+
+  if ((dst = put_igrc (cache, ckey)))
+    merge_igrc (dst, record, record->root ? crkey : 0);
+
+  if (record->hits)
+    inc_su64 (meta, "hits", record->hits);
+  if (record->visitors)
+    inc_su64 (meta, "visitors", record->visitors);
+  if (record->bw)
+    inc_su64 (meta, "bytes", record->bw);
+  if (record->cumts)
+    inc_su64 (meta, "cumts", record->cumts);
+  if (record->maxts)
+    inc_su64 (meta, "maxts", record->maxts);
 
-  if ((ret = ins_ii08 (hash, key, val)) == 0)
-    ins_ii08 (cache, ckey, val);
-
-  return ret;
+  return 0;
 }
 
 /* Insert an agent for a hostname given an uint32_t key and uint32_t value.
@@ -2232,7 +2275,7 @@ ht_insert_protocol (GModule module, uint32_t date, uint32_t key, const char *val
  * On success 0 is returned */
 int
 ht_insert_agent (GModule module, uint32_t date, uint32_t key, uint32_t value) {
-  khash_t (igsl) * hash = get_hash (module, date, MTRC_AGENTS);
+  khash_t (igsl) * hash = put_hash (module, date, MTRC_AGENTS);
 
   if (!hash)
     return -1;
@@ -2240,35 +2283,6 @@ ht_insert_agent (GModule module, uint32_t date, uint32_t key, uint32_t value) {
   return ins_igsl (hash, key, value);
 }
 
-/* Insert meta data counters from a string key.
- *
- * On error, -1 is returned.
- * On success 0 is returned */
-int
-ht_insert_meta_data (GModule module, uint32_t date, const char *key, uint64_t value) {
-  khash_t (su64) * hash = get_hash (module, date, MTRC_METADATA);
-
-  if (!hash)
-    return -1;
-
-  return inc_su64 (hash, key, value);
-}
-
-/* Insert an IP hostname mapped to the corresponding hostname.
- *
- * On error, or if key exists, -1 is returned.
- * On success 0 is returned */
-int
-ht_insert_hostname (const char *ip, const char *host) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (ss32) * hash = get_hdb (db, MTRC_HOSTNAMES);
-
-  if (!hash)
-    return -1;
-
-  return ins_ss32 (hash, ip, host);
-}
-
 /* Insert a JSON log format specification such as request.method => %m.
  *
  * On error -1 is returned.
@@ -2361,6 +2375,27 @@ ht_get_datamap (GModule module, uint32_t key) {
   return get_is32 (cache, key);
 }
 
+/* Get the id of an interned data or root key string.
+ *
+ * If the string was never interned, 0 is returned.
+ * On success the id of the string is returned */
+uint32_t
+ht_get_string_id (const char *str) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  return intern_find (db->strings, str);
+}
+
+/* Get an interned string given its id. Note that the string belongs to
+ * the intern pool.
+ *
+ * On error, or if not found, NULL is returned.
+ * On success the string is returned */
+char *
+ht_get_string (uint32_t id) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  return intern_get (db->strings, id);
+}
+
 /* Get the string root from MTRC_ROOTMAP given an uint32_t data key.
  *
  * On error, NULL is returned.
@@ -2368,14 +2403,14 @@ ht_get_datamap (GModule module, uint32_t key) {
 char *
 ht_get_root (GModule module, uint32_t key) {
   int root_key = 0;
-  khash_t (ii32) * hashroot = get_hash_from_cache (module, MTRC_ROOT);
+  khash_t (igrc) * hashroot = get_hash_from_cache (module, MTRC_RECORDS);
   khash_t (is32) * hashrootmap = get_hash_from_cache (module, MTRC_ROOTMAP);
 
   if (!hashroot || !hashrootmap)
     return NULL;
 
   /* not found */
-  if ((root_key = get_ii32 (hashroot, key)) == 0)
+  if ((root_key = get_igrc_field (get_igrc (hashroot, key), MTRC_ROOT)) == 0)
     return NULL;
 
   return get_is32 (hashrootmap, root_key);
@@ -2389,12 +2424,12 @@ ht_get_root (GModule module, uint32_t key) {
  * On success the int value for the given key is returned */
 uint32_t
 ht_get_hits (GModule module, int key) {
-  khash_t (ii32) * cache = get_hash_from_cache (module, MTRC_HITS);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
 
   if (!cache)
     return 0;
 
-  return get_ii32 (cache, key);
+  return get_igrc_field (get_igrc (cache, key), MTRC_HITS);
 }
 
 /* Get the uint32_t visitors value from MTRC_VISITORS given an uint32_t key.
@@ -2404,12 +2439,12 @@ ht_get_hits (GModule module, int key) {
  * On success the uint32_t value for the given key is returned */
 uint32_t
 ht_get_visitors (GModule module, uint32_t key) {
-  khash_t (ii32) * cache = get_hash_from_cache (module, MTRC_VISITORS);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
 
   if (!cache)
     return 0;
 
-  return get_ii32 (cache, key);
+  return get_igrc_field (get_igrc (cache, key), MTRC_VISITORS);
 }
 
 /* Get the uint64_t value from MTRC_BW given an uint32_t key.
@@ -2418,12 +2453,12 @@ ht_get_visitors (GModule module, uint32_t key) {
  * On success the uint64_t value for the given key is returned */
 uint64_t
 ht_get_bw (GModule module, uint32_t key) {
-  khash_t (iu64) * cache = get_hash_from_cache (module, MTRC_BW);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
 
   if (!cache)
     return 0;
 
-  return get_iu64 (cache, key);
+  return get_igrc_field (get_igrc (cache, key), MTRC_BW);
 }
 
 /* Get the uint64_t value from MTRC_CUMTS given an uint32_t key.
@@ -2432,12 +2467,12 @@ ht_get_bw (GModule module, uint32_t key) {
  * On success the uint64_t value for the given key is returned */
 uint64_t
 ht_get_cumts (GModule module, uint32_t key) {
-  khash_t (iu64) * cache = get_hash_from_cache (module, MTRC_CUMTS);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
 
   if (!cache)
     return 0;
 
-  return get_iu64 (cache, key);
+  return get_igrc_field (get_igrc (cache, key), MTRC_CUMTS);
 }
 
 /* Get the uint64_t value from MTRC_MAXTS given an uint32_t key.
@@ -2446,12 +2481,12 @@ ht_get_cumts (GModule module, uint32_t key) {
  * On success the uint64_t value for the given key is returned */
 uint64_t
 ht_get_maxts (GModule module, uint32_t key) {
-  khash_t (iu64) * cache = get_hash_from_cache (module, MTRC_MAXTS);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
 
   if (!cache)
     return 0;
 
-  return get_iu64 (cache, key);
+  return get_igrc_field (get_igrc (cache, key), MTRC_MAXTS);
 }
 
 /* Get the string value from MTRC_METHODS given an uint32_t key.
@@ -2461,12 +2496,12 @@ ht_get_maxts (GModule module, uint32_t key) {
 char *
 ht_get_method (GModule module, uint32_t key) {
   GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (ii08) * cache = get_hash_from_cache (module, MTRC_METHODS);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
   khash_t (si08) * mtpr = get_hdb (db, MTRC_METH_PROTO);
   uint8_t val = 0;
   khint_t k;
 
-  if (!(val = get_ii08 (cache, key)))
+  if (!(val = get_igrc_field (get_igrc (cache, key), MTRC_METHODS)))
     return NULL;
 
   for (k = kh_begin (mtpr); k != kh_end (mtpr); ++k) {
@@ -2483,12 +2518,12 @@ ht_get_method (GModule module, uint32_t key) {
 char *
 ht_get_protocol (GModule module, uint32_t key) {
   GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (ii08) * cache = get_hash_from_cache (module, MTRC_PROTOCOLS);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
   khash_t (si08) * mtpr = get_hdb (db, MTRC_METH_PROTO);
   uint8_t val = 0;
   khint_t k;
 
-  if (!(val = get_ii08 (cache, key)))
+  if (!(val = get_igrc_field (get_igrc (cache, key), MTRC_PROTOCOLS)))
     return NULL;
 
   for (k = kh_begin (mtpr); k != kh_end (mtpr); ++k) {
@@ -2498,36 +2533,6 @@ ht_get_protocol (GModule module, uint32_t key) {
   return NULL;
 }
 
-/* Get the string value from ht_hostnames given a string key (IP).
- *
- * On error, NULL is returned.
- * On success the string value for the given key is returned */
-char *
-ht_get_hostname (const char *host) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (ss32) * hash = get_hdb (db, MTRC_HOSTNAMES);
-
-  if (!hash)
-    return NULL;
-
-  return get_ss32 (hash, host);
-}
-
-/* Get the string value from ht_json_logfmt given a JSON specifier key.
- *
- * On error, NULL is returned.
- * On success the string value for the given key is returned */
-char *
-ht_get_json_logfmt (const char *key) {
-  GKDB *db = get_db_instance (DB_INSTANCE);
-  khash_t (ss32) * hash = get_hdb (db, MTRC_JSON_LOGFMT);
-
-  if (!hash)
-    return NULL;
-
-  return get_ss32 (hash, key);
-}
-
 /* Get the string value from ht_agent_vals (user agent) given an uint32_t key.
  *
  * On error, NULL is returned.
@@ -2630,12 +2635,15 @@ ht_get_meta_data (GModule module, const char *key) {
  * On success the minimum and maximum values are set. */
 void
 ht_get_hits_min_max (GModule module, uint32_t * min, uint32_t * max) {
-  khash_t (ii32) * cache = get_hash_from_cache (module, MTRC_HITS);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
+  uint64_t min64 = *min, max64 = *max;
 
   if (!cache)
     return;
 
-  get_ii32_min_max (cache, min, max);
+  get_igrc_min_max (cache, MTRC_HITS, &min64, &max64);
+  *min = min64;
+  *max = max64;
 }
 
 /* Set the maximum and minimum values found on an integer key and
@@ -2645,12 +2653,15 @@ ht_get_hits_min_max (GModule module, uint32_t * min, uint32_t * max) {
  * On success the minimum and maximum values are set. */
 void
 ht_get_visitors_min_max (GModule module, uint32_t * min, uint32_t * max) {
-  khash_t (ii32) * cache = get_hash_from_cache (module, MTRC_VISITORS);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
+  uint64_t min64 = *min, max64 = *max;
 
   if (!cache)
     return;
 
-  get_ii32_min_max (cache, min, max);
+  get_igrc_min_max (cache, MTRC_VISITORS, &min64, &max64);
+  *min = min64;
+  *max = max64;
 }
 
 /* Set the maximum and minimum values found on an integer key and
@@ -2660,12 +2671,12 @@ ht_get_visitors_min_max (GModule module, uint32_t * min, uint32_t * max) {
  * On success the minimum and maximum values are set. */
 void
 ht_get_bw_min_max (GModule module, uint64_t * min, uint64_t * max) {
-  khash_t (iu64) * cache = get_hash_from_cache (module, MTRC_BW);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
 
   if (!cache)
     return;
 
-  get_iu64_min_max (cache, min, max);
+  get_igrc_min_max (cache, MTRC_BW, min, max);
 }
 
 /* Set the maximum and minimum values found on an integer key and
@@ -2675,12 +2686,12 @@ ht_get_bw_min_max (GModule module, uint64_t * min, uint64_t * max) {
  * On success the minimum and maximum values are set. */
 void
 ht_get_cumts_min_max (GModule module, uint64_t * min, uint64_t * max) {
-  khash_t (iu64) * cache = get_hash_from_cache (module, MTRC_CUMTS);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
 
   if (!cache)
     return;
 
-  get_iu64_min_max (cache, min, max);
+  get_igrc_min_max (cache, MTRC_CUMTS, min, max);
 }
 
 /* Set the maximum and minimum values found on an integer key and
@@ -2690,12 +2701,12 @@ ht_get_cumts_min_max (GModule module, uint64_t * min, uint64_t * max) {
  * On success the minimum and maximum values are set. */
 void
 ht_get_maxts_min_max (GModule module, uint64_t * min, uint64_t * max) {
-  khash_t (iu64) * cache = get_hash_from_cache (module, MTRC_MAXTS);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
 
   if (!cache)
     return;
 
-  get_iu64_min_max (cache, min, max);
+  get_igrc_min_max (cache, MTRC_MAXTS, min, max);
 }
 
 uint32_t *
@@ -2732,45 +2743,271 @@ destroy_date_stores (int date) {
   kh_del (igkh, hash, k);
 }
 
+/* Move the keys of the given keymap over to their id on the new intern
+ * pool. */
+static void
+remap_keymap (khash_t (ii32) * hash, const GIntern * old, GIntern * pool) {
+  uint32_t *keys = NULL, *vals = NULL, n = 0, i;
+  khint_t k;
+
+  if (!hash || kh_size (hash) == 0)
+    return;
+
+  keys = xmalloc (kh_size (hash) * sizeof (uint32_t));
+  vals = xmalloc (kh_size (hash) * sizeof (uint32_t));
+  for (k = kh_begin (hash); k != kh_end (hash); ++k) {
+    if (!kh_exist (hash, k))
+      continue;
+    keys[n] = intern_str (pool, intern_get (old, kh_key (hash, k)));
+    vals[n++] = kh_val (hash, k);
+  }
+
+  kh_clear (ii32, hash);
+  for (i = 0; i < n; ++i)
+    ins_ii32 (hash, keys[i], vals[i]);
+
+  free (keys);
+  free (vals);
+}
+
+/* Point the string values of the given hash to their copy on the new
+ * intern pool. */
+static void
+repoint_is32 (khash_t (is32) * hash, GIntern * pool) {
+  khint_t k;
+
+  if (!hash)
+    return;
+
+  for (k = kh_begin (hash); k != kh_end (hash); ++k) {
+    if (kh_exist (hash, k))
+      kh_val (hash, k) = intern_get (pool, intern_str (pool, kh_val (hash, k)));
+  }
+}
+
+/* Rebuild the intern pool out of the strings the remaining date stores
+ * and the cache refer to, releasing the ones only evicted dates used. */
+static void
+compact_strings (GKDB * db) {
+  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
+  GIntern *old = db->strings, *pool = new_intern ();
+  GKHashStorage *store = NULL;
+  GModule module;
+  size_t idx;
+  khint_t k;
+
+  for (k = kh_begin (dates); k != kh_end (dates); ++k) {
+    if (!kh_exist (dates, k))
+      continue;
+    store = kh_val (dates, k);
+    idx = 0;
+    FOREACH_MODULE (idx, module_list) {
+      module = module_list[idx];
+      remap_keymap (get_hash_from_store (store, module, MTRC_KEYMAP), old, pool);
+      repoint_is32 (get_hash_from_store (store, module, MTRC_ROOTMAP), pool);
+      repoint_is32 (get_hash_from_store (store, module, MTRC_DATAMAP), pool);
+    }
+  }
+
+  idx = 0;
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    remap_keymap (get_hash_from_cache (module, MTRC_KEYMAP), old, pool);
+    repoint_is32 (get_hash_from_cache (module, MTRC_ROOTMAP), pool);
+    repoint_is32 (get_hash_from_cache (module, MTRC_DATAMAP), pool);
+  }
+
+  db->strings = pool;
+  db->strings_compacted = pool->len;
+  free_intern (old);
+}
+
+/* Get the max time served of the given data key across all the dates but
+ * the given one.
+ *
+ * On success, the max time served is returned. */
+static uint64_t
+get_maxts_but_date (GModule module, uint32_t key, uint32_t date) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
+  GKHashStorage *store = NULL;
+  const GKeyRecord *record = NULL;
+  uint32_t nkey = 0;
+  uint64_t maxts = 0;
+  khint_t k;
+
+  for (k = kh_begin (dates); k != kh_end (dates); ++k) {
+    if (!kh_exist (dates, k) || kh_key (dates, k) == date)
+      continue;
+    store = kh_val (dates, k);
+    if (!(nkey = get_ii32 (get_hash_from_store (store, module, MTRC_KEYMAP), key)))
+      continue;
+    record = get_igrc (get_hash_from_store (store, module, MTRC_RECORDS), nkey);
+    if (record && record->maxts > maxts)
+      maxts = record->maxts;
+  }
+
+  return maxts;
+}
+
+/* Determine if the given key is on any of the dates but the given one.
+ *
+ * If not found, 0 is returned.
+ * If found, 1 is returned. */
+static int
+has_key_but_date (GModule module, uint32_t key, uint32_t date) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
+  khint_t k;
+
+  for (k = kh_begin (dates); k != kh_end (dates); ++k) {
+    if (!kh_exist (dates, k) || kh_key (dates, k) == date)
+      continue;
+    if (get_ii32 (get_hash_from_store (kh_val (dates, k), module, MTRC_KEYMAP), key))
+      return 1;
+  }
+
+  return 0;
+}
+
+/* Delete the given key from a cache map. */
+static void
+del_cache_key (GModule module, GSMetric metric, uint32_t key) {
+  khash_t (is32) * hash = get_hash_from_cache (module, metric);
+  khint_t k;
+
+  if (hash && (k = kh_get (is32, hash, key)) != kh_end (hash))
+    kh_del (is32, hash, k);
+}
+
+/* Subtract the records of the given date store from the cache records
+ * they were merged into. Data keys left with no hits and roots no other
+ * date refers to are removed from the cache. */
+static void
+evict_cache_date (GKHashStorage * store, GModule module, uint32_t date) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (ii32) * kmap = get_hash_from_store (store, module, MTRC_KEYMAP);
+  khash_t (igrc) * records = get_hash_from_store (store, module, MTRC_RECORDS);
+  khash_t (is32) * rmap = get_hash_from_store (store, module, MTRC_ROOTMAP);
+  khash_t (ii32) * ckmap = get_hash_from_cache (module, MTRC_KEYMAP);
+  khash_t (igrc) * crecords = get_hash_from_cache (module, MTRC_RECORDS);
+  khash_t (is32) * crmap = get_hash_from_cache (module, MTRC_ROOTMAP);
+  const GKeyRecord *record = NULL;
+  GKeyRecord *dst = NULL;
+  uint32_t key = 0, ckey = 0;
+  khint_t k, kc;
+
+  if (!kmap)
+    return;
+
+  for (k = kh_begin (kmap); k != kh_end (kmap); ++k) {
+    if (!kh_exist (kmap, k))
+      continue;
+    /* root keys have no record */
+    if (!(record = get_igrc (records, kh_val (kmap, k))))
+      continue;
+
+    key = kh_key (kmap, k);
+    if (!(ckey = get_ii32 (ckmap, key)))
+      continue;
+    if ((kc = kh_get (igrc, crecords, ckey)) == kh_end (crecords))
+      continue;
+
+    dst = &kh_val (crecords, kc);
+    /* only seen on the evicted date */
+    if (dst->hits <= record->hits) {
+      kh_del (igrc, crecords, kc);
+      del_cache_key (module, MTRC_DATAMAP, ckey);
+      /* the key may still be used by a root */
+      if (kh_get (is32, crmap, ckey) == kh_end (crmap))
+        kh_del (ii32, ckmap, kh_get (ii32, ckmap, key));
+      continue;
+    }
+
+    dst->hits -= record->hits;
+    dst->visitors -= MIN (dst->visitors, record->visitors);
+    dst->bw -= MIN (dst->bw, record->bw);
+    dst->cumts -= MIN (dst->cumts, record->cumts);
+    /* the evicted date held the max, look for it on the remaining ones */
+    if (record->maxts && record->maxts >= dst->maxts)
+      dst->maxts = get_maxts_but_date (module, key, date);
+  }
+
+  if (!rmap)
+    return;
+
+  for (k = kh_begin (rmap); k != kh_end (rmap); ++k) {
+    if (!kh_exist (rmap, k))
+      continue;
+    key = intern_find (db->strings, kh_val (rmap, k));
+    if (!(ckey = get_ii32 (ckmap, key)) || has_key_but_date (module, key, date))
+      continue;
+
+    del_cache_key (module, MTRC_ROOTMAP, ckey);
+    /* the key may still be used by a data key */
+    if (kh_get (igrc, crecords, ckey) == kh_end (crecords))
+      kh_del (ii32, ckmap, kh_get (ii32, ckmap, key));
+  }
+}
+
+/* Shrink the cache tables of the given module if an eviction left most of
+ * their buckets empty. */
+static void
+shrink_cache (GModule module) {
+  khash_t (ii32) * kmap = get_hash_from_cache (module, MTRC_KEYMAP);
+  khash_t (is32) * rmap = get_hash_from_cache (module, MTRC_ROOTMAP);
+  khash_t (is32) * dmap = get_hash_from_cache (module, MTRC_DATAMAP);
+  khash_t (igrc) * records = get_hash_from_cache (module, MTRC_RECORDS);
+
+  if (kmap && kh_size (kmap) < kh_n_buckets (kmap) / 4)
+    kh_resize (ii32, kmap, kh_size (kmap) * 2);
+  if (rmap && kh_size (rmap) < kh_n_buckets (rmap) / 4)
+    kh_resize (is32, rmap, kh_size (rmap) * 2);
+  if (dmap && kh_size (dmap) < kh_n_buckets (dmap) / 4)
+    kh_resize (is32, dmap, kh_size (dmap) * 2);
+  if (records && kh_size (records) < kh_n_buckets (records) / 4)
+    kh_resize (igrc, records, kh_size (records) * 2);
+}
+
+/* Evict the given date. Its contributions are subtracted from the cache,
+ * thus only the keys of that date are visited, and its stores are
+ * destroyed. The intern pool is compacted once it holds twice as many
+ * strings as it did after its last compaction.
+ *
+ * On error, -1 is returned.
+ * On success, 0 is returned. */
 int
 invalidate_date (int date) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (igkh) * hash = get_hdb (db, MTRC_DATES);
+  GKHashStorage *store = NULL;
   GModule module;
   size_t idx = 0;
 
-  if (!hash)
+  if (!hash || !(store = get_store (hash, date)))
     return -1;
 
   FOREACH_MODULE (idx, module_list) {
     module = module_list[idx];
-    del_module_metrics (db->cache, module, 0);
+    evict_cache_date (store, module, date);
+    shrink_cache (module);
   }
 
   destroy_date_stores (date);
+  if (db->strings->len / 2 > db->strings_compacted)
+    compact_strings (db);
 
   return 0;
 }
 
 static uint32_t
 ins_cache_map (GModule module, GSMetric metric, uint32_t key) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (ii32) * cache = get_hash_from_cache (module, metric);
 
   if (!cache)
     return 0;
-  return ins_ii32_ai (cache, key);
-}
-
-static int
-ins_cache_ii08 (GKHashStorage * store, GModule module, GSMetric metric, uint32_t key,
-                uint32_t ckey) {
-  khash_t (ii08) * hash = get_hash_from_store (store, module, metric);
-  khash_t (ii08) * cache = get_hash_from_cache (module, metric);
-  khint_t k;
-
-  if ((k = kh_get (ii08, hash, key)) == kh_end (hash))
-    return -1;
-  return ins_ii08 (cache, ckey, kh_val (hash, k));
+  return ins_ii32_ai (cache, key, &db->cache_seqs[module]);
 }
 
 static int
@@ -2780,48 +3017,29 @@ ins_cache_is32 (GKHashStorage * store, GModule module, GSMetric metric, uint32_t
   khash_t (is32) * cache = get_hash_from_cache (module, metric);
   khint_t k;
 
-  if ((k = kh_get (is32, hash, key)) == kh_end (hash))
+  if (!hash || (k = kh_get (is32, hash, key)) == kh_end (hash))
     return -1;
   return ins_is32 (cache, ckey, kh_val (hash, k));
 }
 
+/* Merge the record of a data key on the given date store into the cache
+ * record mapped to the given cache key.
+ *
+ * On error, or if the key has no record, -1 is returned.
+ * On success 0 is returned */
 static int
-inc_cache_ii32 (GKHashStorage * store, GModule module, GSMetric metric, uint32_t key,
-                uint32_t ckey) {
-  khash_t (ii32) * hash = get_hash_from_store (store, module, metric);
-  khash_t (ii32) * cache = get_hash_from_cache (module, metric);
-  khint_t k;
-
-  if ((k = kh_get (ii32, hash, key)) == kh_end (hash))
+merge_cache_igrc (GKHashStorage * store, GModule module, uint32_t key, uint32_t ckey,
+                  uint32_t crkey) {
+  khash_t (igrc) * hash = get_hash_from_store (store, module, MTRC_RECORDS);
+  khash_t (igrc) * cache = get_hash_from_cache (module, MTRC_RECORDS);
+  const GKeyRecord *record = NULL;
+  GKeyRecord *dst = NULL;
+
+  if (!(record = get_igrc (hash, key)) || !(dst = put_igrc (cache, ckey)))
     return -1;
-  return inc_ii32 (cache, ckey, kh_val (hash, k));
-}
-
-static int
-max_cache_iu64 (GKHashStorage * store, GModule module, GSMetric metric, uint32_t key,
-                uint32_t ckey) {
-  khash_t (iu64) * hash = get_hash_from_store (store, module, metric);
-  khash_t (iu64) * cache = get_hash_from_cache (module, metric);
-  khint_t k;
 
-  if ((k = kh_get (iu64, hash, key)) == kh_end (hash))
-    return -1;
-
-  if (get_iu64 (cache, ckey) < kh_val (hash, k))
-    return ins_iu64 (cache, ckey, kh_val (hash, k));
-  return -1;
-}
-
-static int
-inc_cache_iu64 (GKHashStorage * store, GModule module, GSMetric metric, uint32_t key,
-                uint32_t ckey) {
-  khash_t (iu64) * hash = get_hash_from_store (store, module, metric);
-  khash_t (iu64) * cache = get_hash_from_cache (module, metric);
-  khint_t k;
-
-  if ((k = kh_get (iu64, hash, key)) == kh_end (hash))
-    return -1;
-  return inc_iu64 (cache, ckey, kh_val (hash, k));
+  merge_igrc (dst, record, crkey);
+  return 0;
 }
 
 static int
@@ -2834,9 +3052,8 @@ ins_raw_num_data (GModule module, uint32_t date) {
   char *val = NULL;
 
   khash_t (ii32) * kmap = get_hash_from_store (store, module, MTRC_KEYMAP);
-  khash_t (ii32) * root = get_hash_from_store (store, module, MTRC_ROOT);
+  khash_t (igrc) * records = get_hash_from_store (store, module, MTRC_RECORDS);
   khash_t (is32) * rmap = get_hash_from_store (store, module, MTRC_ROOTMAP);
-  khash_t (ii32) * cache = get_hash_from_cache (module, MTRC_ROOT);
 
   if (!kmap)
     return -1;
@@ -2847,23 +3064,17 @@ ins_raw_num_data (GModule module, uint32_t date) {
     if ((ckey = ins_cache_map (module, MTRC_KEYMAP, kh_key (kmap, k))) == 0)
       continue;
 
-    if ((rkey = get_ii32 (root, kh_val (kmap, k)))) {
+    nrkey = 0;
+    if ((rkey = get_igrc_field (get_igrc (records, kh_val (kmap, k)), MTRC_ROOT)) && rmap) {
       kr = kh_get (is32, rmap, rkey);
       if (kr != kh_end (rmap) && (val = kh_val (rmap, kr))) {
-        nrkey = ins_cache_map (module, MTRC_KEYMAP, djb2 ((unsigned char *) val));
+        nrkey = ins_cache_map (module, MTRC_KEYMAP, intern_find (db->strings, val));
         ins_cache_is32 (store, module, MTRC_ROOTMAP, rkey, nrkey);
-        ins_ii32 (cache, ckey, nrkey);
       }
     }
 
     ins_cache_is32 (store, module, MTRC_DATAMAP, kh_val (kmap, k), ckey);
-    inc_cache_ii32 (store, module, MTRC_HITS, kh_val (kmap, k), ckey);
-    inc_cache_ii32 (store, module, MTRC_VISITORS, kh_val (kmap, k), ckey);
-    inc_cache_iu64 (store, module, MTRC_BW, kh_val (kmap, k), ckey);
-    inc_cache_iu64 (store, module, MTRC_CUMTS, kh_val (kmap, k), ckey);
-    max_cache_iu64 (store, module, MTRC_MAXTS, kh_val (kmap, k), ckey);
-    ins_cache_ii08 (store, module, MTRC_METHODS, kh_val (kmap, k), ckey);
-    ins_cache_ii08 (store, module, MTRC_PROTOCOLS, kh_val (kmap, k), ckey);
+    merge_cache_igrc (store, module, kh_val (kmap, k), ckey, nrkey);
   }
 
   return 0;
@@ -2918,7 +3129,7 @@ init_new_raw_data (GModule module, uint32_t ht_size) {
 
 static GRawData *
 get_u32_raw_data (GModule module) {
-  khash_t (ii32) * hash = get_hash_from_cache (module, MTRC_HITS);
+  khash_t (igrc) * hash = get_hash_from_cache (module, MTRC_RECORDS);
   GRawData *raw_data;
   khiter_t key;
   uint32_t ht_size = 0;
@@ -2934,7 +3145,7 @@ get_u32_raw_data (GModule module) {
     if (!kh_exist (hash, key))
       continue;
     raw_data->items[raw_data->idx].nkey = kh_key (hash, key);
-    raw_data->items[raw_data->idx].hits = kh_val (hash, key);
+    raw_data->items[raw_data->idx].hits = kh_val (hash, key).hits;
     raw_data->idx++;
   }
 
@@ -3021,7 +3232,7 @@ init_pre_storage (Logs * logs) {
 void
 init_storage (void) {
   GKDB *db = get_db_instance (DB_INSTANCE);
-  db->cache = init_gkhashmodule ();
+  db->cache = init_gkhashmodule (1);
 
   if (conf.restore)
     restore_data ();
@@ -3065,6 +3276,7 @@ free_igdb (khash_t (igdb) * hash, khint_t k) {
   free_logs (db->logs);
   free_cache (db->cache);
   free_app_metrics (db->hdb);
+  free_intern (db->strings);
 
   kh_del (igdb, hash, k);
   free (kh_val (hash, k));
@@ -31,13 +31,16 @@
 #define GKHASH_H_INCLUDED
 
 #include <stdint.h>
+#include <string.h>
 
+#include "gdns.h"
+#include "gintern.h"
 #include "gslist.h"
 #include "gstorage.h"
 #include "khash.h"
 #include "parser.h"
 
-#define DB_VERSION  2
+#define DB_VERSION  4
 #define DB_INSTANCE 1
 
 /* Enumerated Storage Metrics */
@@ -66,11 +69,39 @@ typedef enum GSMetricType_ {
   MTRC_TYPE_U648,
   /* uint32_t key - GLastParse val */
   MTRC_TYPE_IGLP,
+  /* uint32_t key - GKeyRecord val */
+  MTRC_TYPE_IGRC,
+  /* GUniqKey key - uint32_t val */
+  MTRC_TYPE_BI32,
+  /* interned string id key - uint32_t val */
+  MTRC_TYPE_KI32,
 } GSMetricType;
 
 typedef struct GKDB_ GKDB;
 typedef struct GKHashStorage_ GKHashStorage;
 
+/* Hash a unique visitor key by folding its three 64-bit words and
+ * finalizing them with the MurmurHash3 64-bit mixer */
+static kh_inline khint_t
+uniq_key_hash (GUniqKey key) {
+  uint64_t h = ((uint64_t) key.date << 32) | key.agent, a = 0, b = 0;
+
+  memcpy (&a, key.host, sizeof (a));
+  memcpy (&b, key.host + 8, sizeof (b));
+  h ^= a + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+  h ^= b + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return (khint_t) h;
+}
+
+#define uniq_key_equal(a, b) (memcmp (&(a), &(b), sizeof (GUniqKey)) == 0)
+
 /* *INDENT-OFF* */
 /* uint32_t keys           , GKDB payload */
 KHASH_MAP_INIT_INT (igdb   , GKDB *);
@@ -86,18 +117,24 @@ KHASH_MAP_INIT_INT (iu64   , uint64_t);
 KHASH_MAP_INIT_STR (si32   , uint32_t);
 /* string keys             , uint8_t payload */
 KHASH_MAP_INIT_STR (si08   , uint8_t);
-/* uint8_t keys            , uint8_t payload */
-KHASH_MAP_INIT_INT (ii08   , uint8_t);
 /* string keys             , string payload */
 KHASH_MAP_INIT_STR (ss32   , char *);
 /* uint32_t key            , GLastParse payload */
 KHASH_MAP_INIT_INT (iglp   , GLastParse);
+/* uint32_t key            , GKeyRecord payload */
+KHASH_MAP_INIT_INT (igrc   , GKeyRecord);
+/* GUniqKey keys           , uint32_t payload */
+KHASH_INIT (bi32, GUniqKey, uint32_t, 1, uniq_key_hash, uniq_key_equal);
 /* uint32_t keys           , GSLList payload */
 KHASH_MAP_INIT_INT (igsl   , GSLList *);
 /* string keys             , uint64_t payload */
 KHASH_MAP_INIT_STR (su64   , uint64_t);
 /* uint64_t key            , uint8_t payload */
 KHASH_MAP_INIT_INT64 (u648 , uint8_t);
+/* string keys             , GLogFmt payload */
+KHASH_MAP_INIT_STR (sfmt   , GLogFmt *);
+/* string keys             , GDnsEntry payload */
+KHASH_MAP_INIT_STR (sdns   , GDnsEntry);
 /* *INDENT-ON* */
 
 typedef struct GKHashMetric_ {
@@ -117,12 +154,12 @@ typedef struct GKHashMetric_ {
 /* Data store per module */
 typedef struct GKHashModule_ {
   GModule module;
-  GKHashMetric metrics[GSMTRC_TOTAL];
+  GKHashMetric metrics[GSMTRC_MODULE_TOTAL];
 } GKHashModule;
 
 /* Data store global */
 typedef struct GKHashGlobal_ {
-  GKHashMetric metrics[GSMTRC_TOTAL];
+  GKHashMetric metrics[GSMTRC_GLOBAL_TOTAL];
 } GKHashGlobal;
 
 struct GKHashStorage_ {
@@ -140,6 +177,9 @@ struct GKDB_ {
   GKHashDB *hdb;                /* app-level hash tables */
   GKHashModule *cache;          /* cache modules */
   GKHashStorage *store;         /* per date OR module */
+  GIntern *strings;             /* interned data and root keys */
+  uint32_t strings_compacted;   /* strings left by the last compaction */
+  uint32_t cache_seqs[TOTAL_MODULES]; /* last key handed out per cache keymap */
   Logs *logs;                   /* logs parsing per db instance */
 };
 
@@ -167,9 +207,11 @@ struct GKDB_ {
 extern GKHashMetric module_metrics[];
 extern const GKHashMetric global_metrics[];
 extern const GKHashMetric app_metrics[];
+extern const GKHashMetric record_metrics[];
 extern size_t global_metrics_len;
 extern size_t module_metrics_len;
 extern size_t app_metrics_len;
+extern size_t record_metrics_len;
 
 /* Metrics Storage */
 
@@ -179,13 +221,13 @@ extern size_t app_metrics_len;
 
 /* GLOBAL METRICS */
 /* ============== */
-/* Maps a string key containing an IP|DATE|UA(hash uint32_t => hex) to an
- * autoincremented value.
+/* Maps a binary key made out of the DATE|UA(hash uint32_t)|IP(16 bytes) to
+ * an autoincremented value.
  *
- * 192.168.0.1|27/Apr/2020|7E8E0E -> 1
- * 192.168.0.1|28/Apr/2020|7E8E0E -> 2
+ * {20200427, 0x7E8E0E, ::ffff:192.168.0.1} -> 1
+ * {20200428, 0x7E8E0E, ::ffff:192.168.0.1} -> 2
  */
-/*khash_t(si32) MTRC_UNIQUE_KEYS */
+/*khash_t(bi32) MTRC_UNIQUE_KEYS */
 
 /* Maps string keys made out of the user agent to an autoincremented value.
  *
@@ -217,24 +259,23 @@ extern size_t app_metrics_len;
 
 /* MODULE METRICS */
 /* ============== */
-/* Maps keys (string) to a hash to a numeric values (uint32_t).
- * this mitigates the issue of having multiple stores
- * with the same string key, and therefore, avoids unnecessary
- * memory usage (in most cases).
+/* Maps keys (string) to their id in the intern pool to a numeric values
+ * (uint32_t). The string is kept once in the pool no matter how many
+ * stores it shows up in, and two different strings never share an id.
  *
- * HEAD|/index.php -> 9872347 -> 1
- * POST|/index.php -> 3452345 -> 2
- * Windows XP      -> 2842343 -> 3
- * Ubuntu 10.10    -> 1852342 -> 4
- * GET|Ubuntu 10.10-> 4872343 -> 5
- * GNU+Linux       -> 5862347 -> 6
- * 26/Dec/2014     -> 9874347 -> 7
- * Windows         -> 3875347 -> 8
+ * HEAD|/index.php -> 1 -> 1
+ * POST|/index.php -> 2 -> 2
+ * Windows XP      -> 3 -> 3
+ * Ubuntu 10.10    -> 4 -> 4
+ * GET|Ubuntu 10.10-> 5 -> 5
+ * GNU+Linux       -> 6 -> 6
+ * 26/Dec/2014     -> 7 -> 7
+ * Windows         -> 8 -> 8
  */
-/*khash_t(si32) MTRC_KEYMAP */
+/*khash_t(ii32) MTRC_KEYMAP */
 
 /* Maps integer keys of root elements from the keymap hash
- * to actual string values.
+ * to actual string values (owned by the intern pool).
  *
  * 6 -> GNU+Linux
  * 8 -> Windows
@@ -242,7 +283,7 @@ extern size_t app_metrics_len;
 /*khash_t(is32) MTRC_ROOTMAP */
 
 /* Maps integer keys of data elements from the keymap hash
- * to actual string values.
+ * to actual string values (owned by the intern pool).
  *
  * 1 -> /index.php
  * 2 -> /index.php
@@ -262,61 +303,17 @@ extern size_t app_metrics_len;
  */
 /*khash_t(si32) MTRC_UNIQMAP */
 
-/* Maps integer keys made from a data key to an integer root key in
- * MTRC_KEYMAP.
+/* Maps integer keys from the keymap hash to a record holding all the numeric
+ * metrics of the data key, so they are all updated with a single lookup.
+ * Each field is still persisted to its own database file, named after the
+ * metrics in record_metrics[].
  *
- * 4 -> 6
- * 3 -> 8
- */
-/*khash_t(ii32) MTRC_ROOT */
-
-/* Maps integer key from the keymap hash to the number of
- * hits.
- *
- * 1 -> 10934
- * 2 -> 3231
- * 3 -> 500
- * 4 -> 201
- * 5 -> 206
- */
-/*khash_t(ii32) MTRC_HITS */
-
-/* Maps numeric keys made from the uniqmap store to autoincremented values
- * (counter).
- * 10 -> 100
- * 40 -> 56
- */
-/*khash_t(ii32) MTRC_VISITORS */
-
-/* Maps numeric data keys to bandwidth (in bytes).
- * 1 -> 1024
- * 2 -> 2048
- */
-/*khash_t(iu64) MTRC_BW */
-
-/* Maps numeric data keys to cumulative time served (in usecs/msecs).
- * 1 -> 187
- * 2 -> 208
- */
-/*khash_t(iu64) MTRC_CUMTS */
-
-/* Maps numeric data keys to max time served (in usecs/msecs).
- * 1 -> 1287
- * 2 -> 2308
- */
-/*khash_t(iu64) MTRC_MAXTS */
-
-/* Maps numeric data keys to uint8_t values.
- * 1 -> 3
- * 2 -> 4
- */
-/*khash_t(is32) MTRC_METHODS */
-
-/* Maps numeric data keys to uint8_t values.
- * 1 -> 1
- * 2 -> 1
+ * 1 -> { hits: 10934, visitors: 100, bw: 1024, cumts: 187, maxts: 1287,
+ *        root: 0, method: 3, protocol: 1 }
+ * 4 -> { hits: 201, visitors: 56, bw: 2048, cumts: 208, maxts: 2308,
+ *        root: 6, method: 0, protocol: 0 }
  */
-/*khash_t(is32) MTRC_PROTOCOLS */
+/*khash_t(igrc) MTRC_RECORDS */
 
 /* Maps numeric unique data keys (e.g., 192.168.0.1 => 1) to the unique user
  * agent key. Therefore, 1 IP can contain multiple user agents
@@ -335,26 +332,18 @@ extern size_t app_metrics_len;
 char *get_mtr_type_str (GSMetricType type);
 char *ht_get_datamap (GModule module, uint32_t key);
 char *ht_get_host_agent_val (uint32_t key);
-char *ht_get_hostname (const char *host);
-char *ht_get_json_logfmt (const char *key);
 char *ht_get_method (GModule module, uint32_t key);
 char *ht_get_protocol (GModule module, uint32_t key);
 char *ht_get_root (GModule module, uint32_t key);
+char *ht_get_string (uint32_t id);
 int ht_inc_cnt_bw (uint32_t date, uint64_t inc);
 int ht_insert_agent (GModule module, uint32_t date, uint32_t key, uint32_t value);
 int ht_insert_agent_value (uint32_t date, uint32_t key, char *value);
-int ht_insert_bw (GModule module, uint32_t date, uint32_t key, uint64_t inc, uint32_t ckey);
-int ht_insert_cumts (GModule module, uint32_t date, uint32_t key, uint64_t inc, uint32_t ckey);
 int ht_insert_datamap (GModule module, uint32_t date, uint32_t key, const char *value, uint32_t ckey);
 int ht_insert_date (uint32_t key);
-int ht_insert_hostname (const char *ip, const char *host);
 int ht_insert_json_logfmt (GO_UNUSED void *userdata, char *key, char *spec);
 int ht_insert_last_parse (uint32_t key, GLastParse lp);
-int ht_insert_maxts (GModule module, uint32_t date, uint32_t key, uint64_t value, uint32_t ckey);
-int ht_insert_meta_data (GModule module, uint32_t date, const char *key, uint64_t value);
-int ht_insert_method (GModule module, uint32_t date, uint32_t key, const char *value, uint32_t ckey);
-int ht_insert_protocol (GModule module, uint32_t date, uint32_t key, const char *value, uint32_t ckey);
-int ht_insert_root (GModule module, uint32_t date, uint32_t key, uint32_t value, uint32_t dkey, uint32_t rkey);
+int ht_insert_record (GModule module, uint32_t date, uint32_t key, uint32_t ckey, uint32_t crkey, const GKeyRecord * record);
 int ht_insert_rootmap (GModule module, uint32_t date, uint32_t key, const char *value, uint32_t ckey);
 int ht_insert_uniqmap (GModule module, uint32_t date, uint32_t key, uint32_t value);
 int invalidate_date (int date);
@@ -364,26 +353,29 @@ uint32_t ht_get_excluded_ips (void);
 uint32_t ht_get_hits (GModule module, int key);
 uint32_t ht_get_invalid (void);
 uint32_t ht_get_keymap (GModule module, const char *key);
+uint32_t ht_get_prefiltered (void);
 uint32_t ht_get_processed (void);
 uint32_t ht_get_processing_time (void);
 uint32_t ht_get_size_datamap (GModule module);
 uint32_t ht_get_size_dates (void);
 uint32_t ht_get_size_uniqmap (GModule module);
+uint32_t ht_get_string_id (const char *str);
 uint32_t ht_get_visitors (GModule module, uint32_t key);
 uint32_t ht_inc_cnt_overall (const char *key, uint32_t val);
 uint32_t ht_inc_cnt_valid (uint32_t date, uint32_t inc);
 uint32_t ht_insert_agent_key (uint32_t date, uint32_t key);
-uint32_t ht_insert_hits (GModule module, uint32_t date, uint32_t key, uint32_t inc, uint32_t ckey);
 uint32_t ht_insert_keymap (GModule module, uint32_t date, uint32_t key, uint32_t * ckey);
-uint32_t ht_insert_unique_key (uint32_t date, const char *key);
+uint32_t ht_insert_string (const char *str);
+uint32_t ht_insert_unique_key (uint32_t date, const GUniqKey * key);
 uint32_t ht_insert_unique_seq (const char *key);
-uint32_t ht_insert_visitor (GModule module, uint32_t date, uint32_t key, uint32_t inc, uint32_t ckey);
 uint32_t ht_sum_valid (void);
+uint64_t get_igrc_field (const GKeyRecord * record, GSMetric metric);
 uint64_t ht_get_bw (GModule module, uint32_t key);
 uint64_t ht_get_cumts (GModule module, uint32_t key);
 uint64_t ht_get_maxts (GModule module, uint32_t key);
 uint64_t ht_get_meta_data (GModule module, const char *key);
 uint64_t ht_sum_bw (void);
+uint8_t ht_get_meth_proto (const char *key);
 uint8_t ht_insert_meth_proto (const char *key);
 void destroy_date_stores (int date);
 void free_storage (void);
@@ -396,9 +388,10 @@ void init_pre_storage (Logs *logs);
 void init_storage (void);
 void u64decode (uint64_t n, uint32_t * x, uint32_t * y);
 
+int ins_bi32 (khash_t (bi32) * hash, GUniqKey key, uint32_t value);
 int ins_iglp (khash_t (iglp) * hash, uint32_t key, GLastParse lp);
+int ins_igrc (khash_t (igrc) * hash, uint32_t key, GSMetric metric, uint64_t value);
 int ins_igsl (khash_t (igsl) * hash, uint32_t key, uint32_t value);
-int ins_ii08 (khash_t (ii08) * hash, uint32_t key, uint8_t value);
 int ins_ii32 (khash_t (ii32) * hash, uint32_t key, uint32_t value);
 int ins_is32 (khash_t (is32) * hash, uint32_t key, char *value);
 int ins_iu64 (khash_t (iu64) * hash, uint32_t key, uint64_t value);
@@ -409,6 +402,7 @@ int ins_u648 (khash_t (u648) * hash, uint64_t key, uint8_t value);
 void *get_db_instance (uint32_t key);
 void * get_hash (int module, uint64_t key, GSMetric metric);
 void *get_hdb (GKDB * db, GAMetric mtrc);
+void *put_hash (int module, uint64_t key, GSMetric metric);
 
 GLastParse ht_get_last_parse (uint32_t key);
 GRawData *parse_raw_data (GModule module);
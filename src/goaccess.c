@@ -65,12 +65,15 @@
 #include "browsers.h"
 #include "csv.h"
 #include "error.h"
+#include "gagent.h"
 #include "gdashboard.h"
 #include "gdns.h"
 #include "gholder.h"
 #include "goaccess.h"
+#include "gscan.h"
 #include "gwsocket.h"
 #include "json.h"
+#include "opesys.h"
 #include "options.h"
 #include "output.h"
 #include "util.h"
@@ -136,15 +139,25 @@ static GScroll gscroll = {
 /* Free malloc'd holder */
 static void
 house_keeping_holder (void) {
+  GDnsStats dns;
+
   /* REVERSE DNS THREAD */
+  gdns_stats (&dns);
+  LOG_DEBUG (("Reverse DNS: %" PRIu64 " queued, %" PRIu64 " pending, %" PRIu64 " cached, %"
+              PRIu64 " stale, %" PRIu64 " dropped, %" PRIu64 " waited, %" PRIu64
+              " resolved, %" PRIu64 " failed, %d max queued.\n", dns.queued, dns.pending,
+              dns.cached, dns.stale, dns.dropped, dns.waited, dns.resolved, dns.failed,
+              dns.max_size));
+
   pthread_mutex_lock (&gdns_thread.mutex);
 
   /* kill dns pthread */
   active_gdns = 0;
   /* clear holder structure */
   free_holder (&holder);
-  /* clear reverse dns queue */
+  /* clear reverse dns queue and cache */
   gdns_free_queue ();
+  gdns_free_cache ();
   /* clear the whole storage */
   free_storage ();
 
@@ -154,6 +167,8 @@ house_keeping_holder (void) {
 /* Free malloc'd data across the whole program */
 static void
 house_keeping (void) {
+  uint64_t hits = 0, misses = 0;
+
   house_keeping_holder ();
 
   /* DASHBOARD */
@@ -163,6 +178,10 @@ house_keeping (void) {
   }
 
   /* GEOLOCATION */
+#ifdef HAVE_LIBMAXMINDDB
+  geoip_cache_stats (&hits, &misses);
+  LOG_DEBUG (("GeoIP cache: %" PRIu64 " hits, %" PRIu64 " misses.\n", hits, misses));
+#endif
 #ifdef HAVE_GEOLOCATION
   geoip_free ();
 #endif
@@ -179,9 +198,18 @@ house_keeping (void) {
     unknowns_log_close ();
   }
 
+  /* USER AGENTS */
+  agent_cache_stats (&hits, &misses);
+  LOG_DEBUG (("User agent cache: %" PRIu64 " hits, %" PRIu64 " misses.\n", hits, misses));
+  free_agent_cache ();
+
   /* CONFIGURATION */
   free_formats ();
   free_browsers_hash ();
+  free_os ();
+  free_ip_ranges ();
+  free_referers ();
+  free_static_files ();
   if (conf.debug_log) {
     LOG_DEBUG (("Bye.\n"));
     dbg_log_close ();
@@ -1235,6 +1263,8 @@ static void
 init_processing (void) {
   /* perform some additional checks before parsing panels */
   verify_panels ();
+  /* skip the work of disabled panels */
+  compile_ingest_plan ();
   /* initialize storage */
   pthread_mutex_lock (&parsing_spinner->mutex);
   parsing_spinner->label = "SETTING UP STORAGE";
@@ -1447,6 +1477,13 @@ initializer (void) {
   set_locale ();
 
   parse_browsers_file ();
+  compile_os ();
+  compile_ip_ranges ();
+  compile_referers ();
+  compile_static_files ();
+  compile_prefilters ();
+  init_agent_cache ();
+  init_scan_delim ();
 
 #ifdef HAVE_GEOLOCATION
   init_geoip ();
@@ -1607,7 +1644,9 @@ main (int argc, char **argv) {
 
   /* main processing event */
   time (&start_proc);
+  lock_spinner ();
   parsing_spinner->label = "PARSING";
+  unlock_spinner ();
 
   if ((ret = parse_log (logs, 0))) {
     end_spinner ();
@@ -1618,7 +1657,9 @@ main (int argc, char **argv) {
     goto clean;
   logs->offset = *logs->processed;
 
+  lock_spinner ();
   parsing_spinner->label = "RENDERING";
+  unlock_spinner ();
   /* init reverse lookup thread */
   gdns_init ();
   parse_initial_sort ();
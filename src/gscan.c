@@ -0,0 +1,162 @@
+/**
+ * gscan.c -- find token delimiters in a log line
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+
+#if defined(__x86_64__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_SCAN_SSE2 1
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#include <immintrin.h>
+#define HAVE_SCAN_AVX2 1
+#endif
+#endif
+
+#include "gscan.h"
+
+/* The vector scanners read whole aligned blocks, which may go past the
+ * terminating null byte though never past the page holding it */
+#if defined(__GNUC__) || defined(__clang__)
+#define NO_SANITIZE_ADDRESS __attribute__ ((no_sanitize_address))
+#else
+#define NO_SANITIZE_ADDRESS
+#endif
+
+#ifndef HAVE_SCAN_SSE2
+/* Find the first byte of the given string matching a, b or the null
+ * terminator, one byte at a time.
+ *
+ * On success, a pointer to the matching byte is returned. */
+static const char *
+scan_delim_scalar (const char *str, char a, char b) {
+  while (*str != a && *str != b && *str != '\0')
+    str++;
+  return str;
+}
+#else
+/* Find the first byte of the given string matching a, b or the null
+ * terminator, 16 bytes at a time.
+ *
+ * On success, a pointer to the matching byte is returned. */
+NO_SANITIZE_ADDRESS static const char *
+scan_delim_sse2 (const char *str, char a, char b) {
+  const __m128i va = _mm_set1_epi8 (a), vb = _mm_set1_epi8 (b);
+  const __m128i vz = _mm_setzero_si128 ();
+  const char *p = (const char *) ((uintptr_t) str & ~(uintptr_t) 15);
+  __m128i v;
+  unsigned int mask;
+
+  v = _mm_load_si128 ((const __m128i *) p);
+  mask = _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, va),
+                                                        _mm_cmpeq_epi8 (v, vb)),
+                                          _mm_cmpeq_epi8 (v, vz)));
+  /* drop the bytes before the start of the string */
+  mask &= ~0u << (str - p);
+
+  while (mask == 0) {
+    p += 16;
+    v = _mm_load_si128 ((const __m128i *) p);
+    mask = _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, va),
+                                                          _mm_cmpeq_epi8 (v, vb)),
+                                            _mm_cmpeq_epi8 (v, vz)));
+  }
+
+  return p + __builtin_ctz (mask);
+}
+#endif
+
+#ifdef HAVE_SCAN_AVX2
+/* Find the first byte of the given string matching a, b or the null
+ * terminator, 32 bytes at a time.
+ *
+ * On success, a pointer to the matching byte is returned. */
+NO_SANITIZE_ADDRESS __attribute__ ((target ("avx2")))
+static const char *
+scan_delim_avx2 (const char *str, char a, char b) {
+  const __m256i va = _mm256_set1_epi8 (a), vb = _mm256_set1_epi8 (b);
+  const __m256i vz = _mm256_setzero_si256 ();
+  const char *p = (const char *) ((uintptr_t) str & ~(uintptr_t) 31);
+  __m256i v;
+  unsigned int mask;
+
+  v = _mm256_load_si256 ((const __m256i *) p);
+  mask = (unsigned int)
+    _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, va),
+                                                            _mm256_cmpeq_epi8 (v, vb)),
+                                           _mm256_cmpeq_epi8 (v, vz)));
+  /* drop the bytes before the start of the string */
+  mask &= ~0u << (str - p);
+
+  while (mask == 0) {
+    p += 32;
+    v = _mm256_load_si256 ((const __m256i *) p);
+    mask = (unsigned int)
+      _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, va),
+                                                              _mm256_cmpeq_epi8 (v, vb)),
+                                             _mm256_cmpeq_epi8 (v, vz)));
+  }
+
+  return p + __builtin_ctz (mask);
+}
+#endif
+
+#ifdef HAVE_SCAN_SSE2
+static const char *(*scan_delim_fn) (const char *, char, char) = scan_delim_sse2;
+#else
+static const char *(*scan_delim_fn) (const char *, char, char) = scan_delim_scalar;
+#endif
+
+/* Find the first byte of the given string matching a, b or the null
+ * terminator, i.e., strpbrk(3) for up to two chars that doesn't go past
+ * the end of the string.
+ *
+ * On success, a pointer to the matching byte is returned. */
+const char *
+scan_delim (const char *str, char a, char b) {
+  return scan_delim_fn (str, a, b);
+}
+
+/* Pick the widest scanner the CPU supports. This should be called once,
+ * before any thread scans a string. */
+void
+init_scan_delim (void) {
+#ifdef HAVE_SCAN_AVX2
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2")) {
+    scan_delim_fn = scan_delim_avx2;
+    return;
+  }
+#endif
+#ifdef HAVE_SCAN_SSE2
+  scan_delim_fn = scan_delim_sse2;
+#else
+  scan_delim_fn = scan_delim_scalar;
+#endif
+}
@@ -44,6 +44,8 @@
 #include "browsers.h"
 #include "commons.h"
 #include "error.h"
+#include "gagent.h"
+#include "garena.h"
 #include "gkhash.h"
 #include "opesys.h"
 #include "ui.h"
@@ -373,6 +375,10 @@ static GParse paneling[] = {
 };
 /* *INDENT-ON* */
 
+/* The panels of the enabled modules, in the order lines are mapped */
+static const GParse *panel_parsers[TOTAL_MODULES];
+static int panel_parsers_len = 0;
+
 /* Initialize a new GKeyData instance */
 static void
 new_modulekey (GKeyData * kdata) {
@@ -380,11 +386,12 @@ new_modulekey (GKeyData * kdata) {
     .data = NULL,
     .data_nkey = 0,
     .root = NULL,
-    .dhash = 0,
-    .rhash = 0,
+    .dsid = 0,
+    .rsid = 0,
     .root_nkey = 0,
     .uniq_key = NULL,
     .uniq_nkey = 0,
+    .record = {0},
   };
   *kdata = key;
 }
@@ -404,6 +411,22 @@ panel_lookup (GModule module) {
   return NULL;
 }
 
+/* Set the panels of all enabled modules so a line is mapped without
+ * looking each one up. */
+void
+compile_panel_parsers (void) {
+  GModule module;
+  const GParse *parse = NULL;
+  size_t idx = 0;
+
+  panel_parsers_len = 0;
+  FOREACH_MODULE (idx, module_list) {
+    module = module_list[idx];
+    if ((parse = panel_lookup (module)))
+      panel_parsers[panel_parsers_len++] = parse;
+  }
+}
+
 /* Allocate memory for a new GMetrics instance.
  *
  * On success, the newly allocated GMetrics is returned . */
@@ -438,6 +461,14 @@ get_mtr_str (GSMetric metric) {
     {"MTRC_ROOTMAP", MTRC_ROOTMAP},
     {"MTRC_DATAMAP", MTRC_DATAMAP},
     {"MTRC_UNIQMAP", MTRC_UNIQMAP},
+    {"MTRC_RECORDS", MTRC_RECORDS},
+    {"MTRC_AGENTS", MTRC_AGENTS},
+    {"MTRC_METADATA", MTRC_METADATA},
+    {"MTRC_UNIQUE_KEYS", MTRC_UNIQUE_KEYS},
+    {"MTRC_AGENT_KEYS", MTRC_AGENT_KEYS},
+    {"MTRC_AGENT_VALS", MTRC_AGENT_VALS},
+    {"MTRC_CNT_VALID", MTRC_CNT_VALID},
+    {"MTRC_CNT_BW", MTRC_CNT_BW},
     {"MTRC_ROOT", MTRC_ROOT},
     {"MTRC_HITS", MTRC_HITS},
     {"MTRC_VISITORS", MTRC_VISITORS},
@@ -446,13 +477,6 @@ get_mtr_str (GSMetric metric) {
     {"MTRC_MAXTS", MTRC_MAXTS},
     {"MTRC_METHODS", MTRC_METHODS},
     {"MTRC_PROTOCOLS", MTRC_PROTOCOLS},
-    {"MTRC_AGENTS", MTRC_AGENTS},
-    {"MTRC_METADATA", MTRC_METADATA},
-    {"MTRC_UNIQUE_KEYS", MTRC_UNIQUE_KEYS},
-    {"MTRC_AGENT_KEYS", MTRC_AGENT_KEYS},
-    {"MTRC_AGENT_VALS", MTRC_AGENT_VALS},
-    {"MTRC_CNT_VALID", MTRC_CNT_VALID},
-    {"MTRC_CNT_BW", MTRC_CNT_BW},
   };
   return enum2str (enum_metrics, ARRAY_SIZE (enum_metrics), metric);
 }
@@ -607,37 +631,47 @@ count_process_and_invalid (GLog * glog, const char *line) {
   count_invalid (glog, line);
 }
 
-/* Keep track of all excluded log strings (IPs).
+/* Keep track of all lines rejected by --prefilter. */
+void
+count_prefiltered (void) {
+  ht_inc_cnt_overall ("prefiltered", 1);
+}
+
+/* Keep track of all excluded log strings (IPs). */
+void
+count_excluded_ip (void) {
+  ht_inc_cnt_overall ("excluded_ip", 1);
+}
+
+/* Determine if the log string (IP) is excluded.
  *
  * If IP not range, 1 is returned.
  * If IP is excluded, 0 is returned. */
 int
 excluded_ip (GLogItem * logitem) {
-  if (conf.ignore_ip_idx && ip_in_range (logitem->host)) {
-    ht_inc_cnt_overall ("excluded_ip", 1);
+  if (conf.ignore_ip_idx && ip_in_range (logitem->host))
     return 0;
-  }
   return 1;
 }
 
-/* A wrapper function to insert a data keymap string key.
+/* A wrapper function to insert a data keymap interned string key.
  *
  * If the given key exists, its value is returned.
  * On error, 0 is returned.
  * On success the value of the key inserted is returned */
 static int
 insert_dkeymap (GModule module, GKeyData * kdata) {
-  return ht_insert_keymap (module, kdata->numdate, kdata->dhash, &kdata->cdnkey);
+  return ht_insert_keymap (module, kdata->numdate, kdata->dsid, &kdata->cdnkey);
 }
 
-/* A wrapper function to insert a root keymap string key.
+/* A wrapper function to insert a root keymap interned string key.
  *
  * If the given key exists, its value is returned.
  * On error, 0 is returned.
  * On success the value of the key inserted is returned */
 static int
 insert_rkeymap (GModule module, GKeyData * kdata) {
-  return ht_insert_keymap (module, kdata->numdate, kdata->rhash, &kdata->crnkey);
+  return ht_insert_keymap (module, kdata->numdate, kdata->rsid, &kdata->crnkey);
 }
 
 /* A wrapper function to insert a datamap uint32_t key and string value. */
@@ -663,65 +697,61 @@ insert_rootmap (GModule module, GKeyData * kdata) {
   ht_insert_rootmap (module, kdata->numdate, kdata->root_nkey, kdata->root, kdata->crnkey);
 }
 
-/* A wrapper function to insert a data uint32_t key mapped to the
- * corresponding uint32_t root key. */
+/* Set the uint32_t root key the data key is mapped to. */
+static void
+insert_root (GO_UNUSED GModule module, GKeyData * kdata) {
+  kdata->record.root = kdata->root_nkey;
+}
+
+/* Count a hit for the data key. */
 static void
-insert_root (GModule module, GKeyData * kdata) {
-  ht_insert_root (module, kdata->numdate, kdata->data_nkey, kdata->root_nkey, kdata->cdnkey,
-                  kdata->crnkey);
+insert_hit (GO_UNUSED GModule module, GKeyData * kdata) {
+  kdata->record.hits = 1;
 }
 
-/* A wrapper function to increase hits counter from an uint32_t key. */
+/* Count a visitor for the data key. */
 static void
-insert_hit (GModule module, GKeyData * kdata) {
-  ht_insert_hits (module, kdata->numdate, kdata->data_nkey, 1, kdata->cdnkey);
-  ht_insert_meta_data (module, kdata->numdate, "hits", 1);
+insert_visitor (GO_UNUSED GModule module, GKeyData * kdata) {
+  kdata->record.visitors = 1;
 }
 
-/* A wrapper function to increase visitors counter from an uint32_t
- * key. */
+/* Add the bandwidth of the request to the data key. */
 static void
-insert_visitor (GModule module, GKeyData * kdata) {
-  ht_insert_visitor (module, kdata->numdate, kdata->data_nkey, 1, kdata->cdnkey);
-  ht_insert_meta_data (module, kdata->numdate, "visitors", 1);
+insert_bw (GO_UNUSED GModule module, GKeyData * kdata, uint64_t size) {
+  kdata->record.bw = size;
 }
 
-/* A wrapper function to increases bandwidth counter from an uint32_t
- * key. */
+/* Add the time served of the request to the data key. */
 static void
-insert_bw (GModule module, GKeyData * kdata, uint64_t size) {
-  ht_insert_bw (module, kdata->numdate, kdata->data_nkey, size, kdata->cdnkey);
-  ht_insert_meta_data (module, kdata->numdate, "bytes", size);
+insert_cumts (GO_UNUSED GModule module, GKeyData * kdata, uint64_t ts) {
+  kdata->record.cumts = ts;
 }
 
-/* A wrapper call to increases cumulative time served counter
- * from an uint32_t key. */
+/* Set the time served of the request as a candidate for the maximum time
+ * served of the data key. */
 static void
-insert_cumts (GModule module, GKeyData * kdata, uint64_t ts) {
-  ht_insert_cumts (module, kdata->numdate, kdata->data_nkey, ts, kdata->cdnkey);
-  ht_insert_meta_data (module, kdata->numdate, "cumts", ts);
+insert_maxts (GO_UNUSED GModule module, GKeyData * kdata, uint64_t ts) {
+  kdata->record.maxts = ts;
 }
 
-/* A wrapper call to insert the maximum time served counter from
- * an uint32_t key. */
+/* Set the method of the request given its string value. */
 static void
-insert_maxts (GModule module, GKeyData * kdata, uint64_t ts) {
-  ht_insert_maxts (module, kdata->numdate, kdata->data_nkey, ts, kdata->cdnkey);
-  ht_insert_meta_data (module, kdata->numdate, "maxts", ts);
+insert_method (GO_UNUSED GModule module, GKeyData * kdata, const char *data) {
+  kdata->record.method = ht_get_meth_proto (data ? data : "---");
 }
 
+/* Set the protocol of the request given its string value. */
 static void
-insert_method (GModule module, GKeyData * kdata, const char *data) {
-  ht_insert_method (module, kdata->numdate, kdata->data_nkey, data ? data : "---",
-                    kdata->cdnkey);
+insert_protocol (GO_UNUSED GModule module, GKeyData * kdata, const char *data) {
+  kdata->record.protocol = ht_get_meth_proto (data ? data : "---");
 }
 
-/* A wrapper call to insert a method given an uint32_t key and string
- * value. */
+/* A wrapper call to store all the metrics collected for a data key with a
+ * single lookup on its record. */
 static void
-insert_protocol (GModule module, GKeyData * kdata, const char *data) {
-  ht_insert_protocol (module, kdata->numdate, kdata->data_nkey, data ? data : "---",
-                      kdata->cdnkey);
+insert_record (GModule module, GKeyData * kdata) {
+  ht_insert_record (module, kdata->numdate, kdata->data_nkey, kdata->cdnkey, kdata->crnkey,
+                    &kdata->record);
 }
 
 /* A wrapper call to insert an agent for a hostname given an uint32_t
@@ -745,10 +775,10 @@ gen_unique_req_key (GLogItem * logitem) {
 
   /* nothing to do */
   if (!conf.append_method && !conf.append_protocol)
-    return xstrdup (logitem->req);
+    return arena_strdup (logitem->arena, logitem->req);
   /* still nothing to do */
   if (!logitem->method && !logitem->protocol)
-    return xstrdup (logitem->req);
+    return arena_strdup (logitem->arena, logitem->req);
 
   s1 = strlen (logitem->req);
   if (logitem->method && conf.append_method) {
@@ -761,7 +791,7 @@ gen_unique_req_key (GLogItem * logitem) {
   }
 
   /* includes terminating null */
-  key = xcalloc (s1 + s2 + s3 + nul, sizeof (char));
+  key = arena_alloc (logitem->arena, s1 + s2 + s3 + nul);
   /* append request */
   memcpy (key, logitem->req, s1);
 
@@ -782,7 +812,7 @@ gen_unique_req_key (GLogItem * logitem) {
 /* Append the query string to the request, and therefore, it modifies
  * the original logitem->req */
 static void
-append_query_string (char **req, const char *qstr) {
+append_query_string (GArena * arena, char **req, const char *qstr) {
   char *r;
   size_t s1, s2, qm = 0;
 
@@ -793,13 +823,12 @@ append_query_string (char **req, const char *qstr) {
   if (*qstr != '?')
     qm = 1;
 
-  r = xmalloc (s1 + s2 + qm + 1);
+  r = arena_alloc (arena, s1 + s2 + qm + 1);
   memcpy (r, *req, s1);
   if (qm)
     r[s1] = '?';
   memcpy (r + s1 + qm, qstr, s2 + 1);
 
-  free (*req);
   *req = r;
 }
 
@@ -810,7 +839,7 @@ get_kdata (GKeyData * kdata, const char *data_key, const char *data) {
   /* inserted in datamap */
   kdata->data = data;
   /* inserted in keymap */
-  kdata->dhash = djb2 ((unsigned char *) data_key);
+  kdata->dsid = ht_insert_string (data_key);
 }
 
 /* A wrapper to assign the given data key and the data item to the key
@@ -820,30 +849,28 @@ get_kroot (GKeyData * kdata, const char *root_key, const char *root) {
   /* inserted in datamap */
   kdata->root = root;
   /* inserted in keymap */
-  kdata->rhash = djb2 ((unsigned char *) root_key);
+  kdata->rsid = ht_insert_string (root_key);
 }
 
 /* Generate a visitor's key given the date specificity. For instance,
  * if the specificity if set to hours, then a generated key would
  * look like: 03/Jan/2016:09 */
 static void
-set_spec_visitor_key (char **fdate, const char *ftime) {
+set_spec_visitor_key (GArena * arena, char **fdate, const char *ftime) {
   size_t dlen = 0, tlen = 0;
   char *key = NULL, *tkey = NULL, *pch = NULL;
 
-  tkey = xstrdup (ftime);
+  tkey = arena_strdup (arena, ftime);
   if (conf.date_spec_hr && (pch = strchr (tkey, ':')) && (pch - tkey) > 0)
     *pch = '\0';
 
   dlen = strlen (*fdate);
   tlen = strlen (tkey);
 
-  key = xmalloc (dlen + tlen + 1);
+  key = arena_alloc (arena, dlen + tlen + 1);
   memcpy (key, *fdate, dlen);
   memcpy (key + dlen, tkey, tlen + 1);
 
-  free (*fdate);
-  free (tkey);
   *fdate = key;
 }
 
@@ -860,7 +887,7 @@ gen_visitor_key (GKeyData * kdata, GLogItem * logitem) {
 
   /* Append time specificity to date */
   if (conf.date_spec_hr)
-    set_spec_visitor_key (&logitem->date, logitem->time);
+    set_spec_visitor_key (logitem->arena, &logitem->date, logitem->time);
 
   get_kdata (kdata, logitem->date, logitem->date);
   kdata->numdate = logitem->numdate;
@@ -880,7 +907,7 @@ gen_req_key (GKeyData * kdata, GLogItem * logitem) {
     return 1;
 
   if (logitem->qstr)
-    append_query_string (&logitem->req, logitem->qstr);
+    append_query_string (logitem->arena, &logitem->req, logitem->qstr);
   logitem->req_key = gen_unique_req_key (logitem);
 
   get_kdata (kdata, logitem->req_key, logitem->req);
@@ -991,6 +1018,23 @@ gen_host_key (GKeyData * kdata, GLogItem * logitem) {
   return 0;
 }
 
+/* Classify the user agent of the given log item and set the browser and
+ * the browser type/category. Each distinct agent is classified once. */
+void
+set_browser (GLogItem * logitem) {
+  get_agent_browser (logitem->arena, logitem->agent, logitem->agent_hash,
+                     &logitem->browser, &logitem->browser_type);
+}
+
+/* Classify the user agent of the given log item and set the operating
+ * system and the OS type/category. Each distinct agent is classified
+ * once. */
+void
+set_os (GLogItem * logitem) {
+  get_agent_os (logitem->arena, logitem->agent, logitem->agent_hash, &logitem->os,
+                &logitem->os_type);
+}
+
 /* Generate a browser unique key for the browser's panel given a user
  * agent and assign the browser type/category as a root element.
  *
@@ -999,15 +1043,12 @@ gen_host_key (GKeyData * kdata, GLogItem * logitem) {
  * structure. */
 static int
 gen_browser_key (GKeyData * kdata, GLogItem * logitem) {
-  char *agent = NULL;
-  char browser_type[BROWSER_TYPE_LEN] = "";
-
   if (logitem->agent == NULL || *logitem->agent == '\0')
     return 1;
 
-  agent = xstrdup (logitem->agent);
-  logitem->browser = verify_browser (agent, browser_type);
-  logitem->browser_type = xstrdup (browser_type);
+  /* may have been classified already by a parser worker */
+  if (logitem->browser == NULL)
+    set_browser (logitem);
 
   /* e.g., Firefox 11.12 */
   get_kdata (kdata, logitem->browser, logitem->browser);
@@ -1016,8 +1057,6 @@ gen_browser_key (GKeyData * kdata, GLogItem * logitem) {
   get_kroot (kdata, logitem->browser_type, logitem->browser_type);
   kdata->numdate = logitem->numdate;
 
-  free (agent);
-
   return 0;
 }
 
@@ -1029,15 +1068,12 @@ gen_browser_key (GKeyData * kdata, GLogItem * logitem) {
  * structure. */
 static int
 gen_os_key (GKeyData * kdata, GLogItem * logitem) {
-  char *agent = NULL;
-  char os_type[OPESYS_TYPE_LEN] = "";
-
   if (logitem->agent == NULL || *logitem->agent == '\0')
     return 1;
 
-  agent = xstrdup (logitem->agent);
-  logitem->os = verify_os (agent, os_type);
-  logitem->os_type = xstrdup (os_type);
+  /* may have been classified already by a parser worker */
+  if (logitem->os == NULL)
+    set_os (logitem);
 
   /* e.g., GNU+Linux,Ubuntu 10.12 */
   get_kdata (kdata, logitem->os, logitem->os);
@@ -1046,8 +1082,6 @@ gen_os_key (GKeyData * kdata, GLogItem * logitem) {
   get_kroot (kdata, logitem->os_type, logitem->os_type);
   kdata->numdate = logitem->numdate;
 
-  free (agent);
-
   return 0;
 }
 
@@ -1150,7 +1184,7 @@ gen_tls_type_key (GKeyData * kdata, GLogItem * logitem) {
   clen = strlen (logitem->tls_cypher);
   tlen = strlen (tls);
 
-  logitem->tls_type_cypher = xmalloc (tlen + clen + 2);
+  logitem->tls_type_cypher = arena_alloc (logitem->arena, tlen + clen + 2);
   memcpy (logitem->tls_type_cypher, tls, tlen);
   logitem->tls_type_cypher[tlen] = '/';
   /* includes terminating null */
@@ -1244,10 +1278,10 @@ gen_geolocation_key (GKeyData * kdata, GLogItem * logitem) {
     return 1;
 
   if (country[0] != '\0')
-    logitem->country = xstrdup (country);
+    logitem->country = arena_strdup (logitem->arena, country);
 
   if (continent[0] != '\0')
-    logitem->continent = xstrdup (continent);
+    logitem->continent = arena_strdup (logitem->arena, continent);
 
   get_kdata (kdata, logitem->country, logitem->country);
   get_kroot (kdata, logitem->continent, logitem->continent);
@@ -1331,8 +1365,7 @@ gen_visit_time_key (GKeyData * kdata, GLogItem * logitem) {
   if ((hmark = strchr (hour, ':')))
     parse_time_specificity_string (hmark, hour);
 
-  free (logitem->time);
-  logitem->time = xstrdup (hour);
+  logitem->time = arena_strdup (logitem->arena, hour);
 
   get_kdata (kdata, logitem->time, logitem->time);
   kdata->numdate = logitem->numdate;
@@ -1397,6 +1430,8 @@ set_datamap (GLogItem * logitem, GKeyData * kdata, const GParse * parse) {
   /* insert protocol */
   if (parse->protocol && conf.append_protocol)
     parse->protocol (module, kdata, logitem->protocol);
+  /* store all the metrics above at once */
+  insert_record (module, kdata);
   /* insert agent */
   if (parse->agent && conf.list_agents)
     parse->agent (module, kdata, logitem->agent_nkey);
@@ -1417,7 +1452,7 @@ map_log (GLogItem * logitem, const GParse * parse, GModule module) {
     kdata.data_nkey = insert_dkeymap (module, &kdata);
 
   /* each module contains a uniq visitor key/value */
-  if (parse->visitor && logitem->uniq_key && include_uniq (logitem))
+  if (parse->visitor && include_uniq (logitem))
     kdata.uniq_nkey = insert_uniqmap (module, &kdata, logitem->uniq_nkey);
 
   /* root keys are optional */
@@ -1464,11 +1499,9 @@ clean_old_data_by_date (uint32_t numdate) {
     return -1;
   }
 
-  /* invalidate the first date we inserted then */
+  /* invalidate the first date we inserted then, new data is added upon
+   * the existing cache */
   invalidate_date (dates[0]);
-  /* rebuild all existing dates and let new data
-   * be added upon existing cache */
-  rebuild_rawdata_cache ();
   free (dates);
 
   return 0;
@@ -1478,9 +1511,8 @@ clean_old_data_by_date (uint32_t numdate) {
  * structure. */
 void
 process_log (GLogItem * logitem) {
-  GModule module;
   const GParse *parse = NULL;
-  size_t idx = 0;
+  int i;
   uint32_t numdate = logitem->numdate;
 
   if (conf.keep_last > 0 && clean_old_data_by_date (numdate) == -1)
@@ -1492,7 +1524,7 @@ process_log (GLogItem * logitem) {
 
   /* Insert one unique visitor key per request to avoid the
    * overhead of storing one key per module */
-  if ((logitem->uniq_nkey = ht_insert_unique_key (numdate, logitem->uniq_key)) == 0)
+  if ((logitem->uniq_nkey = ht_insert_unique_key (numdate, &logitem->uniq_key)) == 0)
     return;
 
   /* If we need to store user agents per IP, then we store them and retrieve
@@ -1502,11 +1534,9 @@ process_log (GLogItem * logitem) {
   if (conf.list_agents)
     ins_agent_key_val (logitem, numdate);
 
-  FOREACH_MODULE (idx, module_list) {
-    module = module_list[idx];
-    if (!(parse = panel_lookup (module)))
-      continue;
-    map_log (logitem, parse, module);
+  for (i = 0; i < panel_parsers_len; ++i) {
+    parse = panel_parsers[i];
+    map_log (logitem, parse, parse->module);
   }
 
   count_bw (numdate, logitem->resp_size);
@@ -34,7 +34,7 @@
 #include "parser.h"
 
 /* Total number of storage metrics (GSMetric) */
-#define GSMTRC_TOTAL 19
+#define GSMTRC_TOTAL 20
 #define DB_PATH "/tmp"
 
 /* Enumerated Storage Metrics */
@@ -43,6 +43,15 @@ typedef enum GSMetric_ {
   MTRC_ROOTMAP,
   MTRC_DATAMAP,
   MTRC_UNIQMAP,
+  MTRC_RECORDS,
+  MTRC_AGENTS,
+  MTRC_METADATA,
+  MTRC_UNIQUE_KEYS,
+  MTRC_AGENT_KEYS,
+  MTRC_AGENT_VALS,
+  MTRC_CNT_VALID,
+  MTRC_CNT_BW,
+  /* fields of a MTRC_RECORDS record */
   MTRC_ROOT,
   MTRC_HITS,
   MTRC_VISITORS,
@@ -51,38 +60,48 @@ typedef enum GSMetric_ {
   MTRC_MAXTS,
   MTRC_METHODS,
   MTRC_PROTOCOLS,
-  MTRC_AGENTS,
-  MTRC_METADATA,
-  MTRC_UNIQUE_KEYS,
-  MTRC_AGENT_KEYS,
-  MTRC_AGENT_VALS,
-  MTRC_CNT_VALID,
-  MTRC_CNT_BW,
 } GSMetric;
 
-#define GAMTRC_TOTAL 8
+/* Number of per module storage metrics (MTRC_KEYMAP to MTRC_METADATA) and
+ * of per date global storage metrics (MTRC_UNIQUE_KEYS to MTRC_CNT_BW) */
+#define GSMTRC_MODULE_TOTAL (MTRC_METADATA + 1)
+#define GSMTRC_GLOBAL_TOTAL (MTRC_CNT_BW - MTRC_UNIQUE_KEYS + 1)
+
+#define GAMTRC_TOTAL 7
 /* Enumerated App Metrics */
 typedef enum GAMetric_ {
   MTRC_DATES,
   MTRC_SEQS,
   MTRC_CNT_OVERALL,
-  MTRC_HOSTNAMES,
   MTRC_LAST_PARSE,
   MTRC_JSON_LOGFMT,
   MTRC_METH_PROTO,
   MTRC_DB_PROPS,
 } GAMetric;
 
+/* Numeric metrics of a single data key. They are kept together so a log
+ * line updates all of them with a single lookup */
+typedef struct GKeyRecord_ {
+  uint64_t bw;
+  uint64_t cumts;
+  uint64_t maxts;
+  uint32_t hits;
+  uint32_t visitors;
+  uint32_t root;
+  uint8_t method;
+  uint8_t protocol;
+} GKeyRecord;
+
 /* Each record contains a data value, i.e., Windows XP, and it may contain a
  * root value, i.e., Windows, and a unique key which is the combination of
  * date, IP and user agent */
 typedef struct GKeyData_ {
   const void *data;
-  uint32_t dhash;
+  uint32_t dsid;                /* interned data key id */
   uint32_t data_nkey;
   uint32_t cdnkey;              /* cache data nkey */
 
-  uint32_t rhash;
+  uint32_t rsid;                /* interned root key id */
   const void *root;
   const void *root_key;
   uint32_t root_nkey;
@@ -91,6 +110,8 @@ typedef struct GKeyData_ {
   void *uniq_key;
   uint32_t uniq_nkey;
 
+  GKeyRecord record;            /* metrics collected for the data key */
+
   uint32_t numdate;
 } GKeyData;
 
@@ -130,13 +151,18 @@ char *get_mtr_str (GSMetric metric);
 int excluded_ip (GLogItem * logitem);
 uint32_t *i322ptr (uint32_t val);
 uint64_t *uint642ptr (uint64_t val);
+void compile_panel_parsers (void);
+void count_excluded_ip (void);
 void count_process_and_invalid (GLog * glog, const char *line);
+void count_prefiltered (void);
 void count_process (GLog * glog);
 void free_gmetrics (GMetrics * metric);
 void insert_methods_protocols (void);
 void process_log (GLogItem * logitem);
+void set_browser (GLogItem * logitem);
 void set_data_metrics (GMetrics * ometrics, GMetrics ** nmetrics, GPercTotals totals);
 void set_module_totals (GPercTotals * totals);
+void set_os (GLogItem * logitem);
 void uncount_invalid (GLog * glog);
 void uncount_processed (GLog * glog);
 GMetrics *new_gmetrics (void);
@@ -0,0 +1,280 @@
+/**
+ * gwcset.c -- match a string against a set of wildcard patterns
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gwcset.h"
+
+#include "xmalloc.h"
+
+/* Append a new node to the given trie, without any transitions.
+ *
+ * On success, the new node is returned. */
+static uint32_t
+new_trie_node (GWCTrie * trie) {
+  uint32_t n = trie->nodes;
+
+  if (trie->nodes == trie->size) {
+    trie->size = trie->size ? trie->size * 2 : 16;
+    trie->go = xrealloc (trie->go, trie->size * WC_ALPHABET * sizeof (uint32_t));
+    trie->term = xrealloc (trie->term, trie->size * sizeof (uint8_t));
+  }
+
+  memset (trie->go + (size_t) n * WC_ALPHABET, 0, WC_ALPHABET * sizeof (uint32_t));
+  trie->term[n] = 0;
+  trie->nodes++;
+
+  return n;
+}
+
+/* Insert the first len bytes of str into the given trie, last byte
+ * first if reverse is set. */
+static void
+trie_add (GWCTrie * trie, const char *str, size_t len, int reverse) {
+  const unsigned char *p = (const unsigned char *) str;
+  uint32_t n = 0, next = 0;
+  size_t i = 0;
+  unsigned char c;
+
+  if (trie->nodes == 0)
+    new_trie_node (trie);
+
+  for (i = 0; i < len; ++i) {
+    c = reverse ? p[len - 1 - i] : p[i];
+    /* node 0 is the root, thus never the target of an edge */
+    if ((next = trie->go[(size_t) n * WC_ALPHABET + c]) == 0) {
+      next = new_trie_node (trie);
+      trie->go[(size_t) n * WC_ALPHABET + c] = next;
+    }
+    n = next;
+  }
+  trie->term[n] = 1;
+}
+
+/* Initialize an empty set of patterns. */
+void
+wcset_init (GWCSet * set) {
+  memset (set, 0, sizeof (*set));
+  set->exact = kh_init (si08);
+}
+
+/* Free all patterns of the given set. */
+void
+wcset_free (GWCSet * set) {
+  khint_t k;
+  int i;
+
+  if (set->exact) {
+    for (k = kh_begin (set->exact); k != kh_end (set->exact); ++k) {
+      if (kh_exist (set->exact, k))
+        free ((char *) kh_key (set->exact, k));
+    }
+    kh_destroy (si08, set->exact);
+  }
+  for (i = 0; i < set->globs_idx; ++i)
+    free (set->globs[i]);
+  free (set->globs);
+  free (set->prefix.go);
+  free (set->prefix.term);
+  free (set->suffix.go);
+  free (set->suffix.term);
+  memset (set, 0, sizeof (*set));
+}
+
+/* Add a wildcard pattern to the set, where `*` matches a run of
+ * characters and `?` any single character. Consecutive stars are
+ * collapsed as they match the same strings. */
+void
+wcset_add (GWCSet * set, const char *pattern) {
+  char *wc = NULL, *star = NULL;
+  const char *p = NULL;
+  size_t len = 0;
+  int stars = 0, ret = 0;
+  khint_t k;
+
+  if (pattern == NULL || *pattern == '\0')
+    return;
+
+  wc = xmalloc (strlen (pattern) + 1);
+  for (p = pattern; *p; ++p) {
+    if (*p == '*' && len > 0 && wc[len - 1] == '*')
+      continue;
+    if (*p == '*')
+      stars++, star = wc + len;
+    wc[len++] = *p;
+  }
+  wc[len] = '\0';
+
+  if (strchr (wc, '?') != NULL || stars > 1) {
+    set->globs = xrealloc (set->globs, (set->globs_idx + 1) * sizeof (char *));
+    set->globs[set->globs_idx++] = wc;
+    return;
+  }
+
+  if (stars == 0) {
+    k = kh_put (si08, set->exact, wc, &ret);
+    if (ret == 0)
+      free (wc);
+    kh_val (set->exact, k) = 1;
+    return;
+  }
+
+  if (len == 1)
+    set->any = 1;
+  else if (star == wc + len - 1)
+    trie_add (&set->prefix, wc, len - 1, 0);
+  else if (star == wc)
+    trie_add (&set->suffix, wc + 1, len - 1, 1);
+  else {
+    set->globs = xrealloc (set->globs, (set->globs_idx + 1) * sizeof (char *));
+    set->globs[set->globs_idx++] = wc;
+    return;
+  }
+  free (wc);
+}
+
+/* Determine if a `lit*` pattern matches the given string. The star
+ * has to match at least one character.
+ *
+ * If no pattern matches, 0 is returned.
+ * If a pattern matches, 1 is returned. */
+static int
+match_prefix (const GWCTrie * trie, const unsigned char *str) {
+  uint32_t n = 0;
+
+  if (trie->nodes == 0)
+    return 0;
+
+  for (; *str; ++str) {
+    if (trie->term[n])
+      return 1;
+    if ((n = trie->go[(size_t) n * WC_ALPHABET + *str]) == 0)
+      return 0;
+  }
+
+  return 0;
+}
+
+/* Determine if a `*lit` pattern matches the given string. The star
+ * does not backtrack, it stops at the first occurrence of the first
+ * character of the literal, which then has to end the string.
+ *
+ * If no pattern matches, 0 is returned.
+ * If a pattern matches, 1 is returned. */
+static int
+match_suffix (const GWCTrie * trie, const unsigned char *str, size_t len) {
+  uint32_t n = 0;
+  size_t i = len;
+
+  if (trie->nodes == 0)
+    return 0;
+
+  while (i > 0) {
+    if ((n = trie->go[(size_t) n * WC_ALPHABET + str[--i]]) == 0)
+      return 0;
+    if (trie->term[n] && memchr (str, str[i], i) == NULL)
+      return 1;
+  }
+
+  return 0;
+}
+
+/* Run all remaining patterns side by side over a single pass of the
+ * given string, WC_BATCH at a time. Each pattern keeps a position, a
+ * star stays put until the character that follows it is seen.
+ *
+ * If no pattern matches, 0 is returned.
+ * If a pattern matches, 1 is returned. */
+static int
+match_globs (const GWCSet * set, const unsigned char *str) {
+  const unsigned char *p = NULL;
+  const char *wc = NULL;
+  int pos[WC_BATCH];
+  int base = 0, i = 0, n = 0, live = 0;
+
+  for (base = 0; base < set->globs_idx; base += WC_BATCH) {
+    n = set->globs_idx - base < WC_BATCH ? set->globs_idx - base : WC_BATCH;
+    for (i = 0; i < n; ++i)
+      pos[i] = 0;
+
+    for (live = n, p = str; *p && live > 0; ++p) {
+      for (i = 0; i < n; ++i) {
+        if (pos[i] < 0)
+          continue;
+
+        wc = set->globs[base + i] + pos[i];
+        if (*wc == '*') {
+          /* a trailing star matches whatever is left */
+          if (wc[1] == '\0')
+            return 1;
+          if (wc[1] == (char) *p)
+            pos[i] += 2;
+        } else if (*wc != '\0' && (*wc == '?' || *wc == (char) *p)) {
+          pos[i]++;
+        } else {
+          pos[i] = -1;
+          live--;
+        }
+      }
+    }
+
+    for (i = 0; i < n; ++i) {
+      if (pos[i] >= 0 && set->globs[base + i][pos[i]] == '\0')
+        return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Determine if any pattern of the set matches the given string.
+ *
+ * If no pattern matches, 0 is returned.
+ * If a pattern matches, 1 is returned. */
+int
+wcset_match (const GWCSet * set, const char *str) {
+  const unsigned char *s = (const unsigned char *) str;
+
+  if (str == NULL || *str == '\0')
+    return 0;
+
+  if (set->any)
+    return 1;
+  if (kh_get (si08, set->exact, str) != kh_end (set->exact))
+    return 1;
+  if (match_prefix (&set->prefix, s))
+    return 1;
+  if (match_suffix (&set->suffix, s, strlen (str)))
+    return 1;
+
+  return match_globs (set, s);
+}
@@ -0,0 +1,66 @@
+/**
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GWCSET_H_INCLUDED
+#define GWCSET_H_INCLUDED
+
+#include <stdint.h>
+
+#include "gkhash.h"
+
+#define WC_ALPHABET 256
+/* number of fallback patterns run side by side */
+#define WC_BATCH    64
+
+/* A trie of literal strings, one transition table per node */
+typedef struct GWCTrie_ {
+  uint32_t *go;                 /* WC_ALPHABET transitions per node */
+  uint8_t *term;                /* whether a string ends at a node */
+  uint32_t nodes;               /* number of nodes */
+  uint32_t size;                /* number of nodes allocated */
+} GWCTrie;
+
+/* A set of wildcard patterns compiled into a single matcher. Patterns
+ * are split by shape, exact strings, `lit*`, `*lit` and anything else,
+ * and each shape is matched by its own structure */
+typedef struct GWCSet_ {
+  khash_t (si08) * exact;       /* patterns without wildcards */
+  GWCTrie prefix;               /* `lit*` patterns */
+  GWCTrie suffix;               /* `*lit` patterns, reversed */
+  char **globs;                 /* any other pattern, stars collapsed */
+  int globs_idx;                /* number of fallback patterns */
+  uint8_t any:1;                /* a `*` pattern was added */
+} GWCSet;
+
+int wcset_match (const GWCSet * set, const char *str);
+void wcset_add (GWCSet * set, const char *pattern);
+void wcset_free (GWCSet * set);
+void wcset_init (GWCSet * set);
+
+#endif // for #ifndef GWCSET_H
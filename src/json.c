@@ -504,6 +504,13 @@ poverall_excluded (GJSON * json, int sp) {
   pskeyu64val (json, OVERALL_EXCL_HITS, ht_get_excluded_ips (), sp, 0);
 }
 
+/* Write to a buffer the number of lines rejected by --prefilter under
+ * the overall object. */
+static void
+poverall_prefiltered (GJSON * json, int sp) {
+  pskeyu64val (json, OVERALL_PREFILTER, ht_get_prefiltered (), sp, 0);
+}
+
 /* Write to a buffer the number of referrers under the overall object. */
 static void
 poverall_refs (GJSON * json, int sp) {
@@ -1096,6 +1103,9 @@ print_json_summary (GJSON * json, GHolder * holder) {
   poverall_files (json, isp);
   /* excluded hits */
   poverall_excluded (json, isp);
+  /* prefiltered lines */
+  if (conf.prefilter_idx > 0)
+    poverall_prefiltered (json, isp);
   /* referrers */
   poverall_refs (json, isp);
   /* not found */
@@ -64,6 +64,7 @@
 #define T_GEN_TIME               _( "Init. Proc. Time")
 #define T_LOG                    _( "Log Size")
 #define T_LOG_PATH               _( "Log Source")
+#define T_PREFILTERED            _( "Prefiltered")
 #define T_REFERRER               _( "Referrers")
 #define T_REQUESTS               _( "Total Requests")
 #define T_STATIC_FILES           _( "Static Files")
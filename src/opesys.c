@@ -38,12 +38,15 @@
 #include "opesys.h"
 
 #include "error.h"
+#include "gacm.h"
 #include "settings.h"
 #include "util.h"
 #include "xmalloc.h"
 
-/* ###NOTE: The size of the list is proportional to the run time,
- * which makes this pretty slow */
+/* The list of operating systems compiled into a single automaton so a
+ * user agent is scanned once against all of them. Entries keep the
+ * priority of their position within the list */
+static GACM os_acm;
 
 /* {"search string", "belongs to"} */
 static const char *os[][2] = {
@@ -385,25 +388,38 @@ parse_os (const char *str, char *tkn, char *os_type, int idx) {
   return alloc_string (parse_others (tkn, spaces));
 }
 
+/* Compile the list of operating systems into the OS automaton. */
+void
+compile_os (void) {
+  size_t i;
+
+  acm_init (&os_acm);
+  for (i = 0; i < ARRAY_SIZE (os); i++)
+    acm_add (&os_acm, os[i][0]);
+  acm_build (&os_acm);
+}
+
+/* Free the OS automaton. */
+void
+free_os (void) {
+  acm_free (&os_acm);
+}
+
 /* Given a user agent, determine the operating system used.
- *
- * ###NOTE: The size of the list is proportional to the run time,
- * which makes this pretty slow
  *
  * On error, NULL is returned.
  * On success, a malloc'd  string containing the OS is returned. */
 char *
 verify_os (const char *str, char *os_type) {
-  char *a;
-  size_t i;
+  const char *a = NULL;
+  int idx = 0;
 
   if (str == NULL || *str == '\0')
     return NULL;
 
-  for (i = 0; i < ARRAY_SIZE (os); i++) {
-    if ((a = strstr (str, os[i][0])) != NULL)
-      return parse_os (str, a, os_type, i);
-  }
+  /* the first entry of the list found within the agent */
+  if ((idx = acm_first (&os_acm, str, &a)) != -1)
+    return parse_os (str, (char *) a, os_type, idx);
   xstrncpy (os_type, "Unknown", OPESYS_TYPE_LEN);
 
   if (conf.unknowns_log)
@@ -39,5 +39,7 @@ typedef struct GOpeSys_ {
 } GOpeSys;
 
 char *verify_os (const char *str, char *os_type);
+void compile_os (void);
+void free_os (void);
 
 #endif
@@ -45,6 +45,7 @@
 #include "options.h"
 
 #include "error.h"
+#include "gdns.h"
 #include "labels.h"
 #include "util.h"
 
@@ -94,6 +95,8 @@ struct option long_opts[] = {
   {"date-spec"            , required_argument , 0 , 0  }  ,
   {"db-path"              , required_argument , 0 , 0  }  ,
   {"dcf"                  , no_argument       , 0 , 0  }  ,
+  {"dns-hosts-file"       , required_argument , 0 , 0  }  ,
+  {"dns-threads"          , required_argument , 0 , 0  }  ,
   {"double-decode"        , no_argument       , 0 , 0  }  ,
   {"enable-panel"         , required_argument , 0 , 0  }  ,
   {"fifo-in"              , required_argument , 0 , 0  }  ,
@@ -110,6 +113,7 @@ struct option long_opts[] = {
   {"ignore-statics"       , required_argument , 0 , 0  }  ,
   {"ignore-status"        , required_argument , 0 , 0  }  ,
   {"invalid-requests"     , required_argument , 0 , 0  }  ,
+  {"jobs"                 , required_argument , 0 , 0  }  ,
   {"unknowns-log"         , required_argument , 0 , 0  }  ,
   {"json-pretty-print"    , no_argument       , 0 , 0  }  ,
   {"keep-last"            , required_argument , 0 , 0  }  ,
@@ -132,6 +136,7 @@ struct option long_opts[] = {
   {"persist"              , no_argument       , 0 , 0  }  ,
   {"pid-file"             , required_argument , 0 , 0  }  ,
   {"port"                 , required_argument , 0 , 0  }  ,
+  {"prefilter"            , required_argument , 0 , 0  }  ,
   {"process-and-exit"     , no_argument       , 0 , 0  }  ,
   {"real-os"              , no_argument       , 0 , 0  }  ,
   {"real-time-html"       , no_argument       , 0 , 0  }  ,
@@ -226,7 +231,7 @@ cmd_help (void)
   "  -b --browsers-file=<path>       - Use additional custom list of browsers.\n"
   "  -d --with-output-resolver       - Enable IP resolver on HTML|JSON output.\n"
   "  -e --exclude-ip=<IP>            - Exclude one or multiple IPv4/6. Allows IP ranges\n"
-  "                                    e.g. 192.168.0.1-192.168.0.10\n"
+  "                                    e.g. 192.168.0.1-192.168.0.10 or 10.0.0.0/8\n"
   "  -H --http-protocol=<yes|no>     - Set/unset HTTP request protocol if found.\n"
   "  -M --http-method=<yes|no>       - Set/unset HTTP request method if found.\n"
   "  -o --output=file.html|json|csv  - Output either an HTML, JSON or a CSV file.\n"
@@ -238,6 +243,8 @@ cmd_help (void)
   "  --anonymize-ip                  - Anonymize IP addresses before outputting to report.\n"
   "  --crawlers-only                 - Parse and display only crawlers.\n"
   "  --date-spec=<date|hr>           - Date specificity. Possible values: `date` (default), or `hr`.\n"
+  "  --dns-hosts-file=<path>         - Resolve IPs from an /etc/hosts-style file instead of DNS.\n"
+  "  --dns-threads=<number>          - Number of threads resolving IPs (4 default).\n"
   "  --double-decode                 - Decode double-encoded values.\n"
   "  --enable-panel=<PANEL>          - Enable parsing/displaying the given panel.\n"
   "  --hide-referrer=<NEEDLE>        - Hide a referrer but still count it. Wild cards are allowed.\n"
@@ -252,11 +259,15 @@ cmd_help (void)
   "                                    req => Ignore from valid requests.\n"
   "                                    panel => Ignore from valid requests and panels.\n"
   "  --ignore-status=<CODE>          - Ignore parsing the given status code.\n"
+  "  --jobs=<number>                 - Number of threads used to parse a log. >= 2 enables\n"
+  "                                    a parallel parser (disabled by default).\n"
   "  --keep-last=<NDAYS>             - Keep the last NDAYS in storage.\n"
   "  --no-ip-validation              - Disable client IPv4/6  validation.\n"
   "  --no-strict-status              - Disable HTTP status code validation.\n"
   "  --num-tests=<number>            - Number of lines to test. >= 0 (10 default)\n"
   "  --persist                       - Persist data to disk on exit to the given --db-path or to /tmp.\n"
+  "  --prefilter=<EXPR>              - Parse only lines matching EXPR before parsing them.\n"
+  "                                    text, ^prefix, or $N=value (Nth field, value* for a prefix)\n"
   "  --process-and-exit              - Parse log and exit without outputting data.\n"
   "  --real-os                       - Display real OS names. e.g, Windows XP, Snow Leopard.\n"
   "  --restore                       - Restore data from disk from the given --db-path or from /tmp.\n"
@@ -528,6 +539,10 @@ parse_long_opt (const char *name, const char *oarg) {
   if (!strcmp ("ignore-referrer", name))
     set_array_opt (oarg, conf.ignore_referers, &conf.ignore_referer_idx, MAX_IGNORE_REF);
 
+  /* raw line filters */
+  if (!strcmp ("prefilter", name))
+    set_array_opt (oarg, conf.prefilters, &conf.prefilter_idx, MAX_PREFILTERS);
+
   /* client IP validation */
   if (!strcmp ("no-ip-validation", name))
     conf.no_ip_validation = 1;
@@ -559,6 +574,28 @@ parse_long_opt (const char *name, const char *oarg) {
     conf.num_tests = tests >= 0 ? tests : 0;
   }
 
+  /* number of parser worker threads */
+  if (!strcmp ("jobs", name)) {
+    char *sEnd;
+    int jobs = strtol (oarg, &sEnd, 10);
+    if (oarg == sEnd || *sEnd != '\0' || errno == ERANGE)
+      return;
+    conf.jobs = jobs > MAX_JOBS ? MAX_JOBS : jobs > 0 ? jobs : 0;
+  }
+
+  /* number of reverse DNS resolver threads */
+  if (!strcmp ("dns-threads", name)) {
+    char *sEnd;
+    int threads = strtol (oarg, &sEnd, 10);
+    if (oarg == sEnd || *sEnd != '\0' || errno == ERANGE)
+      return;
+    conf.dns_threads = threads > MAX_DNS_THREADS ? MAX_DNS_THREADS : threads > 0 ? threads : 0;
+  }
+
+  /* resolve IPs out of a hosts file */
+  if (!strcmp ("dns-hosts-file", name))
+    conf.dns_hosts_file = oarg;
+
   /* number of days to keep in storage */
   if (!strcmp ("keep-last", name)) {
     char *sEnd;
@@ -636,6 +636,18 @@ print_def_overall_excluded (FILE * fp, int sp) {
   fpclose_obj (fp, sp, 0);
 }
 
+/* Output JSON overall prefiltered lines definition block. */
+static void
+print_def_overall_prefiltered (FILE * fp, int sp) {
+  GDefMetric def = {
+    .lbl = T_PREFILTERED,
+    .datatype = "numeric",
+  };
+  fpopen_obj_attr (fp, OVERALL_PREFILTER, sp);
+  print_def_metric (fp, def, sp);
+  fpclose_obj (fp, sp, 0);
+}
+
 /* Output JSON overall referrers definition block. */
 static void
 print_def_overall_refs (FILE * fp, int sp) {
@@ -1060,6 +1072,8 @@ print_def_summary (FILE * fp, int sp) {
   print_def_overall_visitors (fp, iisp);
   print_def_overall_files (fp, iisp);
   print_def_overall_excluded (fp, iisp);
+  if (conf.prefilter_idx > 0)
+    print_def_overall_prefiltered (fp, iisp);
   print_def_overall_refs (fp, iisp);
   print_def_overall_notfound (fp, iisp);
   print_def_overall_static_files (fp, iisp);
@@ -58,6 +58,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
 
 #include "gkhash.h"
 
@@ -65,7 +66,9 @@
 
 #include "browsers.h"
 #include "error.h"
+#include "gagent.h"
 #include "goaccess.h"
+#include "gscan.h"
 #include "gstorage.h"
 #include "pdjson.h"
 #include "util.h"
@@ -170,6 +173,7 @@ free_logs (Logs * logs) {
     free (glog->filename);
     free_logerrors (glog);
     free (glog->errors);
+    arena_free (&glog->arena);
     if (glog->pipe) {
       fclose (glog->pipe);
     }
@@ -179,16 +183,32 @@ free_logs (Logs * logs) {
   free (logs);
 }
 
-/* Initialize a new GLogItem instance.
+/* Take the local time once per second into the given date cache. The
+ * tokens cached within the previous second are dropped as any field they
+ * lack came from the previous local time. */
+static void
+refresh_date_cache (GDateCache * dc) {
+  time_t now = time (0);
+
+  if (now == dc->now)
+    return;
+
+  dc->now = now;
+  localtime_r (&now, &dc->tm_now);
+  dc->date.tkn[0] = '\0';
+  dc->time.tkn[0] = '\0';
+  dc->tstamp.tkn[0] = '\0';
+}
+
+/* Allocate a new GLogItem instance off the given arena and initialize
+ * its data. Its strings are allocated off the same arena.
  *
  * On success, the new GLogItem instance is returned. */
-GLogItem *
-init_log_item (GLog * glog) {
-  time_t now = time (0);
+static GLogItem *
+new_log_item (GArena * arena, GDateCache * dc) {
   GLogItem *logitem;
-  glog->items = xmalloc (sizeof (GLogItem));
-  logitem = glog->items;
-  memset (logitem, 0, sizeof *logitem);
+  logitem = arena_alloc (arena, sizeof (GLogItem));
+  memset (logitem, 0, offsetof (GLogItem, site));
 
   logitem->agent = NULL;
   logitem->browser = NULL;
@@ -211,7 +231,6 @@ init_log_item (GLog * glog) {
   logitem->serve_time = 0;
   logitem->status = NULL;
   logitem->time = NULL;
-  logitem->uniq_key = NULL;
   logitem->vhost = NULL;
   logitem->userid = NULL;
   logitem->cache_status = NULL;
@@ -222,73 +241,24 @@ init_log_item (GLog * glog) {
   logitem->tls_cypher = NULL;
   logitem->tls_type_cypher = NULL;
 
-  memset (logitem->site, 0, sizeof (logitem->site));
-  memset (logitem->agent_hex, 0, sizeof (logitem->agent_hex));
-  localtime_r (&now, &logitem->dt);
+  logitem->site[0] = '\0';
+  logitem->arena = arena;
+  logitem->dcache = dc;
+
+  refresh_date_cache (dc);
+  logitem->dt = dc->tm_now;
 
   return logitem;
 }
 
-/* Free all members of a GLogItem */
-static void
-free_glog (GLogItem * logitem) {
-  if (logitem->agent != NULL)
-    free (logitem->agent);
-  if (logitem->browser != NULL)
-    free (logitem->browser);
-  if (logitem->browser_type != NULL)
-    free (logitem->browser_type);
-  if (logitem->continent != NULL)
-    free (logitem->continent);
-  if (logitem->country != NULL)
-    free (logitem->country);
-  if (logitem->date != NULL)
-    free (logitem->date);
-  if (logitem->errstr != NULL)
-    free (logitem->errstr);
-  if (logitem->host != NULL)
-    free (logitem->host);
-  if (logitem->keyphrase != NULL)
-    free (logitem->keyphrase);
-  if (logitem->method != NULL)
-    free (logitem->method);
-  if (logitem->os != NULL)
-    free (logitem->os);
-  if (logitem->os_type != NULL)
-    free (logitem->os_type);
-  if (logitem->protocol != NULL)
-    free (logitem->protocol);
-  if (logitem->qstr != NULL)
-    free (logitem->qstr);
-  if (logitem->ref != NULL)
-    free (logitem->ref);
-  if (logitem->req_key != NULL)
-    free (logitem->req_key);
-  if (logitem->req != NULL)
-    free (logitem->req);
-  if (logitem->status != NULL)
-    free (logitem->status);
-  if (logitem->time != NULL)
-    free (logitem->time);
-  if (logitem->uniq_key != NULL)
-    free (logitem->uniq_key);
-  if (logitem->userid != NULL)
-    free (logitem->userid);
-  if (logitem->cache_status != NULL)
-    free (logitem->cache_status);
-  if (logitem->vhost != NULL)
-    free (logitem->vhost);
-
-  if (logitem->mime_type != NULL)
-    free (logitem->mime_type);
-  if (logitem->tls_type != NULL)
-    free (logitem->tls_type);
-  if (logitem->tls_cypher != NULL)
-    free (logitem->tls_cypher);
-  if (logitem->tls_type_cypher != NULL)
-    free (logitem->tls_type_cypher);
-
-  free (logitem);
+/* Initialize a new GLogItem instance and set it as the current item
+ * of the given log.
+ *
+ * On success, the new GLogItem instance is returned. */
+GLogItem *
+init_log_item (GLog * glog) {
+  glog->items = new_log_item (&glog->arena, &glog->dcache);
+  return glog->items;
 }
 
 /* Decodes the given URL-encoded string.
@@ -313,16 +283,16 @@ decode_hex (char *url, char *out) {
 
 /* Entry point to decode the given URL-encoded string.
  *
- * On success, the decoded trimmed string is assigned to the output
- * buffer. */
+ * On success, the decoded trimmed string, allocated off the given arena,
+ * is returned. */
 static char *
-decode_url (char *url) {
+decode_url (GArena * arena, char *url) {
   char *out, *decoded;
 
   if ((url == NULL) || (*url == '\0'))
     return NULL;
 
-  out = decoded = xstrdup (url);
+  out = decoded = arena_strdup (arena, url);
   decode_hex (url, out);
   /* double encoded URL? */
   if (conf.double_decode)
@@ -339,7 +309,7 @@ decode_url (char *url) {
  * On error, 1 is returned.
  * On success, the extracted keyphrase is assigned and 0 is returned. */
 static int
-extract_keyphrase (char *ref, char **keyphrase) {
+extract_keyphrase (GArena * arena, char *ref, char **keyphrase) {
   char *r, *ptr, *pch, *referer;
   int encoded = 0;
 
@@ -376,11 +346,9 @@ extract_keyphrase (char *ref, char **keyphrase) {
   else if (encoded && (ptr = strstr (r, "%26")) != NULL)
     *ptr = '\0';
 
-  referer = decode_url (r);
-  if (referer == NULL || *referer == '\0') {
-    free (referer);
+  referer = decode_url (arena, r);
+  if (referer == NULL || *referer == '\0')
     return 1;
-  }
 
   referer = char_replace (referer, '+', ' ');
   *keyphrase = trim_str (referer);
@@ -428,28 +396,116 @@ clean:
   return 1;
 }
 
-/* Determine if the given request is static (e.g., jpg, css, js, etc).
+/* Static extensions made of a single leading dot, lowercased, and those
+ * that aren't and thus are matched one by one */
+static khash_t (si08) * static_exts = NULL;
+static const char *static_others[MAX_EXTENSIONS];
+static int static_others_idx = 0;
+static size_t static_ext_max_len = 0;
+
+/* Determine if the given extension can be looked up by the suffix that
+ * follows the last dot of a request.
  *
- * On error, or if not static, 0 is returned.
- * On success, the 1 is returned. */
+ * If it can't, 0 is returned.
+ * If it can, 1 is returned. */
 static int
-verify_static_content (const char *req) {
-  if ((req == NULL) || (*req == '\0'))
-    return 0;
+is_dot_ext (const char *ext) {
+  return ext[0] == '.' && strchr (ext + 1, '.') == NULL &&
+    strlen (ext) < STATIC_EXT_LEN;
+}
 
-  const char *nul = req + strlen (req);
-  const char *ext = NULL, *pch = NULL;
-  int elen = 0, i;
+/* Build the set of static extensions out of the configured ones. */
+void
+compile_static_files (void) {
+  char *key = NULL;
+  const char *ext = NULL;
+  khint_t k;
+  int i, j, ret;
+
+  free_static_files ();
+  static_exts = kh_init (si08);
 
   for (i = 0; i < conf.static_file_idx; ++i) {
     ext = conf.static_files[i];
     if (ext == NULL || *ext == '\0')
       continue;
 
+    if (!is_dot_ext (ext)) {
+      static_others[static_others_idx++] = ext;
+      continue;
+    }
+
+    key = xstrdup (ext);
+    for (j = 0; key[j]; ++j)
+      key[j] = tolower ((unsigned char) key[j]);
+    k = kh_put (si08, static_exts, key, &ret);
+    if (ret == 0)
+      free (key);
+    kh_val (static_exts, k) = 1;
+    if (strlen (ext) > static_ext_max_len)
+      static_ext_max_len = strlen (ext);
+  }
+}
+
+/* Free the set of static extensions. */
+void
+free_static_files (void) {
+  khint_t k;
+
+  if (static_exts) {
+    for (k = kh_begin (static_exts); k != kh_end (static_exts); ++k) {
+      if (kh_exist (static_exts, k))
+        free ((char *) kh_key (static_exts, k));
+    }
+    kh_destroy (si08, static_exts);
+  }
+
+  static_exts = NULL;
+  static_others_idx = 0;
+  static_ext_max_len = 0;
+}
+
+/* Determine if the part of a request that goes from start to end ends
+ * with a static extension, one that is at least minlen long and isn't
+ * the whole part.
+ *
+ * If not static, 0 is returned.
+ * If static, 1 is returned. */
+static int
+has_static_ext (const char *start, const char *end, size_t minlen) {
+  char key[STATIC_EXT_LEN];
+  const char *dot = end;
+  size_t len = 0, i;
+
+  while (dot > start && *--dot != '.' && (size_t) (end - dot) <= static_ext_max_len);
+  if (*dot != '.' || dot == start)
+    return 0;
+
+  if ((len = end - dot) > static_ext_max_len || len < minlen)
+    return 0;
+
+  for (i = 0; i < len; ++i)
+    key[i] = tolower ((unsigned char) dot[i]);
+  key[len] = '\0';
+
+  return kh_get (si08, static_exts, key) != kh_end (static_exts);
+}
+
+/* Determine if the given request ends with one of the extensions that
+ * aren't in the set, the same way each one was always matched.
+ *
+ * If not static, 0 is returned.
+ * If static, 1 is returned. */
+static int
+has_other_static_ext (const char *req, const char *nul, const char *qmark) {
+  const char *ext = NULL;
+  int elen = 0, i;
+
+  for (i = 0; i < static_others_idx; ++i) {
+    ext = static_others[i];
     elen = strlen (ext);
-    if (conf.all_static_files && (pch = strchr (req, '?')) != NULL && pch - req > elen) {
-      pch -= elen;
-      if (0 == strncasecmp (ext, pch, elen))
+    if (qmark != NULL && qmark - req > elen) {
+      if (0 == strncasecmp (ext, qmark - elen, elen))
         return 1;
       continue;
     }
@@ -461,6 +517,156 @@ verify_static_content (const char *req) {
   return 0;
 }
 
+/* Determine if the given request is static (e.g., jpg, css, js, etc).
+ *
+ * On error, or if not static, 0 is returned.
+ * On success, the 1 is returned. */
+static int
+verify_static_content (const char *req) {
+  const char *nul = NULL, *qmark = NULL;
+
+  if ((req == NULL) || (*req == '\0') || static_exts == NULL)
+    return 0;
+
+  nul = req + strlen (req);
+  if (conf.all_static_files)
+    qmark = strchr (req, '?');
+
+  if (static_others_idx && has_other_static_ext (req, nul, qmark))
+    return 1;
+
+  if (qmark == NULL)
+    return has_static_ext (req, nul, 0);
+
+  /* the extension right before the query string, while extensions at
+   * least as long as what precedes it are matched at the end */
+  return has_static_ext (req, qmark, 0) || has_static_ext (req, nul, qmark - req);
+}
+
+/* The --prefilter expressions, a line has to match all of them */
+static GPrefilter prefilters[MAX_PREFILTERS];
+static int prefilters_len = 0;
+
+/* Compile the --prefilter expressions so raw lines are matched against
+ * them before being parsed.
+ *
+ * On error, i.e., an invalid $N=value, a fatal error is thrown. */
+void
+compile_prefilters (void) {
+  GPrefilter *pf = NULL;
+  const char *expr = NULL;
+  char *end = NULL;
+  long field = 0;
+  int i;
+
+  prefilters_len = 0;
+  for (i = 0; i < conf.prefilter_idx; ++i) {
+    expr = conf.prefilters[i];
+    pf = &prefilters[prefilters_len];
+    memset (pf, 0, sizeof (*pf));
+
+    switch (*expr) {
+    case '^':
+      pf->type = PREFILTER_PREFIX;
+      pf->needle = expr + 1;
+      break;
+    case '$':
+      field = strtol (expr + 1, &end, 10);
+      if (end == expr + 1 || *end != '=' || field < 1 || field > INT_MAX)
+        FATAL ("Invalid prefilter %s, expected $N=value", expr);
+      pf->type = PREFILTER_FIELD;
+      pf->field = field;
+      pf->needle = end + 1;
+      break;
+    /* escaped, e.g., \^text for a literal ^text */
+    case '\\':
+      pf->type = PREFILTER_SUBSTR;
+      pf->needle = expr + 1;
+      break;
+    default:
+      pf->type = PREFILTER_SUBSTR;
+      pf->needle = expr;
+    }
+    pf->len = strlen (pf->needle);
+
+    if (pf->type == PREFILTER_FIELD && pf->len && pf->needle[pf->len - 1] == '*') {
+      pf->prefix = 1;
+      pf->len--;
+    }
+    /* an empty text matches every line */
+    if (pf->len == 0 && pf->type != PREFILTER_FIELD)
+      continue;
+    prefilters_len++;
+  }
+}
+
+/* Determine if the Nth field of the given raw line matches the
+ * prefilter. Fields are split on spaces and tabs, so a quoted request
+ * spans a few of them.
+ *
+ * If it doesn't match, 0 is returned.
+ * If it matches, 1 is returned. */
+static int
+match_prefilter_field (const char *line, const char *end, const GPrefilter * pf) {
+  const char *tkn = NULL;
+  size_t len = 0;
+  int n = 0;
+
+  while (line < end) {
+    while (line < end && (*line == ' ' || *line == '\t'))
+      line++;
+    if (line == end)
+      break;
+
+    tkn = line;
+    while (line < end && *line != ' ' && *line != '\t')
+      line++;
+    if (++n < pf->field)
+      continue;
+
+    len = line - tkn;
+    if (pf->prefix ? len < pf->len : len != pf->len)
+      return 0;
+    return memcmp (tkn, pf->needle, pf->len) == 0;
+  }
+
+  return 0;
+}
+
+/* Determine if the given raw, null-terminated, line of len bytes
+ * matches all the --prefilter expressions, i.e., it has to be parsed.
+ *
+ * If it doesn't, 0 is returned.
+ * If it does, or there are no prefilters, 1 is returned. */
+static int
+prefilter_line (const char *line, size_t len) {
+  const GPrefilter *pf = NULL;
+  int i;
+
+  while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+    len--;
+
+  for (i = 0; i < prefilters_len; ++i) {
+    pf = &prefilters[i];
+    switch (pf->type) {
+    case PREFILTER_SUBSTR:
+      if (strstr (line, pf->needle) == NULL)
+        return 0;
+      break;
+    case PREFILTER_PREFIX:
+      if (len < pf->len || memcmp (line, pf->needle, pf->len) != 0)
+        return 0;
+      break;
+    case PREFILTER_FIELD:
+      if (!match_prefilter_field (line, line + len, pf))
+        return 0;
+      break;
+    }
+  }
+
+  return 1;
+}
+
 /* Extract the HTTP method.
  *
  * On error, or if not found, NULL is returned.
@@ -476,14 +682,6 @@ extract_method (const char *token) {
   return NULL;
 }
 
-/* Determine if time-served data was stored on-disk. */
-static void
-contains_usecs (void) {
-  if (conf.serve_usecs)
-    return;
-  conf.serve_usecs = 1; /* flag */
-}
-
 static int
 is_cache_hit (const char *tkn) {
   if (strcasecmp ("MISS", tkn) == 0)
@@ -524,7 +722,7 @@ extract_protocol (const char *token) {
  * On success, the HTTP request is returned and the method and
  * protocol are assigned to the corresponding buffers. */
 static char *
-parse_req (char *line, char **method, char **protocol) {
+parse_req (GArena * arena, char *line, char **method, char **protocol) {
   char *req = NULL, *request = NULL, *dreq = NULL, *ptr = NULL;
   const char *meth, *proto;
   ptrdiff_t rlen;
@@ -533,43 +731,36 @@ parse_req (char *line, char **method, char **protocol) {
 
   /* couldn't find a method, so use the whole request line */
   if (meth == NULL) {
-    request = xstrdup (line);
+    request = arena_strdup (arena, line);
   }
   /* method found, attempt to parse request */
   else {
     req = line + strlen (meth);
     if (!(ptr = strrchr (req, ' ')) || !(proto = extract_protocol (++ptr)))
-      return alloc_string ("-");
+      return arena_strdup (arena, "-");
 
     req++;
     if ((rlen = ptr - req) <= 0)
-      return alloc_string ("-");
+      return arena_strdup (arena, "-");
 
-    request = xmalloc (rlen + 1);
-    strncpy (request, req, rlen);
-    request[rlen] = 0;
+    request = arena_strndup (arena, req, rlen);
 
     if (conf.append_method)
-      (*method) = strtoupper (xstrdup (meth));
+      (*method) = strtoupper (arena_strdup (arena, meth));
 
     if (conf.append_protocol)
-      (*protocol) = strtoupper (xstrdup (proto));
+      (*protocol) = strtoupper (arena_strdup (arena, proto));
   }
 
-  if (!(dreq = decode_url (request)))
-    return request;
-  else if (*dreq == '\0') {
-    free (dreq);
+  if (!(dreq = decode_url (arena, request)) || *dreq == '\0')
     return request;
-  }
 
-  free (request);
   return dreq;
 }
 
 #if defined(HAVE_LIBSSL) && defined(HAVE_CIPHER_STD_NAME)
 static int
-extract_tls_version_cipher (char *tkn, char **cipher, char **tls_version) {
+extract_tls_version_cipher (GArena * arena, char *tkn, char **cipher, char **tls_version) {
   SSL_CTX *ctx = NULL;
   SSL *ssl = NULL;
   int code = 0;
@@ -608,17 +799,15 @@ extract_tls_version_cipher (char *tkn, char **cipher, char **tls_version) {
     LOG_DEBUG (("Unable to get cipher standard name to extact TLS."));
     goto fail;
   }
-  *cipher = xstrdup (sn);
-  *tls_version = xstrdup (SSL_CIPHER_get_version (c));
+  *cipher = arena_strdup (arena, sn);
+  *tls_version = arena_strdup (arena, SSL_CIPHER_get_version (c));
 
-  free (tkn);
   SSL_free (ssl);
   SSL_CTX_free (ctx);
 
   return 0;
 
 fail:
-  free (tkn);
   if (ssl)
     SSL_free (ssl);
   if (ctx)
@@ -643,21 +832,87 @@ get_delim (char *dest, const char *p) {
   dest[0] = *(p + 1);
 }
 
-/* Extract and malloc a token given the parsed rule.
+/* The ingest plan, everything is parsed until it's compiled */
+static GIngestPlan ingest_plan = {
+  .specs = {[0 ... UCHAR_MAX] = 1},
+  .keyphrase = 1,
+  .ref_site = 1,
+  .browsers = 1,
+  .os = 1,
+};
+
+/* Extract and malloc a token given the parsed rule. The token is
+ * allocated off the given arena, if any.
  *
  * On success, the malloc'd token is returned. */
 static char *
-parsed_string (const char *pch, char **str, int move_ptr) {
+parsed_string (GArena * arena, const char *pch, char **str, int move_ptr) {
+  const char *start = *str, *end = pch;
   char *p;
-  size_t len = (pch - *str + 1);
+  size_t len;
+
+  /* trim the token before copying it rather than the copy */
+  while (start < end && isspace (*start))
+    start++;
+  while (end > start && isspace (*(end - 1)))
+    end--;
 
-  p = xmalloc (len);
-  memcpy (p, *str, (len - 1));
-  p[len - 1] = '\0';
+  len = end - start;
+  p = arena ? arena_alloc (arena, len + 1) : xmalloc (len + 1);
+  memcpy (p, start, len);
+  p[len] = '\0';
   if (move_ptr)
-    *str += len - 1;
+    *str += pch - *str;
+
+  return p;
+}
+
+/* Find the end of a token given a log format rule.
+ *
+ * On error, or unable to find it, NULL is returned.
+ * On success, a pointer to the delimiter ending the token is returned. */
+static const char *
+scan_string (const char *str, const char *delims, int cnt) {
+  const char *pch = str, *p = NULL;
+  char end = *delims;
+  int idx = 0, found = 0;
+
+  /* out of a set of delims, the first one within the string is used */
+  if (end != 0x0 && delims[1] != 0x0) {
+    if ((p = strpbrk (str, delims)) == NULL)
+      return NULL;
+    end = *p;
+    found = 1;
+  }
+
+  while (1) {
+    /* jump to the next delim, escape char or end of string */
+    pch = scan_delim (pch, end, '\\');
+
+    /* match number of delims, parse string then */
+    if (end != 0x0 && *pch == end) {
+      found = 1;
+      if (++idx == cnt)
+        return pch;
+      if (end != '\\') {
+        pch++;
+        continue;
+      }
+    }
+
+    /* a delim has to be found anywhere within the string */
+    if (*pch == '\0')
+      return found || end == 0x0 ? pch : NULL;
 
-  return trim_str (p);
+    /* advance past the escaped char */
+    if (*++pch == '\0')
+      return NULL;
+    if (*pch == end)
+      found = 1;
+    pch++;
+  }
+
+  return NULL;
 }
 
 /* Find and extract a token given a log format rule.
@@ -665,33 +920,17 @@ parsed_string (const char *pch, char **str, int move_ptr) {
  * On error, or unable to parse it, NULL is returned.
  * On success, the malloc'd token is returned. */
 static char *
-parse_string (char **str, const char *delims, int cnt) {
-  int idx = 0;
-  char *pch = *str, *p = NULL;
-  char end;
+parse_string (GArena * arena, char **str, const char *delims, int cnt) {
+  const char *pch = NULL;
 
-  if ((*delims != 0x0) && (p = strpbrk (*str, delims)) == NULL)
+  if ((pch = scan_string (*str, delims, cnt)) == NULL)
     return NULL;
-
-  end = !*delims ? 0x0 : *p;
-  do {
-    /* match number of delims */
-    if (*pch == end)
-      idx++;
-    /* delim found, parse string then */
-    if ((*pch == end && cnt == idx) || *pch == '\0')
-      return parsed_string (pch, str, 1);
-    /* advance to the first unescaped delim */
-    if (*pch == '\\')
-      pch++;
-  } while (*pch++);
-
-  return NULL;
+  return parsed_string (arena, pch, str, 1);
 }
 
 char *
 extract_by_delim (char **str, const char *end) {
-  return parse_string (&(*str), end, 1);
+  return parse_string (NULL, &(*str), end, 1);
 }
 
 /* Move forward through the log string until a non-space (!isspace)
@@ -723,39 +962,7 @@ find_alpha_count (char *str) {
   return cnt;
 }
 
-/* Format the broken-down time tm to a numeric date format.
- *
- * On error, or unable to format the given tm, 1 is returned.
- * On success, a malloc'd format is returned. */
 #pragma GCC diagnostic ignored "-Wformat-nonliteral"
-static int
-set_date (char **fdate, struct tm tm) {
-  char buf[DATE_LEN] = "";      /* Ymd */
-
-  memset (buf, 0, sizeof (buf));
-  if (strftime (buf, DATE_LEN, conf.date_num_format, &tm) <= 0)
-    return 1;
-  *fdate = xstrdup (buf);
-
-  return 0;
-}
-
-/* Format the broken-down time tm to a numeric time format.
- *
- * On error, or unable to format the given tm, 1 is returned.
- * On success, a malloc'd format is returned. */
-static int
-set_time (char **ftime, struct tm tm) {
-  char buf[TIME_LEN] = "";
-
-  memset (buf, 0, sizeof (buf));
-  if (strftime (buf, TIME_LEN, "%H:%M:%S", &tm) <= 0)
-    return 1;
-  *ftime = xstrdup (buf);
-
-  return 0;
-}
-
 /* Determine the parsing specifier error and construct a message out
  * of it.
  *
@@ -769,17 +976,17 @@ spec_err (GLogItem * logitem, int code, const char spec, const char *tkn) {
   switch (code) {
   case SPEC_TOKN_NUL:
     fmt = "Token for '%%%c' specifier is NULL.";
-    err = xmalloc (snprintf (NULL, 0, fmt, spec) + 1);
+    err = arena_alloc (logitem->arena, snprintf (NULL, 0, fmt, spec) + 1);
     sprintf (err, fmt, spec);
     break;
   case SPEC_TOKN_INV:
     fmt = "Token '%s' doesn't match specifier '%%%c'";
-    err = xmalloc (snprintf (NULL, 0, fmt, (tkn ? tkn : "-"), spec) + 1);
+    err = arena_alloc (logitem->arena, snprintf (NULL, 0, fmt, (tkn ? tkn : "-"), spec) + 1);
     sprintf (err, fmt, (tkn ? tkn : "-"), spec);
     break;
   case SPEC_SFMT_MIS:
     fmt = "Missing braces '%s' and ignore chars for specifier '%%%c'";
-    err = xmalloc (snprintf (NULL, 0, fmt, (tkn ? tkn : "-"), spec) + 1);
+    err = arena_alloc (logitem->arena, snprintf (NULL, 0, fmt, (tkn ? tkn : "-"), spec) + 1);
     sprintf (err, fmt, (tkn ? tkn : "-"), spec);
     break;
   }
@@ -813,225 +1020,558 @@ set_numeric_date (uint32_t * numdate, const char *date) {
 static void
 set_agent_hash (GLogItem * logitem) {
   logitem->agent_hash = djb2 ((unsigned char *) logitem->agent);
-  sprintf (logitem->agent_hex, "%" PRIx32, logitem->agent_hash);
 }
 
-#pragma GCC diagnostic warning "-Wformat-nonliteral"
+/* Kind of the date and time formats, set by compile_log_format() */
+static GDateFmtType date_fmt_type = DT_FMT_OTHER;
+static GDateFmtType time_fmt_type = DT_FMT_OTHER;
+static int date_num_ymd = 0;    /* numeric date format is %Y%m%d */
 
-/* Parse the log string given log format rule.
+/* Format the broken-down time tm to the numeric date format into the
+ * given buffer of DATE_LEN and set its integer value. The usual %Y%m%d
+ * is computed directly.
  *
- * On error, or unable to parse it, 1 is returned.
- * On success, the malloc'd token is assigned to a GLogItem member. */
+ * On error, or unable to format the given tm, 1 is returned.
+ * On success, 0 is returned. */
 static int
-parse_specifier (GLogItem * logitem, char **str, const char *p, const char *end) {
-  struct tm tm;
-  time_t now = time (0);
-  const char *dfmt = conf.date_format;
-  const char *tfmt = conf.time_format;
+set_date (char *buf, uint32_t * numdate, const struct tm *tm) {
+  int year = tm->tm_year + 1900;
 
-  char *pch, *sEnd, *bEnd, *tkn = NULL;
-  double serve_secs = 0.0;
-  uint64_t bandw = 0, serve_time = 0;
-  long status = 0L;
-  int dspc = 0, fmtspcs = 0;
+  if (date_num_ymd && year >= 1000 && year <= 9999 && tm->tm_mon >= 0 &&
+      tm->tm_mon <= 11 && tm->tm_mday >= 1 && tm->tm_mday <= 31) {
+    *numdate = year * 10000 + (tm->tm_mon + 1) * 100 + tm->tm_mday;
+    sprintf (buf, "%" PRIu32, *numdate);
+    return 0;
+  }
 
-  errno = 0;
-  memset (&tm, 0, sizeof (tm));
-  localtime_r (&now, &tm);
+  if (strftime (buf, DATE_LEN, conf.date_num_format, tm) <= 0)
+    return 1;
+  set_numeric_date (numdate, buf);
 
-  switch (*p) {
-    /* date */
-  case 'd':
-    if (logitem->date)
-      return 0;
+  return 0;
+}
 
-    /* Attempt to parse date format containing spaces,
-     * i.e., syslog date format (Jul\s15, Nov\s\s2).
-     * Note that it's possible a date could contain some padding, e.g.,
-     * Dec\s\s2 vs Nov\s22, so we attempt to take that into consideration by looking
-     * ahead the log string and counting the # of spaces until we find an alphanum char. */
-    if ((fmtspcs = count_matches (dfmt, ' ')) && (pch = strchr (*str, ' ')))
-      dspc = find_alpha_count (pch);
+#pragma GCC diagnostic warning "-Wformat-nonliteral"
 
-    if (!(tkn = parse_string (&(*str), end, MAX (dspc, fmtspcs) + 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+/* Format the broken-down time tm to a numeric time format into the
+ * given buffer of TIME_LEN.
+ *
+ * On error, or unable to format the given tm, 1 is returned.
+ * On success, 0 is returned. */
+static int
+set_time (char *buf, const struct tm *tm) {
+  if (strftime (buf, TIME_LEN, "%H:%M:%S", tm) <= 0)
+    return 1;
+  return 0;
+}
 
-    if (str_to_time (tkn, dfmt, &tm) != 0 || set_date (&logitem->date, tm) != 0) {
-      spec_err (logitem, SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
-      return 1;
-    }
+/* Determine the kind of the given date/time format.
+ *
+ * On success, the GDateFmtType of the format is returned. */
+static GDateFmtType
+get_date_fmt_type (const char *fmt) {
+  if (fmt == NULL)
+    return DT_FMT_OTHER;
+  if (!strcmp (fmt, "%d/%b/%Y"))
+    return DT_FMT_DMY;
+  if (!strcmp (fmt, "%Y-%m-%d"))
+    return DT_FMT_YMD;
+  if (!strcmp (fmt, "%T") || !strcmp (fmt, "%H:%M:%S"))
+    return DT_FMT_HMS;
+  if (!strcmp (fmt, "%s"))
+    return DT_FMT_SECS;
+  if (!strcmp (fmt, "%*"))
+    return DT_FMT_MSECS;
+  if (!strcmp (fmt, "%f"))
+    return DT_FMT_USECS;
+  return DT_FMT_OTHER;
+}
+
+/* Convert exactly len digits of the given string to an int.
+ *
+ * On error, i.e., a non-digit char, -1 is returned.
+ * On success, the value is returned. */
+static int
+parse_digits (const char *str, int len) {
+  int val = 0;
 
-    set_numeric_date (&logitem->numdate, logitem->date);
-    set_tm_dt_logitem (logitem, tm);
-    free (tkn);
-    break;
-    /* time */
-  case 't':
-    if (logitem->time)
-      return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+  while (len--) {
+    if (*str < '0' || *str > '9')
+      return -1;
+    val = val * 10 + (*str++ - '0');
+  }
 
-    if (str_to_time (tkn, tfmt, &tm) != 0 || set_time (&logitem->time, tm) != 0) {
-      spec_err (logitem, SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
-      return 1;
-    }
+  return val;
+}
 
-    set_tm_tm_logitem (logitem, tm);
-    free (tkn);
-    break;
-    /* date/time as decimal, i.e., timestamps, ms/us  */
-  case 'x':
-    if (logitem->time && logitem->date)
-      return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+/* Get the month out of an English month abbreviation, as found in most
+ * logs. Anything else, e.g., a localized name, goes through strptime(3).
+ *
+ * On error, -1 is returned.
+ * On success, the month (0-11) is returned. */
+static int
+parse_month_abbr (const char *str) {
+  static const char *const months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  int i;
 
-    if (str_to_time (tkn, tfmt, &tm) != 0 || set_date (&logitem->date, tm) != 0 ||
-        set_time (&logitem->time, tm) != 0) {
-      spec_err (logitem, SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
-      return 1;
-    }
-    set_numeric_date (&logitem->numdate, logitem->date);
-    set_tm_dt_logitem (logitem, tm);
-    set_tm_tm_logitem (logitem, tm);
-    free (tkn);
-    break;
-    /* Virtual Host */
-  case 'v':
-    if (logitem->vhost)
-      return 0;
-    tkn = parse_string (&(*str), end, 1);
-    if (tkn == NULL)
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
-    logitem->vhost = tkn;
-    break;
-    /* remote user */
-  case 'e':
-    if (logitem->userid)
-      return 0;
-    tkn = parse_string (&(*str), end, 1);
-    if (tkn == NULL)
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
-    logitem->userid = tkn;
-    break;
-    /* cache status */
-  case 'C':
-    if (logitem->cache_status)
-      return 0;
-    tkn = parse_string (&(*str), end, 1);
-    if (tkn == NULL)
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
-    if (is_cache_hit (tkn))
-      logitem->cache_status = tkn;
-    else
-      free (tkn);
-    break;
-    /* remote hostname (IP only) */
-  case 'h':
-    if (logitem->host)
-      return 0;
-    /* per https://datatracker.ietf.org/doc/html/rfc3986#section-3.2.2 */
-    /* square brackets are possible */
-    if (*str[0] == '[' && (*str += 1) && **str)
-      end = "]";
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+  for (i = 0; i < 12; ++i) {
+    if (!memcmp (months + i * 3, str, 3))
+      return i;
+  }
 
-    if (!conf.no_ip_validation && invalid_ipaddr (tkn, &logitem->type_ip)) {
-      spec_err (logitem, SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
-      return 1;
+  return -1;
+}
+
+/* Parse a %d/%b/%Y date such as 10/Oct/2000.
+ *
+ * On error, 1 is returned.
+ * On success, the date is set into tm and 0 is returned. */
+static int
+parse_dmy (const char *str, struct tm *tm) {
+  int mday, mon, year;
+
+  if (strlen (str) != 11 || str[2] != '/' || str[6] != '/')
+    return 1;
+  if ((mday = parse_digits (str, 2)) < 1 || mday > 31)
+    return 1;
+  if ((mon = parse_month_abbr (str + 3)) == -1)
+    return 1;
+  if ((year = parse_digits (str + 7, 4)) == -1)
+    return 1;
+
+  tm->tm_mday = mday;
+  tm->tm_mon = mon;
+  tm->tm_year = year - 1900;
+
+  return 0;
+}
+
+/* Parse a %Y-%m-%d date such as 2000-10-10.
+ *
+ * On error, 1 is returned.
+ * On success, the date is set into tm and 0 is returned. */
+static int
+parse_ymd (const char *str, struct tm *tm) {
+  int mday, mon, year;
+
+  if (strlen (str) != 10 || str[4] != '-' || str[7] != '-')
+    return 1;
+  if ((year = parse_digits (str, 4)) == -1)
+    return 1;
+  if ((mon = parse_digits (str + 5, 2)) < 1 || mon > 12)
+    return 1;
+  if ((mday = parse_digits (str + 8, 2)) < 1 || mday > 31)
+    return 1;
+
+  tm->tm_mday = mday;
+  tm->tm_mon = mon - 1;
+  tm->tm_year = year - 1900;
+
+  return 0;
+}
+
+/* Parse a %H:%M:%S time such as 13:55:36.
+ *
+ * On error, 1 is returned.
+ * On success, the time is set into tm and 0 is returned. */
+static int
+parse_hms (const char *str, struct tm *tm) {
+  int hour, min, sec;
+
+  if (strlen (str) != 8 || str[2] != ':' || str[5] != ':')
+    return 1;
+  if ((hour = parse_digits (str, 2)) == -1 || hour > 23)
+    return 1;
+  if ((min = parse_digits (str + 3, 2)) == -1 || min > 59)
+    return 1;
+  if ((sec = parse_digits (str + 6, 2)) == -1 || sec > 59)
+    return 1;
+
+  tm->tm_hour = hour;
+  tm->tm_min = min;
+  tm->tm_sec = sec;
+
+  return 0;
+}
+
+/* Parse an epoch in seconds, milliseconds or microseconds and break it
+ * down into the local time. Timestamps within the same minute share a
+ * single localtime_r(3) call.
+ *
+ * On error, 1 is returned.
+ * On success, the local time is set into tm and 0 is returned. */
+static int
+parse_epoch (GDateCache * dc, const char *str, uint64_t div, struct tm *tm) {
+  uint64_t ts = 0;
+  time_t secs, min;
+  int len = 0;
+
+  for (; str[len] >= '0' && str[len] <= '9'; ++len)
+    ts = ts * 10 + (str[len] - '0');
+  /* leave signs, blanks and anything overly long to strtoull(3) */
+  if (len == 0 || len > 18 || str[len] != '\0')
+    return 1;
+
+  secs = ts / div;
+  min = secs - secs % 60;
+  if (!dc->has_emin || dc->emin != min) {
+    if (localtime_r (&min, &dc->etm) == NULL) {
+      dc->has_emin = 0;
+      return 1;
     }
+    dc->emin = min;
+    dc->has_emin = 1;
+  }
+
+  /* local time offsets are whole minutes, otherwise break it down */
+  *tm = dc->etm;
+  if ((tm->tm_sec += secs - min) > 59 && localtime_r (&secs, tm) == NULL)
+    return 1;
+
+  return 0;
+}
+
+/* Convert the given date/time token using the hand-written parser of
+ * the format's kind, falling back to str_to_time() for anything else.
+ *
+ * On error, 1 is returned.
+ * On success, the broken-down time is set into tm and 0 is returned. */
+static int
+parse_date_time (GDateCache * dc, const char *str, const char *fmt, GDateFmtType type,
+                 struct tm *tm) {
+  int ret = 1;
+
+  switch (type) {
+  case DT_FMT_DMY:
+    ret = parse_dmy (str, tm);
+    break;
+  case DT_FMT_YMD:
+    ret = parse_ymd (str, tm);
+    break;
+  case DT_FMT_HMS:
+    ret = parse_hms (str, tm);
+    break;
+  case DT_FMT_SECS:
+    ret = parse_epoch (dc, str, 1, tm);
+    break;
+  case DT_FMT_MSECS:
+    ret = parse_epoch (dc, str, MILS, tm);
+    break;
+  case DT_FMT_USECS:
+    ret = parse_epoch (dc, str, SECS, tm);
+    break;
+  default:
+    break;
+  }
+
+  return ret == 0 ? 0 : str_to_time (str, fmt, tm);
+}
+
+/* Keep the given token as the key of a cached date/time. Overly long
+ * tokens are simply not cached. */
+static void
+cache_date_tkn (GDateTkn * dtkn, const char *tkn) {
+  size_t len = strlen (tkn);
+
+  if (len < sizeof (dtkn->tkn))
+    memcpy (dtkn->tkn, tkn, len + 1);
+}
+
+/* Determine if the given token is the key of a cached date/time.
+ *
+ * If not cached, its key is dropped so it can be refilled and 0 is
+ * returned.
+ * If cached, 1 is returned. */
+static int
+is_cached_date_tkn (GDateTkn * dtkn, const char *tkn) {
+  if (dtkn->tkn[0] != '\0' && !strcmp (dtkn->tkn, tkn))
+    return 1;
+  dtkn->tkn[0] = '\0';
+  return 0;
+}
+
+/* Set the date of the given log item out of a %d token.
+ *
+ * On error, or unable to parse it, 1 is returned.
+ * On success, 0 is returned. */
+static int
+set_date_tkn (GLogItem * logitem, const char *tkn) {
+  GDateCache *dc = logitem->dcache;
+  GDateTkn *dtkn = &dc->date;
+
+  if (!is_cached_date_tkn (dtkn, tkn)) {
+    dtkn->tm = dc->tm_now;
+    if (parse_date_time (dc, tkn, conf.date_format, date_fmt_type, &dtkn->tm) != 0 ||
+        set_date (dtkn->date, &dtkn->numdate, &dtkn->tm) != 0)
+      return 1;
+    cache_date_tkn (dtkn, tkn);
+  }
+
+  logitem->date = arena_strdup (logitem->arena, dtkn->date);
+  logitem->numdate = dtkn->numdate;
+  set_tm_dt_logitem (logitem, dtkn->tm);
+
+  return 0;
+}
+
+/* Set the time of the given log item out of a %t token.
+ *
+ * On error, or unable to parse it, 1 is returned.
+ * On success, 0 is returned. */
+static int
+set_time_tkn (GLogItem * logitem, const char *tkn) {
+  GDateCache *dc = logitem->dcache;
+  GDateTkn *dtkn = &dc->time;
+
+  if (!is_cached_date_tkn (dtkn, tkn)) {
+    dtkn->tm = dc->tm_now;
+    if (parse_date_time (dc, tkn, conf.time_format, time_fmt_type, &dtkn->tm) != 0 ||
+        set_time (dtkn->time, &dtkn->tm) != 0)
+      return 1;
+    cache_date_tkn (dtkn, tkn);
+  }
+
+  logitem->time = arena_strdup (logitem->arena, dtkn->time);
+  set_tm_tm_logitem (logitem, dtkn->tm);
+
+  return 0;
+}
+
+/* Set both the date and time of the given log item out of a %x token.
+ *
+ * On error, or unable to parse it, 1 is returned.
+ * On success, 0 is returned. */
+static int
+set_tstamp_tkn (GLogItem * logitem, const char *tkn) {
+  GDateCache *dc = logitem->dcache;
+  GDateTkn *dtkn = &dc->tstamp;
+
+  if (!is_cached_date_tkn (dtkn, tkn)) {
+    dtkn->tm = dc->tm_now;
+    if (parse_date_time (dc, tkn, conf.time_format, time_fmt_type, &dtkn->tm) != 0 ||
+        set_date (dtkn->date, &dtkn->numdate, &dtkn->tm) != 0 ||
+        set_time (dtkn->time, &dtkn->tm) != 0)
+      return 1;
+    cache_date_tkn (dtkn, tkn);
+  }
+
+  logitem->date = arena_strdup (logitem->arena, dtkn->date);
+  logitem->time = arena_strdup (logitem->arena, dtkn->time);
+  logitem->numdate = dtkn->numdate;
+  set_tm_dt_logitem (logitem, dtkn->tm);
+  set_tm_tm_logitem (logitem, dtkn->tm);
+
+  return 0;
+}
+
+/* Convert the broken-down local time of a log item into an epoch. A
+ * single mktime(3) call is made per minute and tm_isdst hint, the
+ * seconds are added to it.
+ *
+ * On error, -1 is returned.
+ * On success, the epoch is returned. */
+static time_t
+cached_mktime (GDateCache * dc, const struct tm *tm) {
+  struct tm *mtm = &dc->mtm;
+  struct tm min;
+
+  if (!dc->has_mmin || mtm->tm_min != tm->tm_min || mtm->tm_hour != tm->tm_hour ||
+      mtm->tm_mday != tm->tm_mday || mtm->tm_mon != tm->tm_mon ||
+      mtm->tm_year != tm->tm_year || mtm->tm_isdst != tm->tm_isdst) {
+    *mtm = min = *tm;
+    min.tm_sec = 0;
+    dc->mmin = mktime (&min);
+    dc->has_mmin = 1;
+  }
+
+  if (dc->mmin == -1)
+    return -1;
+  return dc->mmin + tm->tm_sec;
+}
+
+
+/* Read past the token of a specifier that isn't part of the ingest
+ * plan, failing the same way parsing it would.
+ *
+ * On error, 1 is returned.
+ * On success, 0 is returned. */
+static int
+skip_specifier (GLogItem * logitem, char **str, const GLogFmtOp * op) {
+  const char *pch = NULL;
+
+  /* a missing referrer is just "-" */
+  if ((pch = scan_string (*str, op->end, 1)) == NULL)
+    return op->spec == 'R' ? 0 : spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
+  *str += pch - *str;
+
+  return 0;
+}
+
+/* Parse the log string given log format rule.
+ *
+ * On error, or unable to parse it, 1 is returned.
+ * On success, the malloc'd token is assigned to a GLogItem member. */
+static int
+parse_specifier (GLogItem * logitem, char **str, const GLogFmtOp * op) {
+  const char *end = op->end;
+
+  char *pch, *sEnd, *bEnd, *tkn = NULL;
+  double serve_secs = 0.0;
+  uint64_t bandw = 0, serve_time = 0;
+  long status = 0L;
+  int dspc = 0, fmtspcs = 0;
+
+  if (!ingest_plan.specs[(unsigned char) op->spec])
+    return skip_specifier (logitem, str, op);
+
+  errno = 0;
+
+  switch (op->spec) {
+    /* date */
+  case 'd':
+    if (logitem->date)
+      return 0;
+
+    /* Attempt to parse date format containing spaces,
+     * i.e., syslog date format (Jul\s15, Nov\s\s2).
+     * Note that it's possible a date could contain some padding, e.g.,
+     * Dec\s\s2 vs Nov\s22, so we attempt to take that into consideration by looking
+     * ahead the log string and counting the # of spaces until we find an alphanum char. */
+    if ((fmtspcs = op->fmtspcs) && (pch = strchr (*str, ' ')))
+      dspc = find_alpha_count (pch);
+
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, MAX (dspc, fmtspcs) + 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
+
+    if (set_date_tkn (logitem, tkn) != 0)
+      return spec_err (logitem, SPEC_TOKN_INV, op->spec, tkn);
+    break;
+    /* time */
+  case 't':
+    if (logitem->time)
+      return 0;
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
+
+    if (set_time_tkn (logitem, tkn) != 0)
+      return spec_err (logitem, SPEC_TOKN_INV, op->spec, tkn);
+    break;
+    /* date/time as decimal, i.e., timestamps, ms/us  */
+  case 'x':
+    if (logitem->time && logitem->date)
+      return 0;
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
+
+    if (set_tstamp_tkn (logitem, tkn) != 0)
+      return spec_err (logitem, SPEC_TOKN_INV, op->spec, tkn);
+    break;
+    /* Virtual Host */
+  case 'v':
+    if (logitem->vhost)
+      return 0;
+    tkn = parse_string (logitem->arena, &(*str), end, 1);
+    if (tkn == NULL)
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
+    logitem->vhost = tkn;
+    break;
+    /* remote user */
+  case 'e':
+    if (logitem->userid)
+      return 0;
+    tkn = parse_string (logitem->arena, &(*str), end, 1);
+    if (tkn == NULL)
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
+    logitem->userid = tkn;
+    break;
+    /* cache status */
+  case 'C':
+    if (logitem->cache_status)
+      return 0;
+    tkn = parse_string (logitem->arena, &(*str), end, 1);
+    if (tkn == NULL)
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
+    if (is_cache_hit (tkn))
+      logitem->cache_status = tkn;
+    break;
+    /* remote hostname (IP only) */
+  case 'h':
+    if (logitem->host)
+      return 0;
+    /* per https://datatracker.ietf.org/doc/html/rfc3986#section-3.2.2 */
+    /* square brackets are possible */
+    if (*str[0] == '[' && (*str += 1) && **str)
+      end = "]";
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
+
+    if (!conf.no_ip_validation && invalid_ipaddr (tkn, &logitem->type_ip))
+      return spec_err (logitem, SPEC_TOKN_INV, op->spec, tkn);
     logitem->host = tkn;
     break;
     /* request method */
   case 'm':
     if (logitem->method)
       return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
     {
       const char *meth = NULL;
-      if (!(meth = extract_method (tkn))) {
-        spec_err (logitem, SPEC_TOKN_INV, *p, tkn);
-        free (tkn);
-        return 1;
-      }
-      logitem->method = xstrdup (meth);
-      free (tkn);
+      if (!(meth = extract_method (tkn)))
+        return spec_err (logitem, SPEC_TOKN_INV, op->spec, tkn);
+      logitem->method = arena_strdup (logitem->arena, meth);
     }
     break;
     /* request not including method or protocol */
   case 'U':
     if (logitem->req)
       return 0;
-    tkn = parse_string (&(*str), end, 1);
-    if (tkn == NULL || *tkn == '\0') {
-      free (tkn);
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
-    }
+    tkn = parse_string (logitem->arena, &(*str), end, 1);
+    if (tkn == NULL || *tkn == '\0')
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
 
-    if ((logitem->req = decode_url (tkn)) == NULL) {
-      spec_err (logitem, SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
-      return 1;
-    }
-    free (tkn);
+    if ((logitem->req = decode_url (logitem->arena, tkn)) == NULL)
+      return spec_err (logitem, SPEC_TOKN_INV, op->spec, tkn);
     break;
     /* query string alone, e.g., ?param=goaccess&tbm=shop */
   case 'q':
     if (logitem->qstr)
       return 0;
-    tkn = parse_string (&(*str), end, 1);
-    if (tkn == NULL || *tkn == '\0') {
-      free (tkn);
+    tkn = parse_string (logitem->arena, &(*str), end, 1);
+    if (tkn == NULL || *tkn == '\0')
       return 0;
-    }
 
-    if ((logitem->qstr = decode_url (tkn)) == NULL) {
-      spec_err (logitem, SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
-      return 1;
-    }
-    free (tkn);
+    if ((logitem->qstr = decode_url (logitem->arena, tkn)) == NULL)
+      return spec_err (logitem, SPEC_TOKN_INV, op->spec, tkn);
     break;
     /* request protocol */
   case 'H':
     if (logitem->protocol)
       return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
     {
       const char *proto = NULL;
-      if (!(proto = extract_protocol (tkn))) {
-        spec_err (logitem, SPEC_TOKN_INV, *p, tkn);
-        free (tkn);
-        return 1;
-      }
-      logitem->protocol = xstrdup (proto);
-      free (tkn);
+      if (!(proto = extract_protocol (tkn)))
+        return spec_err (logitem, SPEC_TOKN_INV, op->spec, tkn);
+      logitem->protocol = arena_strdup (logitem->arena, proto);
     }
     break;
     /* request, including method + protocol */
   case 'r':
     if (logitem->req)
       return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
 
-    logitem->req = parse_req (tkn, &logitem->method, &logitem->protocol);
-    free (tkn);
+    logitem->req = parse_req (logitem->arena, tkn, &logitem->method, &logitem->protocol);
     break;
     /* Status Code */
   case 's':
     if (logitem->status)
       return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
 
     /* do not validate HTTP status code */
     if (conf.no_strict_status) {
@@ -1040,47 +1580,40 @@ parse_specifier (GLogItem * logitem, char **str, const char *p, const char *end)
     }
 
     status = strtol (tkn, &sEnd, 10);
-    if (tkn == sEnd || *sEnd != '\0' || errno == ERANGE || status < 100 || status > 599) {
-      spec_err (logitem, SPEC_TOKN_INV, *p, tkn);
-      free (tkn);
-      return 1;
-    }
+    if (tkn == sEnd || *sEnd != '\0' || errno == ERANGE || status < 100 || status > 599)
+      return spec_err (logitem, SPEC_TOKN_INV, op->spec, tkn);
     logitem->status = tkn;
     break;
     /* size of response in bytes - excluding HTTP headers */
   case 'b':
     if (logitem->resp_size)
       return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
 
     bandw = strtoull (tkn, &bEnd, 10);
     if (tkn == bEnd || *bEnd != '\0' || errno == ERANGE)
       bandw = 0;
     logitem->resp_size = bandw;
-    conf.bandwidth = 1;
-    free (tkn);
     break;
     /* referrer */
   case 'R':
     if (logitem->ref)
       return 0;
 
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      tkn = alloc_string ("-");
-    if (*tkn == '\0') {
-      free (tkn);
-      tkn = alloc_string ("-");
-    }
+    tkn = parse_string (logitem->arena, &(*str), end, 1);
+    if (tkn == NULL || *tkn == '\0')
+      tkn = arena_strdup (logitem->arena, "-");
     if (strcmp (tkn, "-") != 0) {
-      extract_keyphrase (tkn, &logitem->keyphrase);
-      extract_referer_site (tkn, logitem->site);
+      if (ingest_plan.keyphrase)
+        extract_keyphrase (logitem->arena, tkn, &logitem->keyphrase);
+      if (ingest_plan.ref_site)
+        extract_referer_site (tkn, logitem->site);
 
       /* hide referrers from report */
-      if (hide_referer (logitem->site)) {
+      if (hide_referer (logitem->site))
         logitem->site[0] = '\0';
-        free (tkn);
-      } else
+      else
         logitem->ref = tkn;
       break;
     }
@@ -1092,23 +1625,16 @@ parse_specifier (GLogItem * logitem, char **str, const char *p, const char *end)
     if (logitem->agent)
       return 0;
 
-    tkn = parse_string (&(*str), end, 1);
+    tkn = parse_string (logitem->arena, &(*str), end, 1);
     if (tkn != NULL && *tkn != '\0') {
       /* Make sure the user agent is decoded (i.e.: CloudFront)
        * and replace all '+' with ' ' (i.e.: w3c) */
-      logitem->agent = decode_url (tkn);
+      logitem->agent = decode_url (logitem->arena, tkn);
       set_agent_hash (logitem);
-      free (tkn);
       break;
-    } else if (tkn != NULL && *tkn == '\0') {
-      free (tkn);
-      tkn = alloc_string ("-");
     }
-    /* must be null */
-    else {
-      tkn = alloc_string ("-");
-    }
-    logitem->agent = tkn;
+    /* must be null or empty */
+    logitem->agent = arena_strdup (logitem->arena, "-");
     set_agent_hash (logitem);
     break;
     /* time taken to serve the request, in milliseconds as a decimal number */
@@ -1116,17 +1642,14 @@ parse_specifier (GLogItem * logitem, char **str, const char *p, const char *end)
     /* ignore it if we already have served time */
     if (logitem->serve_time)
       return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
 
     serve_secs = strtoull (tkn, &bEnd, 10);
     if (tkn == bEnd || *bEnd != '\0' || errno == ERANGE)
       serve_secs = 0;
     /* convert it to microseconds */
     logitem->serve_time = (serve_secs > 0) ? serve_secs * MILS : 0;
-
-    contains_usecs ();  /* set flag */
-    free (tkn);
     break;
     /* time taken to serve the request, in seconds with a milliseconds
      * resolution */
@@ -1134,8 +1657,8 @@ parse_specifier (GLogItem * logitem, char **str, const char *p, const char *end)
     /* ignore it if we already have served time */
     if (logitem->serve_time)
       return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
 
     if (strchr (tkn, '.') != NULL)
       serve_secs = strtod (tkn, &bEnd);
@@ -1146,25 +1669,19 @@ parse_specifier (GLogItem * logitem, char **str, const char *p, const char *end)
       serve_secs = 0;
     /* convert it to microseconds */
     logitem->serve_time = (serve_secs > 0) ? serve_secs * SECS : 0;
-
-    contains_usecs ();  /* set flag */
-    free (tkn);
     break;
     /* time taken to serve the request, in microseconds */
   case 'D':
     /* ignore it if we already have served time */
     if (logitem->serve_time)
       return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
 
     serve_time = strtoull (tkn, &bEnd, 10);
     if (tkn == bEnd || *bEnd != '\0' || errno == ERANGE)
       serve_time = 0;
     logitem->serve_time = serve_time;
-
-    contains_usecs ();  /* set flag */
-    free (tkn);
     break;
 
     /* UMS: Krypto (TLS) "ECDHE-RSA-AES128-GCM-SHA256" */
@@ -1172,15 +1689,16 @@ parse_specifier (GLogItem * logitem, char **str, const char *p, const char *end)
     /* error to set this twice */
     if (logitem->tls_cypher)
       return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
 
 #if defined(HAVE_LIBSSL) && defined(HAVE_CIPHER_STD_NAME)
     {
       char *tmp = NULL;
       for (tmp = tkn; isdigit (*tmp); tmp++);
       if (!strlen (tmp))
-        extract_tls_version_cipher (tkn, &logitem->tls_cypher, &logitem->tls_type);
+        extract_tls_version_cipher (logitem->arena, tkn, &logitem->tls_cypher,
+                                    &logitem->tls_type);
       else
         logitem->tls_cypher = tkn;
     }
@@ -1195,8 +1713,8 @@ parse_specifier (GLogItem * logitem, char **str, const char *p, const char *end)
     /* error to set this twice */
     if (logitem->tls_type)
       return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
 
     logitem->tls_type = tkn;
     break;
@@ -1206,8 +1724,8 @@ parse_specifier (GLogItem * logitem, char **str, const char *p, const char *end)
     /* error to set this twice */
     if (logitem->mime_type)
       return 0;
-    if (!(tkn = parse_string (&(*str), end, 1)))
-      return spec_err (logitem, SPEC_TOKN_NUL, *p, NULL);
+    if (!(tkn = parse_string (logitem->arena, &(*str), end, 1)))
+      return spec_err (logitem, SPEC_TOKN_NUL, op->spec, NULL);
 
     logitem->mime_type = tkn;
 
@@ -1218,7 +1736,7 @@ parse_specifier (GLogItem * logitem, char **str, const char *p, const char *end)
     break;
     /* everything else skip it */
   default:
-    if ((pch = strchr (*str, p[1])) != NULL)
+    if ((pch = strchr (*str, op->end[0])) != NULL)
       *str += pch - *str;
   }
 
@@ -1231,8 +1749,9 @@ parse_specifier (GLogItem * logitem, char **str, const char *p, const char *end)
  * If no unable to find both curly braces (boundaries), NULL is returned.
  * On success, the malloc'd reject set is returned. */
 static char *
-extract_braces (char **p) {
-  char *b1 = NULL, *b2 = NULL, *ret = NULL, *s = *p;
+extract_braces (const char **p) {
+  const char *b1 = NULL, *b2 = NULL, *s = *p;
+  char *ret = NULL;
   int esc = 0;
   ptrdiff_t len = 0;
 
@@ -1270,13 +1789,13 @@ extract_braces (char **p) {
  * On success, the malloc'd token is assigned to a GLogItem->host and
  * 0 is returned. */
 static int
-find_xff_host (GLogItem * logitem, char **str, char **p) {
-  char *ptr = NULL, *tkn = NULL, *skips = NULL;
+find_xff_host (GLogItem * logitem, char **str, const char *skips) {
+  char *ptr = NULL, *tkn = NULL;
   int invalid_ip = 1, len = 0, type_ip = TYPE_IPINV;
   int idx = 0, skips_len = 0;
 
-  if (!(skips = extract_braces (p)))
-    return spec_err (logitem, SPEC_SFMT_MIS, **p, "{}");
+  if (skips == NULL)
+    return spec_err (logitem, SPEC_SFMT_MIS, 'h', "{}");
 
   skips_len = strlen (skips);
   ptr = *str;
@@ -1292,28 +1811,23 @@ find_xff_host (GLogItem * logitem, char **str, char **p) {
 
     ptr += len;
     /* extract possible IP */
-    if (!(tkn = parsed_string (ptr, str, 0)))
+    if (!(tkn = parsed_string (logitem->arena, ptr, str, 0)))
       break;
 
     invalid_ip = invalid_ipaddr (tkn, &type_ip);
     /* done, already have IP and current token is not a host */
-    if (logitem->host && invalid_ip) {
-      free (tkn);
+    if (logitem->host && invalid_ip)
       break;
-    }
     if (!logitem->host && !invalid_ip) {
-      logitem->host = xstrdup (tkn);
+      logitem->host = tkn;
       logitem->type_ip = type_ip;
     }
-    free (tkn);
     idx = 0;
 
   move:
     *str += len;
   }
 
-  free (skips);
-
   return logitem->host == NULL;
 }
 
@@ -1323,13 +1837,13 @@ find_xff_host (GLogItem * logitem, char **str, char **p) {
  * On success, the malloc'd token is assigned to a GLogItem member and
  * 0 is returned. */
 static int
-special_specifier (GLogItem * logitem, char **str, char **p) {
-  switch (**p) {
+special_specifier (GLogItem * logitem, char **str, const GLogFmtOp * op) {
+  switch (op->spec) {
     /* XFF remote hostname (IP only) */
   case 'h':
     if (logitem->host)
       return 0;
-    if (find_xff_host (logitem, str, p))
+    if (find_xff_host (logitem, str, op->skips))
       return spec_err (logitem, SPEC_TOKN_NUL, 'h', NULL);
     break;
   }
@@ -1337,21 +1851,35 @@ special_specifier (GLogItem * logitem, char **str, char **p) {
   return 0;
 }
 
-/* Iterate over the given log format.
+/* Append a new operation of the given type to a compiled log format.
  *
- * On error, or unable to parse it, 1 is returned.
- * On success, the malloc'd token is assigned to a GLogItem member and
- * 0 is returned. */
-static int
-parse_format (GLogItem * logitem, char *str, char *lfmt) {
-  char end[2 + 1] = { 0 };
-  char *p = NULL;
-  int perc = 0, tilde = 0, ret = 0;
+ * On success, the new operation is returned. */
+static GLogFmtOp *
+new_format_op (GLogFmt * fmt, GLogFmtOpType type) {
+  GLogFmtOp *op = NULL;
+
+  if (fmt->len == fmt->size) {
+    fmt->size = fmt->size ? fmt->size * 2 : 16;
+    fmt->ops = xrealloc (fmt->ops, fmt->size * sizeof (GLogFmtOp));
+  }
 
-  if (str == NULL || *str == '\0')
-    return 1;
+  op = &fmt->ops[fmt->len++];
+  memset (op, 0, sizeof (*op));
+  op->type = type;
+
+  return op;
+}
+
+/* Compile the given log format into a program of operations that
+ * parse_format() can run on every line without walking the format
+ * string again. Note that the state (perc/tilde) is carried the same
+ * way a character-by-character walk of the format would. */
+static void
+compile_format (GLogFmt * fmt, const char *lfmt, int perc, int tilde) {
+  GLogFmtOp *op = NULL;
+  const char *p = NULL, *b = NULL;
+  uint32_t idx = 0;
 
-  /* iterate over the log format */
   for (p = lfmt; *p; p++) {
     if (*p == '%') {
       perc++;
@@ -1361,41 +1889,257 @@ parse_format (GLogItem * logitem, char *str, char *lfmt) {
       tilde++;
       continue;
     }
-    if (*str == '\n')
-      return 0;
 
-    if (tilde && *p != '\0') {
-      if (*str == '\0')
-        return 0;
-      if (special_specifier (logitem, &str, &p) == 1)
-        return 1;
+    /* ~h{...} */
+    if (tilde) {
+      op = new_format_op (fmt, FMT_OP_SPECIAL);
+      op->spec = *p;
       tilde = 0;
+      if (*p != 'h')
+        continue;
+
+      /* if the host was already set, the rest of the format, braces
+       * included, is read as if there was no special specifier */
+      idx = fmt->len - 1;
+      b = p;
+      if ((op->skips = extract_braces (&b)) != NULL && *b != '\0')
+        compile_format (fmt, b + 1, perc, 0);
+      else if (op->skips != NULL)
+        new_format_op (fmt, FMT_OP_END);
+      fmt->ops[idx].alt = fmt->len;
+      compile_format (fmt, p + 1, perc, 0);
+      return;
     }
-    /* %h */
-    else if (perc && *p != '\0') {
-      if (*str == '\0')
-        return 0;
 
-      memset (end, 0, sizeof end);
-      get_delim (end, p);
-      /* attempt to parse format specifiers */
-      if ((ret = parse_specifier (logitem, &str, p, end)))
-        return ret;
+    /* %h */
+    if (perc) {
+      op = new_format_op (fmt, FMT_OP_SPEC);
+      op->spec = *p;
+      get_delim (op->end, p);
+      if (*p == 'd')
+        op->fmtspcs = count_matches (conf.date_format, ' ');
       perc = 0;
-    } else if (perc && isspace (p[0])) {
-      return 1;
-    } else {
-      str++;
+      continue;
     }
+
+    /* literal chars are merged into a single run */
+    if (fmt->len && fmt->ops[fmt->len - 1].type == FMT_OP_LITERAL)
+      fmt->ops[fmt->len - 1].len++;
+    else
+      new_format_op (fmt, FMT_OP_LITERAL)->len = 1;
   }
 
-  return 0;
+  new_format_op (fmt, FMT_OP_END);
 }
 
-/* Determine if the log string is valid and if it's not a comment.
- *
- * On error, or invalid, 1 is returned.
- * On success, or valid line, 0 is returned. */
+/* Free all operations of a compiled log format. */
+static void
+free_format (GLogFmt * fmt) {
+  uint32_t i;
+
+  for (i = 0; i < fmt->len; ++i)
+    free (fmt->ops[i].skips);
+  free (fmt->ops);
+  memset (fmt, 0, sizeof (*fmt));
+}
+
+/* The log format compiled by compile_log_format() */
+static GLogFmt log_fmt;
+/* JSON log format, each key mapped to its compiled specifiers */
+static khash_t (sfmt) * json_fmt = NULL;
+
+/* Free the compiled JSON log format. */
+static void
+free_json_format (void) {
+  khint_t k;
+
+  if (!json_fmt)
+    return;
+
+  for (k = kh_begin (json_fmt); k != kh_end (json_fmt); ++k) {
+    if (!kh_exist (json_fmt, k))
+      continue;
+    free_format (kh_val (json_fmt, k));
+    free (kh_val (json_fmt, k));
+    free ((char *) kh_key (json_fmt, k));
+  }
+  kh_destroy (sfmt, json_fmt);
+  json_fmt = NULL;
+}
+
+/* Compile the specifiers of a JSON log format key, e.g.,
+ * request.method => %m. If the key is repeated, the last one is kept.
+ *
+ * On success, 0 is returned. */
+static int
+compile_json_format (GO_UNUSED void *userdata, char *key, char *spec) {
+  GLogFmt *fmt = NULL;
+  khint_t k;
+  int ret;
+
+  k = kh_put (sfmt, json_fmt, key, &ret);
+  if (ret == 0) {
+    fmt = kh_val (json_fmt, k);
+    free_format (fmt);
+  } else {
+    kh_key (json_fmt, k) = xstrdup (key);
+    fmt = xcalloc (1, sizeof (GLogFmt));
+    kh_val (json_fmt, k) = fmt;
+  }
+
+  compile_format (fmt, spec, 0, 0);
+  /* a value made of a single specifier goes straight to its handler */
+  fmt->single = fmt->len == 2 && fmt->ops[0].type == FMT_OP_SPEC;
+
+  return 0;
+}
+
+/* Flag the metrics the given compiled format provides, i.e., bandwidth
+ * and time served. They're set once here rather than by every parsed
+ * line, since lines may be parsed on several threads. */
+static void
+set_format_metrics (const GLogFmt * fmt) {
+  uint32_t i;
+
+  for (i = 0; i < fmt->len; ++i) {
+    if (fmt->ops[i].type != FMT_OP_SPEC)
+      continue;
+    if (fmt->ops[i].spec == 'b')
+      conf.bandwidth = 1;
+    else if (strchr ("DLT", fmt->ops[i].spec))
+      conf.serve_usecs = 1;
+  }
+}
+
+/* Compile the log format set through the configuration so every line
+ * runs its program rather than walking the format string. The kind of
+ * date and time formats is determined here as well.
+ * Note: The date format has to be set before compiling it. */
+void
+compile_log_format (void) {
+  khint_t k;
+
+  date_fmt_type = get_date_fmt_type (conf.date_format);
+  time_fmt_type = get_date_fmt_type (conf.time_format);
+  date_num_ymd = conf.date_num_format && !strcmp (conf.date_num_format, "%Y%m%d");
+
+  free_format (&log_fmt);
+  free_json_format ();
+  if (conf.log_format == NULL)
+    return;
+
+  if (!conf.is_json_log_format) {
+    compile_format (&log_fmt, conf.log_format, 0, 0);
+    set_format_metrics (&log_fmt);
+    return;
+  }
+
+  json_fmt = kh_init (sfmt);
+  if (parse_json_string (NULL, conf.log_format, compile_json_format) == -1)
+    FATAL ("Invalid JSON log format. Verify the syntax.");
+
+  for (k = kh_begin (json_fmt); k != kh_end (json_fmt); ++k) {
+    if (kh_exist (json_fmt, k))
+      set_format_metrics (kh_val (json_fmt, k));
+  }
+}
+
+/* Determine if the given module is enabled.
+ *
+ * If not enabled, 0 is returned.
+ * If enabled, 1 is returned. */
+static int
+has_module (GModule module) {
+  return get_module_index (module) != -1;
+}
+
+/* Compile the ingest plan out of the enabled panels and the options so
+ * a line only goes through the work some panel or option needs. e.g.,
+ * the referrer is still parsed to ignore it even if no referrer panel
+ * is enabled.
+ * Note: The panels have to be verified before compiling it. */
+void
+compile_ingest_plan (void) {
+  int refs = has_module (REFERRERS), sites = has_module (REFERRING_SITES);
+  int ignore_refs = conf.ignore_referer_idx > 0;
+
+  ingest_plan.specs['v'] = has_module (VIRTUAL_HOSTS);
+  ingest_plan.specs['e'] = has_module (REMOTE_USER);
+  ingest_plan.specs['C'] = has_module (CACHE_STATUS);
+  ingest_plan.specs['M'] = has_module (MIME_TYPE);
+  ingest_plan.specs['k'] = has_module (TLS_TYPE);
+  ingest_plan.specs['K'] = has_module (TLS_TYPE);
+  ingest_plan.specs['R'] = refs || sites || has_module (KEYPHRASES) || ignore_refs;
+
+  /* extracting the keyphrase cuts the referrer short at its query */
+  ingest_plan.keyphrase = has_module (KEYPHRASES) || refs || ignore_refs;
+  /* a hidden referring site hides the referrer as well */
+  ingest_plan.ref_site = sites || ((refs || ignore_refs) && conf.hide_referer_idx > 0);
+
+  ingest_plan.browsers = has_module (BROWSERS);
+  ingest_plan.os = has_module (OS);
+
+  compile_panel_parsers ();
+}
+
+/* Free the compiled log format. */
+void
+free_log_format (void) {
+  free_format (&log_fmt);
+  free_json_format ();
+}
+
+/* Run a compiled log format over the given log string.
+ *
+ * On error, or unable to parse it, 1 is returned.
+ * On success, the malloc'd token is assigned to a GLogItem member and
+ * 0 is returned. */
+static int
+parse_format (GLogItem * logitem, char *str, const GLogFmt * fmt) {
+  const GLogFmtOp *op = NULL;
+  uint32_t i = 0, n = 0;
+  int ret = 0;
+
+  if (str == NULL || *str == '\0')
+    return 1;
+
+  while ((op = &fmt->ops[i++])->type != FMT_OP_END) {
+    if (*str == '\n' || *str == '\0')
+      return 0;
+
+    switch (op->type) {
+    case FMT_OP_LITERAL:
+      for (n = 0; n < op->len; ++n, ++str) {
+        if (*str == '\n' || *str == '\0')
+          return 0;
+      }
+      break;
+    case FMT_OP_SPEC:
+      /* attempt to parse format specifiers */
+      if ((ret = parse_specifier (logitem, &str, op)))
+        return ret;
+      break;
+    case FMT_OP_SPECIAL:
+      /* already set, read the rest of the format as it is */
+      if (op->spec == 'h' && logitem->host) {
+        i = op->alt;
+        break;
+      }
+      if (special_specifier (logitem, &str, op) == 1)
+        return 1;
+      break;
+    default:
+      break;
+    }
+  }
+
+  return 0;
+}
+
+/* Determine if the log string is valid and if it's not a comment.
+ *
+ * On error, or invalid, 1 is returned.
+ * On success, or valid line, 0 is returned. */
 static int
 valid_line (char *line) {
   /* invalid line */
@@ -1453,11 +2197,11 @@ static int
 verify_missing_fields (GLogItem * logitem) {
   /* must have the following fields */
   if (logitem->host == NULL)
-    logitem->errstr = xstrdup ("IPv4/6 is required.");
+    logitem->errstr = arena_strdup (logitem->arena, "IPv4/6 is required.");
   else if (logitem->date == NULL)
-    logitem->errstr = xstrdup ("A valid date is required.");
+    logitem->errstr = arena_strdup (logitem->arena, "A valid date is required.");
   else if (logitem->req == NULL)
-    logitem->errstr = xstrdup ("A request is required.");
+    logitem->errstr = arena_strdup (logitem->arena, "A request is required.");
 
   return logitem->errstr != NULL;
 }
@@ -1468,13 +2212,13 @@ verify_missing_fields (GLogItem * logitem) {
  * If the request line is not ignored, 0 is returned.
  * If the request line is ignored, 1 is returned. */
 static int
-handle_crawler (const char *agent) {
+handle_crawler (GLogItem * logitem) {
   int bot = 0;
 
   if (!conf.ignore_crawlers && !conf.crawlers_only)
     return 1;
 
-  bot = is_crawler (agent);
+  bot = is_agent_crawler (logitem->agent, logitem->agent_hash);
   return (conf.ignore_crawlers && bot) || (conf.crawlers_only && !bot) ? 0 : 1;
 }
 
@@ -1507,8 +2251,8 @@ ignore_status_code (const char *status) {
     * If the request line is not ignored, 0 is returned.
     * If the request line is ignored, 1 is returned. */
 static int
-ignore_static (const char *req) {
-  if (conf.ignore_statics && is_static (req))
+ignore_static (GLogItem * logitem) {
+  if (conf.ignore_statics && logitem->is_static)
     return 1;
   return 0;
 }
@@ -1535,51 +2279,56 @@ is_404 (GLogItem * logitem) {
  * If the request line is only not counted as valid, IGNORE_LEVEL_REQ is returned. */
 static int
 ignore_line (GLogItem * logitem) {
-  if (excluded_ip (logitem) == 0)
+  if (excluded_ip (logitem) == 0) {
+    logitem->is_excluded_ip = 1;
     return IGNORE_LEVEL_PANEL;
-  if (handle_crawler (logitem->agent) == 0)
+  }
+  if (handle_crawler (logitem) == 0)
     return IGNORE_LEVEL_PANEL;
   if (ignore_referer (logitem->ref))
     return IGNORE_LEVEL_PANEL;
   if (ignore_status_code (logitem->status))
     return IGNORE_LEVEL_PANEL;
-  if (ignore_static (logitem->req))
+  if (ignore_static (logitem))
     return conf.ignore_statics; // IGNORE_LEVEL_PANEL or IGNORE_LEVEL_REQ
 
-  /* check if we need to remove the request's query string */
-  if (conf.ignore_qstr)
+  /* check if we need to remove the request's query string, the storage
+   * classifies the request without it */
+  if (conf.ignore_qstr) {
     strip_qstring (logitem->req);
+    logitem->is_static = is_static (logitem->req);
+  }
 
   return 0;
 }
 
-/* The following generates a unique key to identity unique visitors.
- * The key is made out of the IP, date, and user agent.
- * Note that for readability, doing a simple snprintf/sprintf should
- * suffice, however, memcpy is the fastest solution
- *
- * On success the new unique visitor key is returned */
-static char *
-get_uniq_visitor_key (GLogItem * logitem) {
-  char *key = NULL;
-  size_t s1, s2, s3;
-
-  s1 = strlen (logitem->date);
-  s2 = strlen (logitem->host);
-  s3 = strlen (logitem->agent_hex);
-
-  /* includes terminating null */
-  key = xcalloc (s1 + s2 + s3 + 3, sizeof (char));
-
-  memcpy (key, logitem->date, s1);
+/* The following sets the unique key to identity unique visitors.
+ * The key is made out of the date, the user agent hash, and the IP in its
+ * binary form. Hosts that are not a valid IP (e.g., --no-ip-validation)
+ * are hashed into the address bytes under a prefix no client address
+ * uses (ff00::/8 multicast). */
+void
+set_uniq_key (GUniqKey * key, uint32_t date, const char *host, uint32_t agent) {
+  uint64_t h64 = 0;
+  uint32_t h32 = 0;
 
-  key[s1] = '|';
-  memcpy (key + s1 + 1, logitem->host, s2 + 1);
+  memset (key, 0, sizeof (GUniqKey));
+  key->date = date;
+  key->agent = agent;
 
-  key[s1 + s2 + 1] = '|';
-  memcpy (key + s1 + s2 + 2, logitem->agent_hex, s3 + 1);
+  if (1 == inet_pton (AF_INET, host, key->host + 12)) {
+    key->host[10] = 0xff;
+    key->host[11] = 0xff;
+    return;
+  }
+  if (1 == inet_pton (AF_INET6, host, key->host))
+    return;
 
-  return key;
+  h64 = fnv1a64 (host);
+  h32 = djb2 ((unsigned char *) host);
+  key->host[0] = 0xff;
+  memcpy (key->host + 4, &h32, sizeof (h32));
+  memcpy (key->host + 8, &h64, sizeof (h64));
 }
 
 /* Determine if the current log has the content from the last time it was
@@ -1656,6 +2405,21 @@ should_restore_from_disk (GLog * glog) {
   return 1;
 }
 
+/* Count a line rejected by --prefilter. As with invalid lines, those
+ * of a restored log are only counted past the last parsed line. */
+static void
+process_prefiltered (GLog * glog) {
+  GLastParse lp = { 0 };
+
+  if (conf.restore && glog->inode) {
+    lp = ht_get_last_parse (glog->inode);
+    if (is_likely_same_log (glog, &lp) && (glog->size <= lp.size || glog->read < lp.line))
+      return;
+  }
+
+  count_prefiltered ();
+}
+
 static void
 process_invalid (GLog * glog, GLogItem * logitem, const char *line) {
   GLastParse lp = { 0 };
@@ -1694,24 +2458,30 @@ process_invalid (GLog * glog, GLogItem * logitem, const char *line) {
     count_process_and_invalid (glog, line);
 }
 
+/* Parse a JSON value through the specifiers compiled for its key.
+ *
+ * On error, or unable to parse it, 1 is returned.
+ * On success, or if the key isn't part of the log format, 0 is
+ * returned. */
 static int
 parse_json_specifier (void *ptr_data, char *key, char *str) {
   GLogItem *logitem = (GLogItem *) ptr_data;
-  char *spec = NULL;
-  int ret = 0;
+  const GLogFmt *fmt = NULL;
+  khint_t k;
 
-  if (!str)
-    return 0;
   /* empty JSON value, e.g., {method: ""} */
-  if (0 == strlen (str))
+  if (!str || *str == '\0')
     return 0;
-  if (!(spec = ht_get_json_logfmt (key)))
+  if ((k = kh_get (sfmt, json_fmt, key)) == kh_end (json_fmt))
     return 0;
 
-  ret = parse_format (logitem, str, spec);
-  free (spec);
+  fmt = kh_val (json_fmt, k);
+  if (!fmt->single)
+    return parse_format (logitem, str, fmt);
 
-  return ret;
+  if (*str == '\n')
+    return 0;
+  return parse_specifier (logitem, &str, &fmt->ops[0]);
 }
 
 static int
@@ -1719,82 +2489,133 @@ parse_json_format (GLogItem * logitem, char *str) {
   return parse_json_string (logitem, str, parse_json_specifier);
 }
 
-/* Process a line from the log and store it accordingly taking into
- * account multiple parsing options prior to setting data into the
- * corresponding data structure.
+/* Parse a line from the log into the given GLogItem and derive all the
+ * per-line data that doesn't depend on storage nor on the order in which
+ * lines are processed, i.e., it can safely run on a parser worker thread.
  *
+ * On error, or invalid line, non-zero is returned.
  * On success, 0 is returned */
-int
-pre_process_log (GLog * glog, char *line, int dry_run) {
-  GLogItem *logitem;
+static int
+parse_line (GLogItem * logitem, char *line, int dry_run) {
   int ret = 0;
-  char *fmt = conf.log_format;
-
-  /* soft ignore these lines */
-  if (valid_line (line))
-    return -1;
-
-  logitem = init_log_item (glog);
 
   /* Parse a line of log, and fill structure with appropriate values */
   if (conf.is_json_log_format)
     ret = parse_json_format (logitem, line);
   else
-    ret = parse_format (logitem, line, fmt);
+    ret = parse_format (logitem, line, &log_fmt);
 
-  if (ret || (ret = verify_missing_fields (logitem))) {
-    process_invalid (glog, logitem, line);
-    goto cleanup;
-  }
-
-  if ((glog->lp.ts = mktime (&logitem->dt)) == -1)
-    goto cleanup;
+  if (ret || (ret = verify_missing_fields (logitem)))
+    return ret;
 
-  if (should_restore_from_disk (glog))
-    goto cleanup;
-
-  count_process (glog);
+  if ((logitem->ts = cached_mktime (logitem->dcache, &logitem->dt)) == -1)
+    return 0;
 
   /* agent will be null in cases where %u is not specified */
   if (logitem->agent == NULL) {
-    logitem->agent = alloc_string ("-");
+    logitem->agent = arena_strdup (logitem->arena, "-");
     set_agent_hash (logitem);
   }
 
   /* testing log only */
   if (dry_run)
-    goto cleanup;
+    return 0;
 
+  /* classified once, for both ignore_line() and the storage (unless -q
+   * strips the query string) */
+  logitem->is_static = is_static (logitem->req);
   logitem->ignorelevel = ignore_line (logitem);
   /* ignore line */
   if (logitem->ignorelevel == IGNORE_LEVEL_PANEL)
-    goto cleanup;
+    return 0;
 
-  if (is_404 (logitem))
+  if (is_404 (logitem)) {
     logitem->is_404 = 1;
-  else if (is_static (logitem->req))
-    logitem->is_static = 1;
+    logitem->is_static = 0;
+  }
 
-  logitem->uniq_key = get_uniq_visitor_key (logitem);
+  set_uniq_key (&logitem->uniq_key, logitem->numdate, logitem->host, logitem->agent_hash);
+
+  return 0;
+}
+
+/* Store a parsed GLogItem taking into account the restore state of the
+ * given log and the counters that depend on the order lines are read.
+ * Note that storage copies whatever it keeps from the GLogItem, so its
+ * arena can be reset upon return.
+ *
+ * On success, 0 is returned */
+static int
+ingest_log_item (GLog * glog, GLogItem * logitem, const char *line, int ret, int dry_run) {
+  glog->items = logitem;
+
+  if (ret) {
+    process_invalid (glog, logitem, line);
+    return ret;
+  }
+
+  if ((glog->lp.ts = logitem->ts) == -1)
+    return ret;
+
+  if (should_restore_from_disk (glog))
+    return ret;
+
+  count_process (glog);
+
+  /* testing log only */
+  if (dry_run)
+    return ret;
+
+  /* ignore line */
+  if (logitem->ignorelevel == IGNORE_LEVEL_PANEL) {
+    if (logitem->is_excluded_ip)
+      count_excluded_ip ();
+    return ret;
+  }
 
   process_log (logitem);
 
-cleanup:
-  free_glog (logitem);
+  return ret;
+}
+
+/* Process a line from the log and store it accordingly taking into
+ * account multiple parsing options prior to setting data into the
+ * corresponding data structure.
+ *
+ * On success, 0 is returned */
+int
+pre_process_log (GLog * glog, char *line, int dry_run) {
+  GLogItem *logitem;
+  int ret = 0;
+
+  /* soft ignore these lines */
+  if (valid_line (line))
+    return -1;
+
+  /* rejected without being parsed */
+  if (!dry_run && prefilters_len && !prefilter_line (line, strlen (line))) {
+    process_prefiltered (glog);
+    return -1;
+  }
+
+  logitem = init_log_item (glog);
+  ret = parse_line (logitem, line, dry_run);
+  ret = ingest_log_item (glog, logitem, line, ret, dry_run);
+
+  /* release the GLogItem and all its strings at once */
+  arena_reset (&glog->arena);
 
   return ret;
 }
 
-/* Entry point to process the given live from the log.
+/* Determine if the log format is likely not matching once the number of
+ * lines to test has been reached without finding a valid record.
  *
  * On error, 1 is returned.
  * On success or soft ignores, 0 is returned. */
 static int
-read_line (GLog * glog, char *line, int *test, int *cnt, int dry_run) {
-  int ret = 0;
-
-  /* start processing log line */
-  if ((ret = pre_process_log (glog, line, dry_run)) == 0 && *test)
+test_line (GLog * glog, int ret, int *test, int *cnt) {
+  if (ret == 0 && *test)
     *test = 0;
 
   /* soft ignores */
@@ -1812,6 +2633,16 @@ read_line (GLog * glog, char *line, int *test, int *cnt, int dry_run) {
   return 0;
 }
 
+/* Entry point to process the given live from the log.
+ *
+ * On error, 1 is returned.
+ * On success or soft ignores, 0 is returned. */
+static int
+read_line (GLog * glog, char *line, int *test, int *cnt, int dry_run) {
+  /* start processing log line */
+  return test_line (glog, pre_process_log (glog, line, dry_run), test, cnt);
+}
+
 /* A replacement for GNU getline() to dynamically expand fgets buffer.
  *
  * On error, NULL is returned.
@@ -1932,6 +2763,533 @@ read_lines (FILE * fp, GLog * glog, int dry_run) {
 }
 #endif
 
+/* Initialize a line reader for the given file descriptor. */
+static void
+init_line_reader (GLineReader * lr, int fd) {
+  memset (lr, 0, sizeof (*lr));
+  lr->fd = fd;
+  lr->size = READ_CHUNK;
+  lr->buf = xmalloc (lr->size + 1);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+/* Free the chunk buffer of the given line reader. */
+static void
+free_line_reader (GLineReader * lr) {
+  free (lr->buf);
+  lr->buf = NULL;
+}
+
+/* Read the next chunk from the log, or from its decompressor, keeping
+ * the partial line left at the end of the buffer. The buffer grows if a
+ * line doesn't fit in it.
+ *
+ * If no more data can be read, 0 is returned.
+ * Otherwise, the number of bytes read is returned. */
+static ssize_t
+read_chunk (GLineReader * lr) {
+  ssize_t bytes = 0;
+
+  /* move the partial line to the beginning of the buffer */
+  if (lr->start) {
+    memmove (lr->buf, lr->buf + lr->start, lr->len - lr->start);
+    lr->len -= lr->start;
+    lr->start = 0;
+  }
+
+  /* a single line longer than the buffer */
+  if (lr->len == lr->size) {
+    lr->size *= 2;
+    lr->buf = xrealloc (lr->buf, lr->size + 1);
+  }
+
+  if (lr->decomp) {
+    bytes = decomp_read (lr->decomp, lr->buf + lr->len, lr->size - lr->len);
+  } else {
+    do {
+      bytes = read (lr->fd, lr->buf + lr->len, lr->size - lr->len);
+    } while (bytes == -1 && errno == EINTR);
+  }
+
+  if (bytes <= 0)
+    return 0;
+  lr->len += bytes;
+
+  return bytes;
+}
+
+/* Get the next line from the log. The line is a slice of the chunk
+ * buffer, it includes the trailing new line (if any) and it is
+ * null-terminated until the next call to next_line().
+ *
+ * If the end of the log was reached, NULL is returned.
+ * On success, the line is returned and its length assigned to len. */
+static char *
+next_line (GLineReader * lr, size_t *len) {
+  char *line = NULL, *nl = NULL;
+
+  /* restore the first byte of the line following the previous one */
+  if (lr->held_chr) {
+    lr->buf[lr->held] = lr->held_chr;
+    lr->held_chr = '\0';
+  }
+
+  while (1) {
+    line = lr->buf + lr->start;
+    if ((nl = memchr (line, '\n', lr->len - lr->start)) != NULL) {
+      *len = nl - line + 1;
+      break;
+    }
+    if (lr->eof || !read_chunk (lr)) {
+      lr->eof = 1;
+      /* last line without a trailing new line */
+      if ((*len = lr->len - lr->start) == 0)
+        return NULL;
+      break;
+    }
+  }
+
+  lr->start += *len;
+  lr->held = lr->start;
+  lr->held_chr = lr->buf[lr->held];
+  lr->buf[lr->held] = '\0';
+
+  return line;
+}
+
+/* Iterate over a regular log and read line by line. Lines are sliced out
+ * of large chunks read from the log, thus no per-line copies are made and
+ * there's no limit on the length of a line.
+ *
+ * On error, 1 is returned.
+ * On success, 0 is returned. */
+static int
+read_lines_chunked (GLineReader * lr, GLog * glog, int dry_run) {
+  char *line = NULL;
+  size_t len = 0;
+  int ret = 0, cnt = 0, test = conf.num_tests > 0 ? 1 : 0;
+
+  glog->bytes = 0;
+  while ((line = next_line (lr, &len)) != NULL) {
+    /* handle SIGINT */
+    if (conf.stop_processing)
+      break;
+    if ((ret = read_line (glog, line, &test, &cnt, dry_run)))
+      break;
+    if (dry_run && NUM_TESTS == cnt)
+      break;
+    glog->bytes += len;
+    glog->read++;
+  }
+
+  /* fails if
+     - we're still reading the log but the test flag was still set
+     - ret flag is not 0, read_line failed
+     - reached the end of file, test flag was still set and we processed lines */
+  return (line && test) || ret || (!line && test && glog->processed);
+}
+
+/* Append a line to the given batch, growing its buffers as needed. */
+static void
+append_batch_line (GJobBatch * batch, const char *line, size_t len) {
+  GJobLine *jline = NULL;
+
+  if (batch->len == batch->size) {
+    batch->size *= 2;
+    batch->lines = xrealloc (batch->lines, batch->size * sizeof (GJobLine));
+  }
+  jline = &batch->lines[batch->len++];
+
+  while (batch->buflen + len + 1 > batch->bufsize) {
+    batch->bufsize *= 2;
+    batch->buf = xrealloc (batch->buf, batch->bufsize);
+  }
+  memcpy (batch->buf + batch->buflen, line, len);
+  batch->buf[batch->buflen + len] = '\0';
+
+  jline->off = batch->buflen;
+  jline->len = len;
+  jline->ret = 0;
+  jline->prefiltered = 0;
+  jline->logitem = NULL;
+
+  batch->buflen += len + 1;
+}
+
+/* Read the log from the given offset into the raw buffer of the batch
+ * until it holds at least len bytes.
+ *
+ * If the end of the log was reached, 1 is returned.
+ * Otherwise, 0 is returned. */
+static int
+read_range (int fd, GJobBatch * batch, uint64_t offset, size_t len) {
+  ssize_t bytes = 0;
+
+  if (len > batch->rawsize) {
+    batch->rawsize = MAX (len, batch->rawsize * 2);
+    batch->raw = xrealloc (batch->raw, batch->rawsize);
+  }
+
+  while (batch->rawlen < len) {
+    bytes = pread (fd, batch->raw + batch->rawlen, len - batch->rawlen,
+                   offset + batch->rawlen);
+    if (bytes == -1 && errno == EINTR)
+      continue;
+    if (bytes <= 0)
+      return 1;
+    batch->rawlen += bytes;
+  }
+
+  return 0;
+}
+
+/* Fill the given batch with the lines within the given byte range of
+ * the log. A range holds every line starting at or after its first
+ * byte and before the first byte of the next range, so lines are never
+ * split across ranges.
+ *
+ * If the end of the log was reached, 1 is returned.
+ * Otherwise, 0 is returned. */
+static int
+fill_batch (GJobBatch * batch, int fd, uint64_t range) {
+  uint64_t from = range * JOB_RANGE_BYTES, to = from + JOB_RANGE_BYTES;
+  /* the byte preceding the range tells if a line starts right at it */
+  uint64_t base = from ? from - 1 : 0;
+  size_t start = 0, end = 0, scan = 0, len = 0;
+  char *nl = NULL;
+  int eof = 0;
+
+  batch->len = 0;
+  batch->buflen = 0;
+  batch->rawlen = 0;
+
+  eof = read_range (fd, batch, base, to - base + READ_BYTES);
+
+  /* first line starting within the range */
+  if (from) {
+    while ((nl = memchr (batch->raw + scan, '\n', batch->rawlen - scan)) == NULL) {
+      if (eof)
+        return 1;
+      scan = batch->rawlen;
+      eof = read_range (fd, batch, base, batch->rawlen + READ_BYTES);
+    }
+    start = nl - batch->raw + 1;
+  }
+  /* a line longer than the whole range, it belongs to a later range */
+  if (base + start >= to)
+    return 0;
+
+  /* last line starting within the range */
+  scan = MIN (to - 1 - base, batch->rawlen);
+  while ((nl = memchr (batch->raw + scan, '\n', batch->rawlen - scan)) == NULL) {
+    if (eof)
+      break;
+    scan = batch->rawlen;
+    eof = read_range (fd, batch, base, batch->rawlen * 2);
+  }
+  end = nl ? (size_t) (nl - batch->raw + 1) : batch->rawlen;
+
+  while (start < end) {
+    /* handle SIGINT */
+    if (conf.stop_processing)
+      return 1;
+    nl = memchr (batch->raw + start, '\n', end - start);
+    len = nl ? (size_t) (nl - batch->raw) + 1 - start : end - start;
+    append_batch_line (batch, batch->raw + start, len);
+    start += len;
+  }
+
+  return eof && end == batch->rawlen;
+}
+
+/* Parse all lines within the given batch into GLogItems. */
+static void
+parse_batch (GJobBatch * batch) {
+  GJobLine *jline = NULL;
+  GLogItem *logitem = NULL;
+  char *line = NULL;
+  uint32_t i;
+
+  for (i = 0; i < batch->len; ++i) {
+    jline = &batch->lines[i];
+    line = batch->buf + jline->off;
+
+    /* soft ignore these lines */
+    if (valid_line (line)) {
+      jline->ret = -1;
+      continue;
+    }
+    /* rejected without being parsed, counted by the writer */
+    if (prefilters_len && !prefilter_line (line, jline->len)) {
+      jline->ret = -1;
+      jline->prefiltered = 1;
+      continue;
+    }
+
+    logitem = jline->logitem = new_log_item (&batch->arena, &batch->dcache);
+    if ((jline->ret = parse_line (logitem, line, 0)) || logitem->ts == -1)
+      continue;
+    if (logitem->ignorelevel == IGNORE_LEVEL_PANEL)
+      continue;
+
+    /* classify the user agent here rather than in the writer */
+    if (ingest_plan.browsers && *logitem->agent != '\0')
+      set_browser (logitem);
+    if (ingest_plan.os && *logitem->agent != '\0')
+      set_os (logitem);
+  }
+}
+
+/* Parser worker - Take the next byte range of the log, read it and parse
+ * its lines into the batch of the ring the range maps to. */
+static void *
+parse_batches (void *ptr_data) {
+  GJobs *jobs = (GJobs *) ptr_data;
+  GJobBatch *batch = NULL;
+  uint64_t range = 0;
+  int eof = 0;
+
+  while (1) {
+    pthread_mutex_lock (&jobs->mutex);
+    /* wait until the writer is done with the next batch in the ring */
+    batch = &jobs->batches[jobs->next_fill % jobs->nbatches];
+    while (!jobs->abort && !jobs->eof && batch->state != JOB_FREE) {
+      pthread_cond_wait (&jobs->cond, &jobs->mutex);
+      batch = &jobs->batches[jobs->next_fill % jobs->nbatches];
+    }
+    if (jobs->abort || jobs->eof) {
+      pthread_mutex_unlock (&jobs->mutex);
+      break;
+    }
+    range = jobs->next_fill++;
+    batch->state = JOB_PARSING;
+    pthread_mutex_unlock (&jobs->mutex);
+
+    eof = fill_batch (batch, jobs->fd, range);
+    parse_batch (batch);
+
+    pthread_mutex_lock (&jobs->mutex);
+    batch->state = JOB_PARSED;
+    if (eof)
+      jobs->eof = 1;
+    pthread_cond_broadcast (&jobs->cond);
+    pthread_mutex_unlock (&jobs->mutex);
+  }
+
+  return NULL;
+}
+
+/* Writer - Store the parsed lines of the given batch in the order they
+ * were read.
+ *
+ * If the writer needs to stop, 1 is returned.
+ * Otherwise, 0 is returned. */
+static int
+write_batch (GLog * glog, GJobBatch * batch, int *test, int *cnt, int *ret) {
+  GJobLine *jline = NULL;
+  uint32_t i;
+  int res = 0;
+
+  for (i = 0; i < batch->len; ++i) {
+    jline = &batch->lines[i];
+    /* handle SIGINT */
+    if (conf.stop_processing)
+      return 1;
+
+    res = jline->ret;
+    if (jline->prefiltered)
+      process_prefiltered (glog);
+    if (jline->logitem)
+      res = ingest_log_item (glog, jline->logitem, batch->buf + jline->off, jline->ret, 0);
+
+    if ((*ret = test_line (glog, res, test, cnt)))
+      return 1;
+    glog->bytes += jline->len;
+    glog->read++;
+  }
+
+  return 0;
+}
+
+/* Start the parser worker threads of the pipeline. */
+static void
+start_jobs (GJobs * jobs, int fd) {
+  uint32_t i;
+  int th;
+
+  memset (jobs, 0, sizeof (*jobs));
+  jobs->fd = fd;
+  jobs->nworkers = MIN (conf.jobs, MAX_JOBS);
+
+  /* a few batches per worker keep everyone busy while the writer stores */
+  jobs->nbatches = jobs->nworkers * 4;
+  jobs->batches = xcalloc (jobs->nbatches, sizeof (GJobBatch));
+  for (i = 0; i < jobs->nbatches; ++i) {
+    jobs->batches[i].size = JOB_BATCH_LINES;
+    jobs->batches[i].lines = xmalloc (JOB_BATCH_LINES * sizeof (GJobLine));
+    jobs->batches[i].bufsize = JOB_BATCH_BYTES;
+    jobs->batches[i].buf = xmalloc (JOB_BATCH_BYTES);
+  }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  if (pthread_cond_init (&(jobs->cond), NULL))
+    FATAL ("Failed init thread condition");
+
+  if (pthread_mutex_init (&(jobs->mutex), NULL))
+    FATAL ("Failed init thread mutex");
+
+  for (i = 0; i < (uint32_t) jobs->nworkers; ++i) {
+    th = pthread_create (&(jobs->workers[i]), NULL, parse_batches, jobs);
+    if (th)
+      FATAL ("Return code from pthread_create(): %d", th);
+  }
+}
+
+/* Stop all threads of the pipeline and free any batch left behind. */
+static void
+stop_jobs (GJobs * jobs) {
+  uint32_t i;
+
+  pthread_mutex_lock (&jobs->mutex);
+  jobs->abort = 1;
+  pthread_cond_broadcast (&jobs->cond);
+  pthread_mutex_unlock (&jobs->mutex);
+
+  for (i = 0; i < (uint32_t) jobs->nworkers; ++i)
+    pthread_join (jobs->workers[i], NULL);
+
+  for (i = 0; i < jobs->nbatches; ++i) {
+    arena_free (&jobs->batches[i].arena);
+    free (jobs->batches[i].lines);
+    free (jobs->batches[i].buf);
+    free (jobs->batches[i].raw);
+  }
+  free (jobs->batches);
+
+  pthread_mutex_destroy (&jobs->mutex);
+  pthread_cond_destroy (&jobs->cond);
+}
+
+/* Iterate over the log using --jobs workers, each one reading and
+ * parsing a byte range of the log at a time, and the calling thread as
+ * the single writer, which stores the parsed lines in the same order as
+ * read_lines_chunked() would.
+ *
+ * On error, 1 is returned.
+ * On success, 0 is returned. */
+static int
+read_lines_jobs (int fd, GLog * glog) {
+  GJobs jobs;
+  GJobBatch *batch = NULL;
+  int ret = 0, cnt = 0, test = conf.num_tests > 0 ? 1 : 0, stop = 0;
+
+  glog->bytes = 0;
+  start_jobs (&jobs, fd);
+
+  while (!stop) {
+    pthread_mutex_lock (&jobs.mutex);
+    batch = &jobs.batches[jobs.next_write % jobs.nbatches];
+    while (jobs.next_write == jobs.next_fill ? !jobs.eof : batch->state != JOB_PARSED)
+      pthread_cond_wait (&jobs.cond, &jobs.mutex);
+    if (jobs.next_write == jobs.next_fill) {
+      pthread_mutex_unlock (&jobs.mutex);
+      break;
+    }
+    pthread_mutex_unlock (&jobs.mutex);
+
+    stop = write_batch (glog, batch, &test, &cnt, &ret);
+    /* release all GLogItems of the batch at once */
+    arena_reset (&batch->arena);
+
+    pthread_mutex_lock (&jobs.mutex);
+    batch->state = JOB_FREE;
+    jobs.next_write++;
+    pthread_cond_broadcast (&jobs.cond);
+    pthread_mutex_unlock (&jobs.mutex);
+  }
+
+  stop_jobs (&jobs);
+
+  /* fails if
+     - we're still reading the log but the test flag was still set
+     - ret flag is not 0, read_line failed
+     - reached the end of file, test flag was still set and we processed lines */
+  return (stop && test) || ret || (!stop && test && glog->processed);
+}
+
+/* Log worker - Parse the batch being filled and hand it to the writer,
+ * then wait for the next batch of the ring to be free.
+ *
+ * If the writer stopped, 1 is returned.
+ * Otherwise, 0 is returned. */
+static int
+hand_log_batch (GLogJob * job) {
+  GLogJobs *jobs = job->jobs;
+  GJobBatch *batch = &job->batches[job->next_fill % LOG_JOB_BATCHES];
+  int abort = 0;
+
+  parse_batch (batch);
+
+  pthread_mutex_lock (&jobs->mutex);
+  batch->state = JOB_PARSED;
+  batch = &job->batches[++job->next_fill % LOG_JOB_BATCHES];
+  pthread_cond_broadcast (&jobs->cond);
+  while (!jobs->abort && batch->state != JOB_FREE)
+    pthread_cond_wait (&jobs->cond, &jobs->mutex);
+  abort = jobs->abort;
+  pthread_mutex_unlock (&jobs->mutex);
+
+  batch->len = 0;
+  batch->buflen = 0;
+
+  return abort;
+}
+
+/* Log worker - Read the log into batches of lines, parse them and hand
+ * them to the writer, then wait for the writer to store all of them.
+ *
+ * If the writer stopped, 1 is returned.
+ * Otherwise, 0 is returned. */
+static int
+queue_lines (GLineReader * lr, GLog * glog) {
+  GLogJob *job = glog->job;
+  GLogJobs *jobs = job->jobs;
+  GJobBatch *batch = &job->batches[job->next_fill % LOG_JOB_BATCHES];
+  char *line = NULL;
+  size_t len = 0;
+  int ret = 0;
+
+  while (!ret && (line = next_line (lr, &len)) != NULL) {
+    /* handle SIGINT */
+    if (conf.stop_processing)
+      break;
+    append_batch_line (batch, line, len);
+    if (batch->len < JOB_BATCH_LINES && batch->buflen < JOB_RANGE_BYTES)
+      continue;
+    ret = hand_log_batch (job);
+    batch = &job->batches[job->next_fill % LOG_JOB_BATCHES];
+  }
+  if (!ret && batch->len)
+    ret = hand_log_batch (job);
+
+  /* the writer releases the log once it stored all of its lines */
+  pthread_mutex_lock (&jobs->mutex);
+  job->eof = 1;
+  pthread_cond_broadcast (&jobs->cond);
+  while (!jobs->abort && glog->job != NULL)
+    pthread_cond_wait (&jobs->cond, &jobs->mutex);
+  ret = ret || jobs->abort;
+  pthread_mutex_unlock (&jobs->mutex);
+
+  return ret;
+}
+
 /* Read the given log file and attempt to mmap a fixed number of bytes so we
  * can compare its content on future runs.
  *
@@ -1981,8 +3339,11 @@ persist_last_parse (GLog * glog) {
  * On success, 0 is returned. */
 static int
 read_log (GLog * glog, int dry_run) {
+  GLineReader lr;
+  GDecomp dc;
+  GCompression comp = COMPRESS_NONE;
   FILE *fp = NULL;
-  int piping = 0;
+  int piping = 0, regular = 0, queued = glog->job != NULL, ret = 0;
   struct stat fdstat;
 
   /* Ensure we have a valid pipe to read from stdin. Only checking for
@@ -2002,16 +3363,49 @@ read_log (GLog * glog, int dry_run) {
     glog->inode = fdstat.st_ino;
     glog->size = glog->lp.size = fdstat.st_size;
     set_initial_persisted_data (glog, fp, glog->filename);
+    regular = S_ISREG (fdstat.st_mode);
+    comp = detect_compression (glog->snippet, glog->snippetlen);
+  }
+
+  if (comp != COMPRESS_NONE && !has_decompressor (comp))
+    FATAL ("Unable to read the %s compressed log file '%s'. Rebuild with --with-%s",
+           compression_name (comp), glog->filename, comp == COMPRESS_GZIP ? "zlib" : "zstd");
+
+  /* compressed files are decompressed on a dedicated thread while keeping
+   * the inode and snippet of the file so they can be restored */
+  if (regular && comp != COMPRESS_NONE) {
+    start_decomp (&dc, fileno (fp), comp);
+    init_line_reader (&lr, fileno (fp));
+    lr.decomp = &dc;
+    ret = queued ? queue_lines (&lr, glog) : read_lines_chunked (&lr, glog, dry_run);
+    free_line_reader (&lr);
+    stop_decomp (&dc);
+    if (dc.error)
+      FATAL ("Unable to decompress the specified log file '%s'", glog->filename);
+  }
+  /* regular files are read in large chunks, either parsed on this thread
+   * or through the parsing pipeline, unless logs are parsed concurrently */
+  else if (regular && conf.jobs > 1 && !dry_run && !queued) {
+    ret = read_lines_jobs (fileno (fp), glog);
+  } else if (regular || queued) {
+    init_line_reader (&lr, fileno (fp));
+    ret = queued ? queue_lines (&lr, glog) : read_lines_chunked (&lr, glog, dry_run);
+    free_line_reader (&lr);
+  }
+  /* pipes are read line by line */
+  else {
+    ret = read_lines (fp, glog, dry_run);
   }
 
-  /* read line by line */
-  if (read_lines (fp, glog, dry_run)) {
+  if (ret) {
     if (!piping)
       fclose (fp);
     return 1;
   }
 
-  persist_last_parse (glog);
+  /* stored by the writer when logs are parsed concurrently */
+  if (!queued)
+    persist_last_parse (glog);
 
   /* close log file if not a pipe */
   if (!piping)
@@ -2028,6 +3422,161 @@ set_log_processing (Logs * logs, GLog * glog) {
   unlock_spinner ();
 }
 
+/* Log worker - Take the next log and parse it into the batches of the
+ * worker until no logs are left. */
+static void *
+read_logs (void *ptr_data) {
+  GLogJob *job = (GLogJob *) ptr_data;
+  GLogJobs *jobs = job->jobs;
+  GLog *glog = NULL;
+  int idx, abort;
+
+  while (1) {
+    pthread_mutex_lock (&jobs->mutex);
+    idx = jobs->next++;
+    if (!(abort = jobs->abort) && idx < jobs->logs->size) {
+      glog = &jobs->logs->glog[idx];
+      glog->job = job;
+      job->eof = 0;
+      pthread_cond_broadcast (&jobs->cond);
+    }
+    pthread_mutex_unlock (&jobs->mutex);
+
+    if (abort || idx >= jobs->logs->size || read_log (glog, 0))
+      break;
+  }
+
+  return NULL;
+}
+
+/* Writer - Store the batches of the given log as they are parsed by the
+ * log worker that took it.
+ *
+ * On error, 1 is returned.
+ * On success, 0 is returned. */
+static int
+write_log (GLogJobs * jobs, GLog * glog) {
+  GLogJob *job = NULL;
+  GJobBatch *batch = NULL;
+  int ret = 0, cnt = 0, test = conf.num_tests > 0 ? 1 : 0, stop = 0;
+
+  glog->bytes = 0;
+
+  pthread_mutex_lock (&jobs->mutex);
+  while ((job = glog->job) == NULL)
+    pthread_cond_wait (&jobs->cond, &jobs->mutex);
+  pthread_mutex_unlock (&jobs->mutex);
+
+  while (!stop) {
+    pthread_mutex_lock (&jobs->mutex);
+    batch = &job->batches[job->next_write % LOG_JOB_BATCHES];
+    while (job->next_write == job->next_fill ? !job->eof : batch->state != JOB_PARSED)
+      pthread_cond_wait (&jobs->cond, &jobs->mutex);
+    if (job->next_write == job->next_fill) {
+      pthread_mutex_unlock (&jobs->mutex);
+      break;
+    }
+    pthread_mutex_unlock (&jobs->mutex);
+
+    stop = write_batch (glog, batch, &test, &cnt, &ret);
+    /* release all GLogItems of the batch at once */
+    arena_reset (&batch->arena);
+
+    pthread_mutex_lock (&jobs->mutex);
+    batch->state = JOB_FREE;
+    job->next_write++;
+    pthread_cond_broadcast (&jobs->cond);
+    pthread_mutex_unlock (&jobs->mutex);
+  }
+
+  pthread_mutex_lock (&jobs->mutex);
+  glog->job = NULL;
+  pthread_cond_broadcast (&jobs->cond);
+  pthread_mutex_unlock (&jobs->mutex);
+
+  /* fails if
+     - we're still reading the log but the test flag was still set
+     - ret flag is not 0, read_line failed
+     - reached the end of file, test flag was still set and we processed lines */
+  return (stop && test) || ret || (!stop && test && glog->processed);
+}
+
+/* Parse several logs concurrently, up to --jobs logs at once. Each one
+ * is read and parsed by a log worker, while the calling thread stores
+ * them one after another as a serial run would, i.e., a log is stored
+ * only once every log before it was stored.
+ *
+ * On error, 1 is returned.
+ * On success, 0 is returned. */
+static int
+read_logs_jobs (Logs * logs) {
+  GLogJobs jobs;
+  GLog *glog = NULL;
+  int i, j, th, ret = 0;
+
+  memset (&jobs, 0, sizeof (jobs));
+  jobs.logs = logs;
+  jobs.nworkers = MIN (conf.jobs, MAX_JOBS);
+  if (jobs.nworkers > logs->size)
+    jobs.nworkers = logs->size;
+
+  jobs.job = xcalloc (jobs.nworkers, sizeof (GLogJob));
+  for (i = 0; i < jobs.nworkers; ++i) {
+    jobs.job[i].jobs = &jobs;
+    for (j = 0; j < (int) LOG_JOB_BATCHES; ++j) {
+      jobs.job[i].batches[j].size = JOB_BATCH_LINES;
+      jobs.job[i].batches[j].lines = xmalloc (JOB_BATCH_LINES * sizeof (GJobLine));
+      jobs.job[i].batches[j].bufsize = JOB_BATCH_BYTES;
+      jobs.job[i].batches[j].buf = xmalloc (JOB_BATCH_BYTES);
+    }
+  }
+
+  if (pthread_cond_init (&(jobs.cond), NULL))
+    FATAL ("Failed init thread condition");
+
+  if (pthread_mutex_init (&(jobs.mutex), NULL))
+    FATAL ("Failed init thread mutex");
+
+  for (i = 0; i < jobs.nworkers; ++i) {
+    th = pthread_create (&(jobs.workers[i]), NULL, read_logs, &jobs.job[i]);
+    if (th)
+      FATAL ("Return code from pthread_create(): %d", th);
+  }
+
+  for (i = 0; i < logs->size && !ret && !conf.stop_processing; ++i) {
+    glog = &logs->glog[i];
+    set_log_processing (logs, glog);
+
+    if ((ret = write_log (&jobs, glog)))
+      break;
+
+    persist_last_parse (glog);
+    glog->length = glog->bytes;
+  }
+
+  pthread_mutex_lock (&jobs.mutex);
+  jobs.abort = 1;
+  pthread_cond_broadcast (&jobs.cond);
+  pthread_mutex_unlock (&jobs.mutex);
+
+  for (i = 0; i < jobs.nworkers; ++i)
+    pthread_join (jobs.workers[i], NULL);
+
+  for (i = 0; i < jobs.nworkers; ++i) {
+    for (j = 0; j < (int) LOG_JOB_BATCHES; ++j) {
+      arena_free (&jobs.job[i].batches[j].arena);
+      free (jobs.job[i].batches[j].lines);
+      free (jobs.job[i].batches[j].buf);
+    }
+  }
+  free (jobs.job);
+
+  pthread_mutex_destroy (&jobs.mutex);
+  pthread_cond_destroy (&jobs.cond);
+
+  return ret;
+}
+
 /* Entry point to parse the log line by line.
  *
  * On error, 1 is returned.
@@ -2052,6 +3601,10 @@ parse_log (Logs * logs, int dry_run) {
     return 0;
   }
 
+  /* several logs, parse up to --jobs of them at once */
+  if (conf.jobs > 1 && logs->size > 1 && !dry_run && !conf.read_stdin)
+    return read_logs_jobs (logs);
+
   for (idx = 0; idx < logs->size; ++idx) {
     glog = &logs->glog[idx];
     set_log_processing (logs, glog);
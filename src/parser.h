@@ -37,19 +37,79 @@
 #define MAX_LOG_ERRORS  20
 #define READ_BYTES      4096u
 #define MAX_BATCH_LINES 8192u   /* max number of lines to read per batch before a reflow */
+#define JOB_BATCH_LINES 1024u   /* initial number of lines per batch */
+#define JOB_BATCH_BYTES 262144u /* initial size of a batch line buffer */
+#define JOB_RANGE_BYTES 524288u /* bytes of the log per batch */
+#define LOG_JOB_BATCHES 4u      /* batches a log worker parses ahead of the writer */
+#define READ_CHUNK      1048576u        /* bytes read at once from a regular log */
+#define STATIC_EXT_LEN  32u     /* longest static extension looked up by suffix */
 
 #define LINE_LEN          23
 #define ERROR_LEN        255
 #define REF_SITE_LEN     511    /* maximum length of a referring site */
 #define CACHE_STATUS_LEN   7
-#define HASH_HEX          64
+#define DATE_TKN_LEN      64    /* longest date/time token cached */
 
 #define SPEC_TOKN_NUL    0x1
 #define SPEC_TOKN_INV    0x2
 #define SPEC_SFMT_MIS    0x3
 
+#include <limits.h>
+#include <pthread.h>
+
 #include "commons.h"
+#include "garena.h"
+#include "gdecomp.h"
 #include "gslist.h"
+#include "settings.h"
+
+/* Kind of date/time format, the common ones are parsed by hand */
+typedef enum {
+  DT_FMT_OTHER,                 /* anything else, strptime(3) */
+  DT_FMT_DMY,                   /* %d/%b/%Y */
+  DT_FMT_YMD,                   /* %Y-%m-%d */
+  DT_FMT_HMS,                   /* %T, %H:%M:%S */
+  DT_FMT_SECS,                  /* %s */
+  DT_FMT_MSECS,                 /* %* */
+  DT_FMT_USECS                  /* %f */
+} GDateFmtType;
+
+/* A date/time token and the values derived from it */
+typedef struct GDateTkn_ {
+  char tkn[DATE_TKN_LEN];       /* raw token, empty if none */
+  char date[DATE_LEN];          /* numeric date, e.g., 20210601 */
+  char time[TIME_LEN];          /* %H:%M:%S */
+  uint32_t numdate;
+  struct tm tm;
+} GDateTkn;
+
+/* Date/time values of the last lines parsed. Consecutive lines tend to
+ * share the same date and second, so they are only parsed once.
+ * Note: This is per thread, it's not synchronized */
+typedef struct GDateCache_ {
+  time_t now;                   /* second tm_now was taken */
+  struct tm tm_now;             /* local time, fills what a token lacks */
+
+  GDateTkn date;                /* last %d token */
+  GDateTkn time;                /* last %t token */
+  GDateTkn tstamp;              /* last %x token */
+
+  uint8_t has_emin:1;
+  uint8_t has_mmin:1;
+  time_t emin;                  /* epoch of the minute broken down in etm */
+  struct tm etm;
+  time_t mmin;                  /* epoch of the minute in mtm */
+  struct tm mtm;
+} GDateCache;
+
+/* Unique visitor key. A fixed-width binary key made out of the numeric
+ * date, the user agent hash and the client address. IPv4 addresses are
+ * stored as IPv4-mapped IPv6 addresses. */
+typedef struct GUniqKey_ {
+  uint32_t date;
+  uint32_t agent;
+  uint8_t host[16];
+} GUniqKey;
 
 /* Log properties. Note: This is per line parsed */
 typedef struct GLogItem_ {
@@ -71,16 +131,13 @@ typedef struct GLogItem_ {
   char *req_key;
   char *status;
   char *time;
-  char *uniq_key;
   char *vhost;
   char *userid;
   char *cache_status;
 
-  char site[REF_SITE_LEN + 1];
-  char agent_hex[HASH_HEX];
-
   uint64_t resp_size;
   uint64_t serve_time;
+  int64_t ts;
 
   uint32_t numdate;
   uint32_t agent_hash;
@@ -88,6 +145,7 @@ typedef struct GLogItem_ {
   int type_ip;
   int is_404;
   int is_static;
+  int is_excluded_ip;
   int uniq_nkey;
   int agent_nkey;
 
@@ -99,6 +157,14 @@ typedef struct GLogItem_ {
 
   char *errstr;
   struct tm dt;
+
+  GArena *arena;                /* arena the item and its strings come from */
+  GDateCache *dcache;           /* date/time cache of the parsing thread */
+
+  GUniqKey uniq_key;
+
+  /* keep this last, only its first byte is initialized */
+  char site[REF_SITE_LEN + 1];
 } GLogItem;
 
 typedef struct GLastParse_ {
@@ -127,11 +193,14 @@ typedef struct GLog_ {
 
   GLogItem *items;
   GLastParse lp;
+  GArena arena;                 /* GLogItem allocations, reset per line */
+  GDateCache dcache;            /* date/time cache of the serial parser */
 
   char *filename;
   char **errors;
 
   FILE *pipe;
+  struct GLogJob_ *job;         /* worker parsing it when logs are parsed concurrently */
 } GLog;
 
 /* Container for all logs */
@@ -145,6 +214,148 @@ typedef struct Logs_ {
   GLog *glog;
 } Logs;
 
+/* Line reader for regular files. Lines are sliced out of large chunks
+ * read from the log, or from its decompressor, without copying them */
+typedef struct GLineReader_ {
+  int fd;
+  GDecomp *decomp;              /* decompressor of a compressed log, if any */
+  uint8_t eof:1;
+  char *buf;                    /* chunk buffer, size + 1 bytes */
+  size_t size;                  /* size of the chunk buffer */
+  size_t len;                   /* bytes available in buf */
+  size_t start;                 /* offset of the next line in buf */
+  size_t held;                  /* offset of the byte replaced by a '\0' */
+  char held_chr;                /* byte replaced by a '\0' */
+} GLineReader;
+
+/* State of a batch of lines within the parsing pipeline */
+typedef enum {
+  JOB_FREE,
+  JOB_PARSING,
+  JOB_PARSED
+} GJobState;
+
+/* A line read from the log and its parsed data */
+typedef struct GJobLine_ {
+  size_t off;                   /* offset of the line within the batch buffer */
+  size_t len;                   /* length of the line as read from the log */
+  int ret;                      /* parse_line() return value, -1 soft ignore */
+  uint8_t prefiltered:1;        /* rejected by --prefilter, not parsed */
+  GLogItem *logitem;            /* parsed line */
+} GJobLine;
+
+/* The lines within a byte range of the log, read and parsed by a
+ * parser worker and then handed to the writer */
+typedef struct GJobBatch_ {
+  GJobState state;
+  uint32_t len;                 /* number of lines in the batch */
+  uint32_t size;                /* number of lines allocated */
+  size_t buflen;                /* bytes used in buf */
+  size_t bufsize;               /* bytes allocated for buf */
+  char *buf;                    /* lines stored back to back */
+  size_t rawlen;                /* bytes used in raw */
+  size_t rawsize;               /* bytes allocated for raw */
+  char *raw;                    /* bytes read from the log for the range */
+  GArena arena;                 /* GLogItem allocations, reset per batch */
+  GDateCache dcache;            /* date/time cache of the worker parsing it */
+  GJobLine *lines;
+} GJobBatch;
+
+/* Multi-threaded parsing pipeline: N readers/parsers -> single writer.
+ * The log is split into byte ranges aligned to line boundaries, each
+ * one is read and parsed by a worker into a batch */
+typedef struct GJobs_ {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;          /* signaled on every batch state change */
+  pthread_t workers[MAX_JOBS];
+  int nworkers;
+  int fd;                       /* log being read */
+
+  GJobBatch *batches;           /* ring of batches */
+  uint32_t nbatches;
+  uint64_t next_fill;           /* next byte range a worker takes */
+  uint64_t next_write;          /* next batch the writer stores */
+
+  uint8_t eof:1;                /* end of the log was reached */
+  uint8_t abort:1;              /* writer stopped early */
+} GJobs;
+
+/* A log read and parsed by a log worker into a ring of batches, which
+ * the writer stores once every log before it was stored */
+typedef struct GLogJob_ {
+  struct GLogJobs_ *jobs;
+  GJobBatch batches[LOG_JOB_BATCHES];
+  uint32_t next_fill;           /* next batch the worker parses */
+  uint32_t next_write;          /* next batch the writer stores */
+  uint8_t eof:1;                /* every line of the log was handed over */
+} GLogJob;
+
+/* Logs parsed concurrently, each worker takes the next log and parses
+ * it while the calling thread stores them one after another */
+typedef struct GLogJobs_ {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;          /* signaled on every batch state change */
+  pthread_t workers[MAX_JOBS];
+  GLogJob *job;                 /* one per worker */
+  int nworkers;
+  int next;                     /* next log a worker takes */
+  uint8_t abort:1;              /* writer stopped early */
+  Logs *logs;
+} GLogJobs;
+
+/* Type of an operation within a compiled log format */
+typedef enum {
+  FMT_OP_END,
+  FMT_OP_LITERAL,               /* skip a run of literal chars */
+  FMT_OP_SPEC,                  /* %x specifier */
+  FMT_OP_SPECIAL                /* ~x special specifier */
+} GLogFmtOpType;
+
+/* An operation within a compiled log format */
+typedef struct GLogFmtOp_ {
+  GLogFmtOpType type;
+  char spec;                    /* specifier char */
+  char end[2];                  /* delimiter following the specifier, if any */
+  int fmtspcs;                  /* %d: number of spaces within the date format */
+  uint32_t len;                 /* literal: number of chars to skip */
+  uint32_t alt;                 /* special: next op if the field was already set */
+  char *skips;                  /* special: reject set within the curly braces */
+} GLogFmtOp;
+
+/* A log format compiled into a program of operations */
+typedef struct GLogFmt_ {
+  GLogFmtOp *ops;
+  uint32_t len;                 /* number of ops */
+  uint32_t size;                /* number of ops allocated */
+  uint8_t single:1;             /* a lone specifier, e.g., a JSON value "%m" */
+} GLogFmt;
+
+/* Kind of a --prefilter expression */
+typedef enum {
+  PREFILTER_SUBSTR,             /* text: the line contains text */
+  PREFILTER_PREFIX,             /* ^text: the line starts with text */
+  PREFILTER_FIELD,              /* $N=text: the Nth field of the line is text */
+} GPrefilterType;
+
+/* A --prefilter expression run over the raw line */
+typedef struct GPrefilter_ {
+  GPrefilterType type;
+  const char *needle;
+  size_t len;                   /* length of the needle */
+  int field;                    /* field: 1-based, split on spaces/tabs */
+  uint8_t prefix:1;             /* field: text* matches the start of it */
+} GPrefilter;
+
+/* What a line has to go through given the enabled panels and options,
+ * set by compile_ingest_plan() */
+typedef struct GIngestPlan_ {
+  uint8_t specs[UCHAR_MAX + 1]; /* specifiers materialised, else read past */
+  uint8_t keyphrase:1;          /* extract the keyphrase out of the referrer */
+  uint8_t ref_site:1;           /* extract the referring site */
+  uint8_t browsers:1;           /* classify browsers on the parser workers */
+  uint8_t os:1;                 /* classify operating systems on the workers */
+} GIngestPlan;
+
 /* Raw data field type */
 typedef enum {
   U32,
@@ -178,9 +389,16 @@ int pre_process_log (GLog * glog, char *line, int dry_run);
 int set_initial_persisted_data (GLog * glog, FILE * fp, const char *fn);
 void free_logerrors (GLog * glog);
 void free_logs (Logs * logs);
+void compile_ingest_plan (void);
+void compile_log_format (void);
+void compile_prefilters (void);
+void compile_static_files (void);
+void free_log_format (void);
+void free_static_files (void);
 void free_raw_data (GRawData * raw_data);
 void output_logerrors (void);
 void reset_struct (Logs * logs);
+void set_uniq_key (GUniqKey * key, uint32_t date, const char *host, uint32_t agent);
 
 GLogItem *init_log_item (GLog * glog);
 GRawDataItem *new_grawdata_item (unsigned int size);
@@ -283,7 +283,7 @@ restore_si32 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+    if (ret == -1 || !(hash = put_hash (module, date, metric)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
@@ -314,7 +314,7 @@ migrate_si32_to_ii32 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+    if (ret == -1 || !(hash = put_hash (module, date, metric)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
@@ -327,47 +327,42 @@ migrate_si32_to_ii32 (GSMetric metric, const char *path, int module) {
   return 0;
 }
 
-static char *
-migrate_unique_key (char *key) {
-  char *nkey = NULL, *token = NULL, *ptr = NULL;
-  char agent_hex[64] = { 0 };
-  uint32_t delims = 0;
+/* Build a binary unique visitor key out of a DATE|IP|UA string key from
+ * a previous version of the database. Version 1 keys end with the whole
+ * user agent while version 2 keys end with its hash in hex.
+ *
+ * On error, or a malformed key, 1 is returned.
+ * On success, 0 is returned. */
+static int
+migrate_unique_key (GUniqKey * nkey, uint32_t date, char *key, uint32_t version) {
+  char *host = NULL, *agent = NULL;
+  uint32_t hash = 0;
 
-  if (!key || count_matches (key, '|') < 2)
-    return NULL;
+  if (!key || !(host = strchr (key, '|')) || !(agent = strchr (++host, '|')))
+    return 1;
+  *agent++ = '\0';
 
-  nkey = xstrdup ("");
-  while ((ptr = strchr (key, '|'))) {
-    if (!(token = extract_by_delim (&key, "|"))) {
-      free (nkey);
-      return NULL;
-    }
+  if (version < 2)
+    hash = djb2 ((unsigned char *) agent);
+  else
+    hash = strtoul (agent, NULL, 16);
 
-    append_str (&nkey, token);
-    append_str (&nkey, "|");
-    free (token);
-    key++;
-    delims++;
-  }
-  if (delims == 2) {
-    sprintf (agent_hex, "%" PRIx32, djb2 ((unsigned char *) key));
-    append_str (&nkey, agent_hex);
-  }
+  set_uniq_key (nkey, date, host, hash);
 
-  return nkey;
+  return 0;
 }
 
-
-/* Given a database filename, restore a string key, uint32_t value back to
- * the storage */
+/* Given a database filename, restore a DATE|IP|UA string key, uint32_t value
+ * back to the storage as a binary unique visitor key */
 static int
-migrate_si32_to_ii32_unique_keys (GSMetric metric, const char *path, int module) {
-  khash_t (si32) * hash = NULL;
+migrate_si32_to_bi32_unique_keys (GSMetric metric, const char *path, uint32_t version) {
+  khash_t (bi32) * hash = NULL;
   tpl_node *tn;
   char fmt[] = "A(iA(su))";
   int date = 0, ret = 0;
-  char *key = NULL, *nkey = NULL;
+  char *key = NULL;
   uint32_t val = 0;
+  GUniqKey nkey;
 
   if (!(tn = tpl_map (fmt, &date, &key, &val)))
     return 1;
@@ -376,14 +371,13 @@ migrate_si32_to_ii32_unique_keys (GSMetric metric, const char *path, int module)
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+    if (ret == -1 || !(hash = put_hash (-1, date, metric)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
-      if ((nkey = migrate_unique_key (key)))
-        ins_si32 (hash, nkey, val);
+      if (migrate_unique_key (&nkey, date, key, version) == 0)
+        ins_bi32 (hash, nkey, val);
       free (key);
-      free (nkey);
     }
   }
   tpl_free (tn);
@@ -391,6 +385,64 @@ migrate_si32_to_ii32_unique_keys (GSMetric metric, const char *path, int module)
   return 0;
 }
 
+/* Given a database filename, restore a GUniqKey key, uint32_t value back to
+ * the storage */
+static int
+restore_bi32 (GSMetric metric, const char *path, int module) {
+  khash_t (bi32) * hash = NULL;
+  tpl_node *tn;
+  char fmt[] = "A(iA(S(uuc#)u))";
+  int date = 0, ret = 0;
+  GUniqKey key = { 0 };
+  uint32_t val = 0;
+
+  if (!(tn = tpl_map (fmt, &date, &key, sizeof (key.host), &val)))
+    return 1;
+
+  tpl_load (tn, TPL_FILE, path);
+  while (tpl_unpack (tn, 1) > 0) {
+    if ((ret = insert_restored_date (date)) == 2)
+      continue;
+    if (ret == -1 || !(hash = put_hash (module, date, metric)))
+      break;
+
+    while (tpl_unpack (tn, 2) > 0) {
+      ins_bi32 (hash, key, val);
+    }
+  }
+  tpl_free (tn);
+
+  return 0;
+}
+
+/* Given a hash and a filename, persist to disk a GUniqKey key, uint32_t value */
+static int
+persist_bi32 (GSMetric metric, const char *path, int module) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
+  khash_t (bi32) * hash = NULL;
+  tpl_node *tn = NULL;
+  int date = 0;
+  char fmt[] = "A(iA(S(uuc#)u))";
+  GUniqKey key = { 0 };
+  uint32_t val = 0;
+
+  if (!dates || !(tn = tpl_map (fmt, &date, &key, sizeof (key.host), &val)))
+    return 1;
+
+  /* *INDENT-OFF* */
+  HT_FOREACH_KEY (dates, date, {
+    if (!(hash = get_hash (module, date, metric)))
+      continue;
+    kh_foreach (hash, key, val, { tpl_pack (tn, 2); });
+    tpl_pack (tn, 1);
+  });
+  /* *INDENT-ON* */
+  close_tpl (tn, path);
+
+  return 0;
+}
+
 /* Given a hash and a filename, persist to disk a string key, uint32_t value */
 static int
 persist_si32 (GSMetric metric, const char *path, int module) {
@@ -410,7 +462,7 @@ persist_si32 (GSMetric metric, const char *path, int module) {
   /* *INDENT-OFF* */
   HT_FOREACH_KEY (dates, date, {
     if (!(hash = get_hash (module, date, metric)))
-      return -1;
+      continue;
     kh_foreach (hash, key, val, { tpl_pack (tn, 2); });
     tpl_pack (tn, 1);
   });
@@ -424,7 +476,7 @@ persist_si32 (GSMetric metric, const char *path, int module) {
  * the storage */
 static int
 migrate_is32_to_ii08 (GSMetric metric, const char *path, int module) {
-  khash_t (ii08) * hash = NULL;
+  khash_t (igrc) * hash = NULL;
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (si08) * mtpr = get_hdb (db, MTRC_METH_PROTO);
   tpl_node *tn;
@@ -441,7 +493,7 @@ migrate_is32_to_ii08 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+    if (ret == -1 || !(hash = put_hash (module, date, MTRC_RECORDS)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
@@ -451,7 +503,7 @@ migrate_is32_to_ii08 (GSMetric metric, const char *path, int module) {
         free (val);
         continue;
       }
-      ins_ii08 (hash, key, kh_val (mtpr, k));
+      ins_igrc (hash, key, metric, kh_val (mtpr, k));
       free (val);
     }
   }
@@ -470,6 +522,8 @@ restore_is32 (GSMetric metric, const char *path, int module) {
   int date = 0, ret = 0;
   uint32_t key = 0;
   char *val = NULL, *dupval = NULL;
+  /* data and root strings belong to the intern pool */
+  int interned = metric == MTRC_DATAMAP || metric == MTRC_ROOTMAP;
 
   if (!(tn = tpl_map (fmt, &date, &key, &val)))
     return 1;
@@ -478,13 +532,17 @@ restore_is32 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+    if (ret == -1 || !(hash = put_hash (module, date, metric)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
-      dupval = xstrdup (val);
-      if (ins_is32 (hash, key, dupval) != 0)
-        free (dupval);
+      if (interned) {
+        ins_is32 (hash, key, ht_get_string (ht_insert_string (val)));
+      } else {
+        dupval = xstrdup (val);
+        if (ins_is32 (hash, key, dupval) != 0)
+          free (dupval);
+      }
       free (val);
     }
   }
@@ -511,7 +569,7 @@ persist_is32 (GSMetric metric, const char *path, int module) {
   /* *INDENT-OFF* */
   HT_FOREACH_KEY (dates, date, {
     if (!(hash = get_hash (module, date, metric)))
-      return -1;
+      continue;
     kh_foreach (hash, key, val, { tpl_pack (tn, 2); });
     tpl_pack (tn, 1);
   });
@@ -522,16 +580,16 @@ persist_is32 (GSMetric metric, const char *path, int module) {
 }
 
 
-/* Given a database filename, restore a uint32_t key, uint32_t value back to
- * the storage */
+/* Given a database filename, restore a string key, uint32_t value back to
+ * the storage, keyed by the id of the interned string */
 static int
-restore_ii08 (GSMetric metric, const char *path, int module) {
-  khash_t (ii08) * hash = NULL;
+restore_ki32 (GSMetric metric, const char *path, int module) {
+  khash_t (ii32) * hash = NULL;
   tpl_node *tn;
-  char fmt[] = "A(iA(uv))";
+  char fmt[] = "A(iA(su))";
   int date = 0, ret = 0;
-  uint32_t key = 0;
-  uint16_t val = 0;
+  char *key = NULL;
+  uint32_t val = 0;
 
   if (!(tn = tpl_map (fmt, &date, &key, &val)))
     return 1;
@@ -540,11 +598,12 @@ restore_ii08 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+    if (ret == -1 || !(hash = put_hash (module, date, metric)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
-      ins_ii08 (hash, key, val);
+      ins_ii32 (hash, ht_insert_string (key), val);
+      free (key);
     }
   }
   tpl_free (tn);
@@ -552,6 +611,38 @@ restore_ii08 (GSMetric metric, const char *path, int module) {
   return 0;
 }
 
+/* Given a hash and a filename, persist to disk the interned string of a
+ * uint32_t key, uint32_t value */
+static int
+persist_ki32 (GSMetric metric, const char *path, int module) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
+  khash_t (ii32) * hash = NULL;
+  tpl_node *tn = NULL;
+  int date = 0;
+  char fmt[] = "A(iA(su))";
+  char *str = NULL;
+  uint32_t key = 0, val = 0;
+
+  if (!dates || !(tn = tpl_map (fmt, &date, &str, &val)))
+    return 1;
+
+  /* *INDENT-OFF* */
+  HT_FOREACH_KEY (dates, date, {
+    if (!(hash = get_hash (module, date, metric)))
+      continue;
+    kh_foreach (hash, key, val, {
+      if ((str = ht_get_string (key)))
+        tpl_pack (tn, 2);
+    });
+    tpl_pack (tn, 1);
+  });
+  /* *INDENT-ON* */
+  close_tpl (tn, path);
+
+  return 0;
+}
+
 /* Given a database filename, restore a uint32_t key, uint32_t value back to
  * the storage */
 static int
@@ -569,7 +660,7 @@ restore_ii32 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+    if (ret == -1 || !(hash = put_hash (module, date, metric)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
@@ -598,7 +689,7 @@ persist_ii32 (GSMetric metric, const char *path, int module) {
   /* *INDENT-OFF* */
   HT_FOREACH_KEY (dates, date, {
     if (!(hash = get_hash (module, date, metric)))
-      return -1;
+      continue;
     kh_foreach (hash, key, val, { tpl_pack (tn, 2); });
     tpl_pack (tn, 1);
   });
@@ -608,26 +699,89 @@ persist_ii32 (GSMetric metric, const char *path, int module) {
   return 0;
 }
 
-/* Given a hash and a filename, persist to disk a uint32_t key, uint32_t value */
+/* Map a tpl node for a single metric of a record given the type of
+ * database file the metric is stored on.
+ *
+ * On error, or unknown type, NULL is returned.
+ * On success, the tpl node is returned */
+static tpl_node *
+map_igrc (GSMetricType type, int *date, uint32_t * key, uint32_t * u32, uint64_t * u64,
+          uint16_t * u08) {
+  char fmt_ii32[] = "A(iA(uu))";
+  char fmt_iu64[] = "A(iA(uU))";
+  char fmt_ii08[] = "A(iA(uv))";
+
+  switch (type) {
+  case MTRC_TYPE_II32:
+    return tpl_map (fmt_ii32, date, key, u32);
+  case MTRC_TYPE_IU64:
+    return tpl_map (fmt_iu64, date, key, u64);
+  case MTRC_TYPE_II08:
+    return tpl_map (fmt_ii08, date, key, u08);
+  default:
+    return NULL;
+  }
+}
+
+/* Given a database filename, restore a single metric of a record (uint32_t
+ * key, numeric value) back to the storage */
+static int
+restore_igrc (GKHashMetric mtrc, const char *path, int module) {
+  khash_t (igrc) * hash = NULL;
+  tpl_node *tn;
+  int date = 0, ret = 0;
+  uint32_t key = 0, u32 = 0;
+  uint64_t u64 = 0;
+  uint16_t u08 = 0;
+
+  if (!(tn = map_igrc (mtrc.type, &date, &key, &u32, &u64, &u08)))
+    return 1;
+
+  tpl_load (tn, TPL_FILE, path);
+  while (tpl_unpack (tn, 1) > 0) {
+    if ((ret = insert_restored_date (date)) == 2)
+      continue;
+    if (ret == -1 || !(hash = put_hash (module, date, MTRC_RECORDS)))
+      break;
+
+    while (tpl_unpack (tn, 2) > 0) {
+      ins_igrc (hash, key, mtrc.metric.storem, mtrc.type == MTRC_TYPE_IU64 ? u64 :
+                mtrc.type == MTRC_TYPE_II32 ? u32 : u08);
+    }
+  }
+  tpl_free (tn);
+
+  return 0;
+}
+
+/* Given a hash and a filename, persist to disk a single metric of a record
+ * (uint32_t key, numeric value). Metrics not set on a record are skipped */
 static int
-persist_ii08 (GSMetric metric, const char *path, int module) {
+persist_igrc (GKHashMetric mtrc, const char *path, int module) {
   GKDB *db = get_db_instance (DB_INSTANCE);
   khash_t (igkh) * dates = get_hdb (db, MTRC_DATES);
-  khash_t (ii08) * hash = NULL;
+  khash_t (igrc) * hash = NULL;
+  GKeyRecord record;
   tpl_node *tn = NULL;
   int date = 0;
-  char fmt[] = "A(iA(uv))";
-  uint32_t key = 0;
-  uint16_t val = 0;
+  uint32_t key = 0, u32 = 0;
+  uint64_t u64 = 0;
+  uint16_t u08 = 0;
 
-  if (!dates || !(tn = tpl_map (fmt, &date, &key, &val)))
+  if (!dates || !(tn = map_igrc (mtrc.type, &date, &key, &u32, &u64, &u08)))
     return 1;
 
   /* *INDENT-OFF* */
   HT_FOREACH_KEY (dates, date, {
-    if (!(hash = get_hash (module, date, metric)))
-      return -1;
-    kh_foreach (hash, key, val, { tpl_pack (tn, 2); });
+    if (!(hash = get_hash (module, date, MTRC_RECORDS)))
+      continue;
+    kh_foreach (hash, key, record, {
+      if (!(u64 = get_igrc_field (&record, mtrc.metric.storem)))
+        continue;
+      u32 = u64;
+      u08 = u64;
+      tpl_pack (tn, 2);
+    });
     tpl_pack (tn, 1);
   });
   /* *INDENT-ON* */
@@ -654,7 +808,7 @@ restore_u648 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+    if (ret == -1 || !(hash = put_hash (module, date, metric)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
@@ -684,7 +838,7 @@ persist_u648 (GSMetric metric, const char *path, int module) {
   /* *INDENT-OFF* */
   HT_FOREACH_KEY (dates, date, {
     if (!(hash = get_hash (module, date, metric)))
-      return -1;
+      continue;
     kh_foreach (hash, key, val, { tpl_pack (tn, 2); });
     tpl_pack (tn, 1);
   });
@@ -712,7 +866,7 @@ restore_iu64 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+    if (ret == -1 || !(hash = put_hash (module, date, metric)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
@@ -742,7 +896,7 @@ persist_iu64 (GSMetric metric, const char *path, int module) {
   /* *INDENT-OFF* */
   HT_FOREACH_KEY (dates, date, {
     if (!(hash = get_hash (module, date, metric)))
-      return -1;
+      continue;
     kh_foreach (hash, key, val, { tpl_pack (tn, 2); });
     tpl_pack (tn, 1);
   });
@@ -770,7 +924,7 @@ restore_su64 (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+    if (ret == -1 || !(hash = put_hash (module, date, metric)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
@@ -801,7 +955,7 @@ persist_su64 (GSMetric metric, const char *path, int module) {
   /* *INDENT-OFF* */
   HT_FOREACH_KEY (dates, date, {
     if (!(hash = get_hash (module, date, metric)))
-      return -1;
+      continue;
     kh_foreach (hash, key, val, { tpl_pack (tn, 2); });
     tpl_pack (tn, 1);
   });
@@ -828,7 +982,7 @@ restore_igsl (GSMetric metric, const char *path, int module) {
   while (tpl_unpack (tn, 1) > 0) {
     if ((ret = insert_restored_date (date)) == 2)
       continue;
-    if (ret == -1 || !(hash = get_hash (module, date, metric)))
+    if (ret == -1 || !(hash = put_hash (module, date, metric)))
       break;
 
     while (tpl_unpack (tn, 2) > 0) {
@@ -858,7 +1012,7 @@ persist_igsl (GSMetric metric, const char *path, int module) {
   /* *INDENT-OFF* */
   HT_FOREACH_KEY (dates, date, {
     if (!(hash = get_hash (module, date, metric)))
-      return -1;
+      continue;
     kh_foreach (hash, key, node, {
       while (node) {
         val = (*(uint32_t *) node->data);
@@ -901,12 +1055,15 @@ restore_by_type (GKHashMetric mtrc, const char *fn, int module) {
   case MTRC_TYPE_SI32:
     restore_si32 (mtrc.metric.storem, path, module);
     break;
+  case MTRC_TYPE_BI32:
+    restore_bi32 (mtrc.metric.storem, path, module);
+    break;
+  case MTRC_TYPE_KI32:
+    restore_ki32 (mtrc.metric.storem, path, module);
+    break;
   case MTRC_TYPE_IS32:
     restore_is32 (mtrc.metric.storem, path, module);
     break;
-  case MTRC_TYPE_II08:
-    restore_ii08 (mtrc.metric.storem, path, module);
-    break;
   case MTRC_TYPE_II32:
     restore_ii32 (mtrc.metric.storem, path, module);
     break;
@@ -929,16 +1086,157 @@ clean:
   free (path);
 }
 
+/* Entry function to restore each of the metrics of a record from its own
+ * database file */
+static void
+restore_record_metrics (GModule module) {
+  char *fn = NULL, *path = NULL;
+  size_t i;
+
+  for (i = 0; i < record_metrics_len; ++i) {
+    fn = get_filename (module, record_metrics[i]);
+    if ((path = check_restore_path (fn)))
+      restore_igrc (record_metrics[i], path, module);
+    free (path);
+    free (fn);
+  }
+}
+
 /* Entry function to restore hash data by metric type */
 static void
 restore_metric_type (GModule module, GKHashMetric mtrc) {
   char *fn = NULL;
 
+  if (mtrc.type == MTRC_TYPE_IGRC) {
+    restore_record_metrics (module);
+    return;
+  }
+
   fn = get_filename (module, mtrc);
   restore_by_type (mtrc, fn, module);
   free (fn);
 }
 
+/* Load the string values of a data or root map database file into the
+ * given hash regardless of their date. Keymap values are unique across
+ * dates, so are the keys of these maps. */
+static void
+load_migration_strings (khash_t (is32) * hash, const char *modstr, const char *mtrstr) {
+  tpl_node *tn;
+  char fmt[] = "A(iA(us))";
+  char *fn = build_filename ("IS32", modstr, mtrstr), *path = NULL, *val = NULL;
+  int date = 0;
+  uint32_t key = 0;
+
+  if (!(path = check_restore_path (fn)) || !(tn = tpl_map (fmt, &date, &key, &val))) {
+    free (fn);
+    free (path);
+    return;
+  }
+
+  tpl_load (tn, TPL_FILE, path);
+  while (tpl_unpack (tn, 1) > 0) {
+    while (tpl_unpack (tn, 2) > 0) {
+      if (ins_is32 (hash, key, val) != 0)
+        free (val);
+    }
+  }
+  tpl_free (tn);
+  free (path);
+  free (fn);
+}
+
+/* Find the request key whose hash is the given one out of the request and
+ * the methods and protocols seen. The request key may have the method
+ * and the protocol appended.
+ *
+ * If no key matches, NULL is returned.
+ * On success, the matching key is returned. */
+static char *
+find_hashed_req_key (const char *req, uint32_t hash) {
+  GKDB *db = get_db_instance (DB_INSTANCE);
+  khash_t (si08) * meth_proto = get_hdb (db, MTRC_METH_PROTO);
+  const char *mp[256] = { "" };
+  char *key = NULL;
+  khint_t k;
+  size_t i, j, n = 1;
+
+  for (k = kh_begin (meth_proto); k != kh_end (meth_proto) && n < 256; ++k) {
+    if (kh_exist (meth_proto, k))
+      mp[n++] = kh_key (meth_proto, k);
+  }
+
+  for (i = 0; i < n; ++i) {
+    for (j = 0; j < n; ++j) {
+      key = xmalloc (snprintf (NULL, 0, "%s%s%s%s%s", req, *mp[i] ? "|" : "", mp[i],
+                               *mp[j] ? "|" : "", mp[j]) + 1);
+      sprintf (key, "%s%s%s%s%s", req, *mp[i] ? "|" : "", mp[i], *mp[j] ? "|" : "", mp[j]);
+      if (djb2 ((unsigned char *) key) == hash)
+        return key;
+      free (key);
+    }
+  }
+
+  return NULL;
+}
+
+/* Given a database filename, restore a keymap keyed by the hash of the
+ * string keys (versions 2 and 3) back to the storage keyed by the id of
+ * the interned strings. The string keys are recovered from the data and
+ * root maps of the same module. Keys that can't be recovered are
+ * dropped. */
+static int
+migrate_ii32_to_ki32 (GSMetric metric, const char *path, int module, const char *modstr) {
+  khash_t (is32) * strs = kh_init (is32);
+  khash_t (ii32) * hash = NULL;
+  tpl_node *tn;
+  char fmt[] = "A(iA(uu))";
+  char *str = NULL, *key = NULL;
+  int date = 0, ret = 0;
+  uint32_t hkey = 0, val = 0;
+  khint_t k;
+
+  load_migration_strings (strs, modstr, "MTRC_DATAMAP");
+  load_migration_strings (strs, modstr, "MTRC_ROOTMAP");
+
+  if (!(tn = tpl_map (fmt, &date, &hkey, &val))) {
+    ret = 1;
+    goto clean;
+  }
+
+  tpl_load (tn, TPL_FILE, path);
+  while (tpl_unpack (tn, 1) > 0) {
+    if ((ret = insert_restored_date (date)) == 2)
+      continue;
+    if (ret == -1 || !(hash = put_hash (module, date, metric)))
+      break;
+
+    while (tpl_unpack (tn, 2) > 0) {
+      if ((k = kh_get (is32, strs, val)) == kh_end (strs))
+        continue;
+      str = kh_val (strs, k);
+      if (djb2 ((unsigned char *) str) == hkey)
+        ins_ii32 (hash, ht_insert_string (str), val);
+      else if ((module == REQUESTS || module == REQUESTS_STATIC || module == NOT_FOUND) &&
+               (key = find_hashed_req_key (str, hkey))) {
+        ins_ii32 (hash, ht_insert_string (key), val);
+        free (key);
+      }
+    }
+  }
+  tpl_free (tn);
+  ret = 0;
+
+clean:
+  for (k = kh_begin (strs); k != kh_end (strs); ++k) {
+    if (kh_exist (strs, k))
+      free (kh_val (strs, k));
+  }
+  kh_destroy (is32, strs);
+
+  return ret;
+}
+
 static int
 migrate_metric (GModule module, GKHashMetric mtrc) {
   GKDB *db = get_db_instance (DB_INSTANCE);
@@ -947,18 +1245,26 @@ migrate_metric (GModule module, GKHashMetric mtrc) {
   int ret = 0;
   char *fn = NULL, *path = NULL;
   char *modstr = NULL, *mtrstr = NULL;
+  uint32_t version = 1;
+  size_t i;
   khint_t k;
 
   k = kh_get (si32, db_props, "version");
   /* db is up-to-date, thus no need to migrate anything */
   if (k != kh_end (db_props) && kh_val (db_props, k) == DB_VERSION)
     return 0;
+  if (k != kh_end (db_props))
+    version = kh_val (db_props, k);
 
   switch (mtrc.metric.storem) {
+  case MTRC_RECORDS:
+    for (i = 0; i < record_metrics_len; ++i)
+      ret += migrate_metric (module, record_metrics[i]);
+    break;
   case MTRC_UNIQUE_KEYS:
     if (!(path = check_restore_path ("SI32_UNIQUE_KEYS.db")))
       break;
-    if (migrate_si32_to_ii32_unique_keys (mtrc.metric.storem, path, -1) != 0)
+    if (migrate_si32_to_bi32_unique_keys (mtrc.metric.storem, path, version) != 0)
       break;
     unlink (path);
     ret++;
@@ -966,10 +1272,21 @@ migrate_metric (GModule module, GKHashMetric mtrc) {
   case MTRC_KEYMAP:
     if (!(modstr = get_module_str (module)))
       FATAL ("Unable to allocate module name.");
+    /* version 1 kept the string keys, as they are kept now */
     fn = build_filename ("SI32", modstr, "MTRC_KEYMAP");
+    if ((path = check_restore_path (fn))) {
+      if (restore_ki32 (mtrc.metric.storem, path, module) != 0)
+        break;
+      unlink (path);
+      ret++;
+      break;
+    }
+    /* versions 2 and 3 kept the hash of the string keys */
+    free (fn);
+    fn = build_filename ("II32", modstr, "MTRC_KEYMAP");
     if (!(path = check_restore_path (fn)))
       break;
-    if (migrate_si32_to_ii32 (mtrc.metric.storem, path, module) != 0)
+    if (migrate_ii32_to_ki32 (mtrc.metric.storem, path, module, modstr) != 0)
       break;
     unlink (path);
     ret++;
@@ -1062,6 +1379,68 @@ restore_dates (void) {
   free (path);
 }
 
+/* Restore the reverse DNS lookups from our last run into the given
+ * cache, keeping the time they were resolved so expired ones are
+ * refreshed later on. */
+void
+restore_hostnames (khash_t (sdns) * hash) {
+  tpl_node *tn;
+  char *path = NULL, *ip = NULL, *host = NULL;
+  char fmt[] = "A(ssI)";
+  int64_t resolved = 0;
+  khint_t k;
+  int ret;
+
+  if (!hash || !(path = check_restore_path ("SDNS_HOSTNAMES.db")))
+    return;
+
+  tn = tpl_map (fmt, &ip, &host, &resolved);
+  tpl_load (tn, TPL_FILE, path);
+  while (tpl_unpack (tn, 1) > 0) {
+    k = kh_put (sdns, hash, ip, &ret);
+    if (ret <= 0) {
+      free (ip);
+      free (host);
+      continue;
+    }
+    kh_val (hash, k).host = host;
+    kh_val (hash, k).resolved = (time_t) resolved;
+    kh_val (hash, k).failed = 0;
+  }
+  tpl_free (tn);
+  free (path);
+}
+
+/* Persist to disk the successful reverse DNS lookups of the given cache
+ * along with the time they were resolved. Failed lookups are retried on
+ * the next run instead. */
+void
+persist_hostnames (khash_t (sdns) * hash) {
+  tpl_node *tn;
+  khint_t k;
+  char *path = NULL;
+  const char *ip = NULL, *host = NULL;
+  char fmt[] = "A(ssI)";
+  int64_t resolved = 0;
+
+  if (!hash || kh_size (hash) == 0 || !(path = set_db_path ("SDNS_HOSTNAMES.db")))
+    return;
+
+  tn = tpl_map (fmt, &ip, &host, &resolved);
+  for (k = 0; k < kh_end (hash); ++k) {
+    if (!kh_exist (hash, k) || kh_val (hash, k).failed || !kh_val (hash, k).host)
+      continue;
+    ip = kh_key (hash, k);
+    host = kh_val (hash, k).host;
+    resolved = kh_val (hash, k).resolved;
+    tpl_pack (tn, 1);
+  }
+  tpl_dump (tn, TPL_FILE, path);
+
+  tpl_free (tn);
+  free (path);
+}
+
 /* Entry function to restore a global hashes */
 static void
 restore_global (void) {
@@ -1135,15 +1514,18 @@ persist_by_type (GKHashMetric mtrc, const char *fn, int module) {
   case MTRC_TYPE_SI32:
     persist_si32 (mtrc.metric.storem, path, module);
     break;
+  case MTRC_TYPE_BI32:
+    persist_bi32 (mtrc.metric.storem, path, module);
+    break;
+  case MTRC_TYPE_KI32:
+    persist_ki32 (mtrc.metric.storem, path, module);
+    break;
   case MTRC_TYPE_IS32:
     persist_is32 (mtrc.metric.storem, path, module);
     break;
   case MTRC_TYPE_II32:
     persist_ii32 (mtrc.metric.storem, path, module);
     break;
-  case MTRC_TYPE_II08:
-    persist_ii08 (mtrc.metric.storem, path, module);
-    break;
   case MTRC_TYPE_U648:
     persist_u648 (mtrc.metric.storem, path, module);
     break;
@@ -1162,9 +1544,31 @@ persist_by_type (GKHashMetric mtrc, const char *fn, int module) {
   free (path);
 }
 
+/* Entry function to persist each of the metrics of a record to its own
+ * database file */
+static void
+persist_record_metrics (GModule module) {
+  char *fn = NULL, *path = NULL;
+  size_t i;
+
+  for (i = 0; i < record_metrics_len; ++i) {
+    fn = get_filename (module, record_metrics[i]);
+    path = set_db_path (fn);
+    persist_igrc (record_metrics[i], path, module);
+    free (path);
+    free (fn);
+  }
+}
+
 static void
 persist_metric_type (GModule module, GKHashMetric mtrc) {
   char *fn = NULL;
+
+  if (mtrc.type == MTRC_TYPE_IGRC) {
+    persist_record_metrics (module);
+    return;
+  }
+
   fn = get_filename (module, mtrc);
   persist_by_type (mtrc, fn, module);
   free (fn);
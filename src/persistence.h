@@ -30,7 +30,11 @@
 #ifndef PERSISTENCE_H_INCLUDED
 #define PERSISTENCE_H_INCLUDED
 
+#include "gkhash.h"
+
+void persist_hostnames (khash_t (sdns) * hash);
 void restore_data (void);
+void restore_hostnames (khash_t (sdns) * hash);
 void persist_data (void);
 void free_persisted_data (void);
 
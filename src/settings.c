@@ -224,6 +224,7 @@ free_formats (void) {
   free (conf.spec_date_time_format);
   free (conf.spec_date_time_num_format);
   free (conf.time_format);
+  free_log_format ();
 }
 
 /* Clean malloc'd command line arguments. */
@@ -843,6 +844,8 @@ set_spec_date_format (void) {
     set_spec_date_time_num_format ();
     set_spec_date_time_format ();
   }
+
+  compile_log_format ();
 }
 
 /* Attempt to set the date format given a command line option
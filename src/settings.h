@@ -41,6 +41,8 @@
 #define MAX_IGNORE_STATUS      64
 #define MAX_OUTFORMATS          3
 #define MAX_FILENAMES        3072
+#define MAX_JOBS               64
+#define MAX_PREFILTERS         16
 #define MIN_DATENUM_FMT_LEN     7
 #define NO_CONFIG_FILE "No config file used"
 
@@ -102,6 +104,7 @@ typedef struct GConf_
   const char *ignore_referers[MAX_IGNORE_REF];  /* referrers to ignore */
   const char *ignore_status[MAX_IGNORE_STATUS]; /* status to ignore */
   const char *output_formats[MAX_OUTFORMATS];   /* output format, e.g. , HTML */
+  const char *prefilters[MAX_PREFILTERS];       /* raw line filters */
   const char *sort_panels[TOTAL_MODULES];       /* sorting options for each panel */
   const char *static_files[MAX_EXTENSIONS];     /* static extensions */
 
@@ -126,6 +129,7 @@ typedef struct GConf_
   const char *pidfile;              /* daemonize pid file path */
   const char *browsers_file;        /* browser's file path */
   const char *db_path;              /* db path to files */
+  const char *dns_hosts_file;       /* hosts file used as the resolver */
 
   /* HTML real-time */
   const char *addr;                 /* IP address to bind to */
@@ -179,6 +183,8 @@ typedef struct GConf_
   int restore;                      /* reload data from db-path */
   int skip_term_resolver;           /* no terminal resolver */
   int is_json_log_format;           /* is a json log format */
+  int jobs;                         /* number of parser worker threads */
+  int dns_threads;                  /* number of resolver threads */
   uint32_t keep_last;               /* number of days to keep in storage */
   uint32_t num_tests;               /* number of lines to test */
   uint64_t html_refresh;            /* refresh html report every X of seconds */
@@ -205,6 +211,7 @@ typedef struct GConf_
   int ignore_referer_idx;           /* ignored referrers index */
   int ignore_status_idx;            /* ignore status index */
   int output_format_idx;            /* output format index */
+  int prefilter_idx;                /* raw line filters index */
   int sort_panel_idx;               /* sort panel index */
   int static_file_idx;              /* static extensions index */
   int browsers_hash_idx;            /* browsers hash index */
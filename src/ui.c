@@ -424,6 +424,14 @@ get_str_excluded_ips (void) {
   return u642str (ht_get_excluded_ips (), 0);
 }
 
+/* Convert the number of lines rejected by --prefilter to a string.
+ *
+ * On success, the number of prefiltered lines as a string is returned. */
+static char *
+get_str_prefiltered (void) {
+  return u642str (ht_get_prefiltered (), 0);
+}
+
 /* Convert the number of failed requests to a string.
  *
  * On success, the number of failed requests as a string is returned. */
@@ -658,6 +666,7 @@ display_general (WINDOW * win, GHolder * h) {
     {T_EXCLUDE_IP      , get_str_excluded_ips ()   , colorlbl , colorval , 0} ,
     {T_UNIQUE404       , get_str_notfound_reqs ()  , colorlbl , colorval , 0} ,
     {T_BW              , get_str_bandwidth ()      , colorlbl , colorval , 0} ,
+    {T_PREFILTERED     , get_str_prefiltered ()    , colorlbl , colorval , 0} ,
     {T_LOG_PATH        , get_str_logfile ()        , colorlbl , colorpth , 1}
   };
   /* *INDENT-ON* */
@@ -666,6 +675,12 @@ display_general (WINDOW * win, GHolder * h) {
   render_overall_header (win, h);
 
   n = ARRAY_SIZE (fields);
+  /* prefiltered lines are only shown if lines are prefiltered */
+  if (conf.prefilter_idx == 0) {
+    free (fields[n - 2].value);
+    fields[n - 2] = fields[n - 1];
+    n--;
+  }
   render_overall_statistics (win, fields, n);
 
   for (i = 0; i < n; i++) {
@@ -871,7 +886,7 @@ load_host_agents (const char *addr) {
   GAgents *agents = NULL;
   GSLList *keys = NULL, *list = NULL;
   void *data = NULL;
-  uint32_t items = 4, key = djb2 ((unsigned char *) addr);
+  uint32_t items = 4, key = ht_get_string_id (addr);
 
   keys = ht_get_keymap_list_from_key (HOSTS, key);
   if (!keys)
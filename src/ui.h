@@ -95,6 +95,7 @@
 #define OVERALL_VISITORS  "unique_visitors"
 #define OVERALL_FILES     "unique_files"
 #define OVERALL_EXCL_HITS "excluded_hits"
+#define OVERALL_PREFILTER "prefiltered_requests"
 #define OVERALL_REF       "unique_referrers"
 #define OVERALL_NOTFOUND  "unique_not_found"
 #define OVERALL_STATIC    "unique_static_files"
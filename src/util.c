@@ -55,6 +55,7 @@
 #include "util.h"
 
 #include "error.h"
+#include "gwcset.h"
 #include "labels.h"
 #include "xmalloc.h"
 
@@ -227,31 +228,55 @@ djb2 (unsigned char *str) {
   return hash;
 }
 
-/* String matching where one string contains wildcard characters.
- *
- * If no match found, 1 is returned.
- * If match found, 0 is returned. */
-static int
-wc_match (const char *wc, char *str) {
-  while (*wc && *str) {
-    if (*wc == '*') {
-      while (*wc && *wc == '*')
-        wc++;
-      if (!*wc)
-        return 1;
-
-      while (*str && *str != *wc)
-        str++;
-    } else if (*wc == '?' || *wc == *str) {
-      wc++;
-      str++;
-    } else {
-      break;
-    }
+/* 64-bit FNV-1a hash of a string */
+#if defined(__clang__) && defined(__clang_major__) && (__clang_major__ >= 4)
+__attribute__((no_sanitize ("unsigned-integer-overflow")))
+#endif
+  uint64_t
+fnv1a64 (const char *str) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  const unsigned char *p = (const unsigned char *) str;
+
+  while (*p) {
+    hash ^= *p++;
+    hash *= 0x100000001b3ULL;
   }
-  if (!*wc && !*str)
-    return 1;
-  return 0;
+
+  return hash;
+}
+
+/* Referrers to ignore and to hide, compiled from their wildcards */
+static GWCSet ignore_refs;
+static GWCSet hide_refs;
+static int refs_compiled = 0;
+
+/* Compile the wildcards of the referrers to ignore and to hide into a
+ * matcher each, so that a referrer is matched in a single pass
+ * regardless of the number of patterns. */
+void
+compile_referers (void) {
+  int i;
+
+  free_referers ();
+  wcset_init (&ignore_refs);
+  wcset_init (&hide_refs);
+
+  for (i = 0; i < conf.ignore_referer_idx; ++i)
+    wcset_add (&ignore_refs, conf.ignore_referers[i]);
+  for (i = 0; i < conf.hide_referer_idx; ++i)
+    wcset_add (&hide_refs, conf.hide_referers[i]);
+  refs_compiled = 1;
+}
+
+/* Free the compiled referrers to ignore and to hide. */
+void
+free_referers (void) {
+  if (!refs_compiled)
+    return;
+
+  wcset_free (&ignore_refs);
+  wcset_free (&hide_refs);
+  refs_compiled = 0;
 }
 
 /* Determine if the given host needs to be ignored given the list of
@@ -261,28 +286,12 @@ wc_match (const char *wc, char *str) {
  * On success, or if the host needs to be ignored, 1 is returned */
 int
 ignore_referer (const char *host) {
-  char *needle = NULL;
-  int i, ignore = 0;
-
-  if (conf.ignore_referer_idx == 0)
+  if (conf.ignore_referer_idx == 0 || !refs_compiled)
     return 0;
   if (host == NULL || *host == '\0')
     return 0;
 
-  needle = xstrdup (host);
-  for (i = 0; i < conf.ignore_referer_idx; ++i) {
-    if (conf.ignore_referers[i] == NULL || *conf.ignore_referers[i] == '\0')
-      continue;
-
-    if (wc_match (conf.ignore_referers[i], needle)) {
-      ignore = 1;
-      goto out;
-    }
-  }
-out:
-  free (needle);
-
-  return ignore;
+  return wcset_match (&ignore_refs, host);
 }
 
 /* Determine if the given host needs to be hidden given the list of
@@ -292,64 +301,248 @@ out:
  * On success, or if the host needs to be ignored, 1 is returned */
 int
 hide_referer (const char *host) {
-  char *needle = NULL;
-  int i, ignore = 0;
-
-  if (conf.hide_referer_idx == 0)
+  if (conf.hide_referer_idx == 0 || !refs_compiled)
     return 0;
   if (host == NULL || *host == '\0')
     return 0;
 
-  needle = xstrdup (host);
-  for (i = 0; i < conf.hide_referer_idx; ++i) {
-    if (conf.hide_referers[i] == NULL || *conf.hide_referers[i] == '\0')
-      continue;
+  return wcset_match (&hide_refs, host);
+}
 
-    if (wc_match (conf.hide_referers[i], needle)) {
-      ignore = 1;
-      goto out;
-    }
+/* An interval of IPv4 addresses, in host byte order */
+typedef struct GIPv4Range_ {
+  uint32_t lo;
+  uint32_t hi;
+} GIPv4Range;
+
+/* An interval of IPv6 addresses, in network byte order */
+typedef struct GIPv6Range_ {
+  unsigned char lo[16];
+  unsigned char hi[16];
+} GIPv6Range;
+
+/* The IPs to exclude, parsed once into sorted and merged intervals.
+ * Rules that aren't IPs are compared as they are */
+static struct {
+  GIPv4Range *v4;
+  int v4len;
+  GIPv6Range *v6;
+  int v6len;
+  const char **names;
+  int nameslen;
+} ip_ranges;
+
+/* Compare two IPv4 intervals by their lower bound. */
+static int
+cmp_ipv4_range (const void *a, const void *b) {
+  const GIPv4Range *ra = a, *rb = b;
+  return ra->lo < rb->lo ? -1 : ra->lo > rb->lo;
+}
+
+/* Compare two IPv6 intervals by their lower bound. */
+static int
+cmp_ipv6_range (const void *a, const void *b) {
+  const GIPv6Range *ra = a, *rb = b;
+  return memcmp (ra->lo, rb->lo, 16);
+}
+
+/* Apply a CIDR prefix length to an address of the given number of
+ * bytes, setting lo to the first address and hi to the last one.
+ *
+ * On error, i.e., invalid prefix length, 1 is returned.
+ * On success, 0 is returned. */
+static int
+cidr_to_range (unsigned char *lo, unsigned char *hi, int bytes, const char *prefix) {
+  char *sEnd = NULL;
+  long bits = 0;
+  int i, keep = 0;
+
+  errno = 0;
+  bits = strtol (prefix, &sEnd, 10);
+  if (prefix == sEnd || *sEnd != '\0' || errno == ERANGE || bits < 0 || bits > bytes * 8)
+    return 1;
+
+  for (i = 0; i < bytes; ++i) {
+    keep = bits >= 8 ? 8 : (int) bits;
+    bits -= keep;
+    lo[i] &= (unsigned char) (0xff << (8 - keep));
+    hi[i] = lo[i] | (unsigned char) (0xff >> keep);
   }
-out:
-  free (needle);
 
-  return ignore;
+  return 0;
 }
 
-/* Determine if the given ip is within a range of IPs.
+/* Parse a single exclusion rule, i.e., an IP, a range of IPs
+ * "start-end" or a CIDR block "ip/len", into an interval of addresses.
  *
- * On error, or not within the range, 0 is returned
- * On success, or if within the range, 1 is returned */
+ * If not an IP rule, AF_UNSPEC is returned.
+ * Otherwise, the address family of the interval is returned. */
 static int
-within_range (const char *ip, const char *start, const char *end) {
-  struct in6_addr addr6, start6, end6;
-  struct in_addr addr4, start4, end4;
+parse_ip_rule (const char *rule, unsigned char *lo, unsigned char *hi) {
+  char *start = xstrdup (rule), *end = NULL, *cidr = NULL;
+  int af = AF_INET, bytes = 4;
+
+  if ((end = strchr (start, '-')) != NULL)
+    *end++ = '\0';
+  else if ((cidr = strchr (start, '/')) != NULL)
+    *cidr++ = '\0';
+
+  if (1 != inet_pton (af, start, lo)) {
+    af = AF_INET6;
+    bytes = 16;
+    if (1 != inet_pton (af, start, lo))
+      goto out;
+  }
 
-  if (start == NULL || *start == '\0')
-    return 0;
-  if (end == NULL || *end == '\0')
-    return 0;
-  if (ip == NULL || *ip == '\0')
-    return 0;
+  /* range, both ends of the same family */
+  if (end != NULL && 1 != inet_pton (af, end, hi))
+    af = -1;
+  /* CIDR block */
+  else if (cidr != NULL && cidr_to_range (lo, hi, bytes, cidr))
+    af = -1;
+  /* single IP */
+  else if (end == NULL && cidr == NULL)
+    memcpy (hi, lo, bytes);
 
-  /* IPv4 */
-  if (1 == inet_pton (AF_INET, ip, &addr4)) {
-    if (1 != inet_pton (AF_INET, start, &start4))
-      return 0;
-    if (1 != inet_pton (AF_INET, end, &end4))
-      return 0;
-    if (memcmp (&addr4, &start4, sizeof (addr4)) >= 0 &&
-        memcmp (&addr4, &end4, sizeof (addr4)) <= 0)
+  free (start);
+  return af;
+
+out:
+  free (start);
+  return end == NULL && cidr == NULL ? AF_UNSPEC : -1;
+}
+
+/* Merge overlapping and adjacent IPv4 intervals, once sorted. */
+static void
+merge_ipv4_ranges (void) {
+  GIPv4Range *r = ip_ranges.v4;
+  int i, n = 0;
+
+  if (ip_ranges.v4len == 0)
+    return;
+
+  qsort (r, ip_ranges.v4len, sizeof (GIPv4Range), cmp_ipv4_range);
+  for (i = 1; i < ip_ranges.v4len; ++i) {
+    if (r[n].hi == UINT32_MAX || r[i].lo <= r[n].hi + 1) {
+      if (r[i].hi > r[n].hi)
+        r[n].hi = r[i].hi;
+      continue;
+    }
+    r[++n] = r[i];
+  }
+  ip_ranges.v4len = n + 1;
+}
+
+/* Merge overlapping IPv6 intervals, once sorted. */
+static void
+merge_ipv6_ranges (void) {
+  GIPv6Range *r = ip_ranges.v6;
+  int i, n = 0;
+
+  if (ip_ranges.v6len == 0)
+    return;
+
+  qsort (r, ip_ranges.v6len, sizeof (GIPv6Range), cmp_ipv6_range);
+  for (i = 1; i < ip_ranges.v6len; ++i) {
+    if (memcmp (r[i].lo, r[n].hi, 16) <= 0) {
+      if (memcmp (r[i].hi, r[n].hi, 16) > 0)
+        memcpy (r[n].hi, r[i].hi, 16);
+      continue;
+    }
+    r[++n] = r[i];
+  }
+  ip_ranges.v6len = n + 1;
+}
+
+/* Parse all the IPs to exclude into sorted intervals so that each line
+ * is looked up in logarithmic time regardless of the number of rules.
+ * Ranges whose ends aren't of the same family, or where the start is
+ * greater than the end, never match. */
+void
+compile_ip_ranges (void) {
+  unsigned char lo[16], hi[16];
+  int i, af;
+
+  free_ip_ranges ();
+  if (conf.ignore_ip_idx == 0)
+    return;
+
+  ip_ranges.v4 = xcalloc (conf.ignore_ip_idx, sizeof (GIPv4Range));
+  ip_ranges.v6 = xcalloc (conf.ignore_ip_idx, sizeof (GIPv6Range));
+  ip_ranges.names = xcalloc (conf.ignore_ip_idx, sizeof (char *));
+
+  for (i = 0; i < conf.ignore_ip_idx; ++i) {
+    if (conf.ignore_ips[i] == NULL || *conf.ignore_ips[i] == '\0')
+      continue;
+
+    af = parse_ip_rule (conf.ignore_ips[i], lo, hi);
+    if (af == AF_INET) {
+      GIPv4Range *r = &ip_ranges.v4[ip_ranges.v4len];
+      r->lo = ((uint32_t) lo[0] << 24) | (lo[1] << 16) | (lo[2] << 8) | lo[3];
+      r->hi = ((uint32_t) hi[0] << 24) | (hi[1] << 16) | (hi[2] << 8) | hi[3];
+      if (r->lo <= r->hi)
+        ip_ranges.v4len++;
+    } else if (af == AF_INET6) {
+      GIPv6Range *r = &ip_ranges.v6[ip_ranges.v6len];
+      memcpy (r->lo, lo, 16);
+      memcpy (r->hi, hi, 16);
+      if (memcmp (r->lo, r->hi, 16) <= 0)
+        ip_ranges.v6len++;
+    } else if (af == AF_UNSPEC) {
+      ip_ranges.names[ip_ranges.nameslen++] = conf.ignore_ips[i];
+    }
+  }
+
+  merge_ipv4_ranges ();
+  merge_ipv6_ranges ();
+}
+
+/* Free the parsed IPs to exclude. */
+void
+free_ip_ranges (void) {
+  free (ip_ranges.v4);
+  free (ip_ranges.v6);
+  free (ip_ranges.names);
+  memset (&ip_ranges, 0, sizeof (ip_ranges));
+}
+
+/* Determine if the given IPv4 address, in host byte order, is within
+ * the IPv4 intervals.
+ *
+ * If not within an interval, 0 is returned.
+ * If within an interval, 1 is returned. */
+static int
+ipv4_in_ranges (uint32_t ip) {
+  int lo = 0, hi = ip_ranges.v4len - 1, mid;
+
+  while (lo <= hi) {
+    mid = lo + (hi - lo) / 2;
+    if (ip < ip_ranges.v4[mid].lo)
+      hi = mid - 1;
+    else if (ip > ip_ranges.v4[mid].hi)
+      lo = mid + 1;
+    else
       return 1;
   }
-  /* IPv6 */
-  else if (1 == inet_pton (AF_INET6, ip, &addr6)) {
-    if (1 != inet_pton (AF_INET6, start, &start6))
-      return 0;
-    if (1 != inet_pton (AF_INET6, end, &end6))
-      return 0;
-    if (memcmp (&addr6, &start6, sizeof (addr6)) >= 0 &&
-        memcmp (&addr6, &end6, sizeof (addr6)) <= 0)
+
+  return 0;
+}
+
+/* Determine if the given IPv6 address is within the IPv6 intervals.
+ *
+ * If not within an interval, 0 is returned.
+ * If within an interval, 1 is returned. */
+static int
+ipv6_in_ranges (const unsigned char *ip) {
+  int lo = 0, hi = ip_ranges.v6len - 1, mid;
+
+  while (lo <= hi) {
+    mid = lo + (hi - lo) / 2;
+    if (memcmp (ip, ip_ranges.v6[mid].lo, 16) < 0)
+      hi = mid - 1;
+    else if (memcmp (ip, ip_ranges.v6[mid].hi, 16) > 0)
+      lo = mid + 1;
+    else
       return 1;
   }
 
@@ -363,36 +556,24 @@ within_range (const char *ip, const char *start, const char *end) {
  * On success, or if within the range, 1 is returned */
 int
 ip_in_range (const char *ip) {
-  char *start, *end, *dash;
+  struct in6_addr addr6;
+  struct in_addr addr4;
   int i;
 
-  for (i = 0; i < conf.ignore_ip_idx; ++i) {
-    end = NULL;
-    if (conf.ignore_ips[i] == NULL || *conf.ignore_ips[i] == '\0')
-      continue;
+  if (ip == NULL || *ip == '\0')
+    return 0;
 
-    start = xstrdup (conf.ignore_ips[i]);
-    /* split range */
-    if ((dash = strchr (start, '-')) != NULL) {
-      *dash = '\0';
-      end = dash + 1;
-    }
+  /* a single inet_pton() given the family the IP looks like */
+  if (strchr (ip, ':') == NULL) {
+    if (ip_ranges.v4len && 1 == inet_pton (AF_INET, ip, &addr4))
+      return ipv4_in_ranges (ntohl (addr4.s_addr));
+  } else if (ip_ranges.v6len && 1 == inet_pton (AF_INET6, ip, &addr6)) {
+    return ipv6_in_ranges (addr6.s6_addr);
+  }
 
-    /* matches single IP */
-    if (end == NULL) {
-      if (strcmp (ip, start) == 0) {
-        free (start);
-        return 1;
-      }
-    }
-    /* within range */
-    else {
-      if (within_range (ip, start, end)) {
-        free (start);
-        return 1;
-      }
-    }
-    free (start);
+  for (i = 0; i < ip_ranges.nameslen; ++i) {
+    if (strcmp (ip, ip_ranges.names[i]) == 0)
+      return 1;
   }
 
   return 0;
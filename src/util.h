@@ -101,6 +101,11 @@ off_t file_size (const char *filename);
 size_t append_str (char **dest, const char *src);
 uint32_t djb2(unsigned char *str);
 uint32_t ip_to_binary (const char *ip);
+uint64_t fnv1a64 (const char *str);
+void compile_ip_ranges (void);
+void compile_referers (void);
+void free_ip_ranges (void);
+void free_referers (void);
 void genstr(char *dest, size_t len);
 void strip_newlines (char *str);
 void xstrncpy (char *dest, const char *source, const size_t dest_size);
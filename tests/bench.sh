@@ -0,0 +1,83 @@
+#!/usr/bin/env sh
+# Benchmark a goaccess binary over a generated log, e.g., to compare the
+# builds before and after a change. The log is the same on every run.
+#
+#   tests/bench.sh alloc [goaccess] [lines]  allocator calls per line
+#   tests/bench.sh json [goaccess] [lines]   lines/sec of a JSON log
+set -o nounset   ## set -u : exit the script if you try to use an uninitialised variable
+set -o errexit   ## set -e : exit the script if any statement returns a non-true return value
+
+mode=${1:-"alloc"}
+goaccess=${2:-"./goaccess"}
+srcdir=$(dirname "$0")
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+# JSON log format matching gen_log json
+JSON_FORMAT='{"time":"%dT%t","host":"%h","request":{"method":"%m","uri":"%U","protocol":"%H"},"status":"%s","size":"%b","referer":"%R","ua":"%u"}'
+
+# Write a log of the given number of lines to stdout, either combined or
+# json.
+gen_log() {
+  awk -v lines="$1" -v json="$([ "$2" = json ] && echo 1 || echo 0)" 'BEGIN {
+    seed = 1
+    split("GET GET GET POST HEAD", methods)
+    split("200 200 200 304 404 500", codes)
+    split("-|https://www.google.com/|https://example.com/blog/|https://t.co/abc", refs, "|")
+    agents[1] = "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/118.0.0.0 Safari/537.36"
+    agents[2] = "Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) AppleWebKit/605.1.15 (KHTML, like Gecko) Version/17.0 Safari/605.1.15"
+    agents[3] = "Mozilla/5.0 (X11; Ubuntu; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/118.0"
+    agents[4] = "Mozilla/5.0 (iPhone; CPU iPhone OS 17_0 like Mac OS X) AppleWebKit/605.1.15 (KHTML, like Gecko) Version/17.0 Mobile/15E148 Safari/604.1"
+    agents[5] = "Mozilla/5.0 (Linux; Android 13; SM-S908B) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/118.0.0.0 Mobile Safari/537.36"
+    agents[6] = "Mozilla/5.0 (compatible; Googlebot/2.1; +http://www.google.com/bot.html)"
+    agents[7] = "curl/8.4.0"
+    for (i = 0; i < lines; i++) {
+      # Park-Miller, exact within awk doubles
+      seed = (seed * 16807) % 2147483647; r = seed
+      day = 1 + int(i * 28 / lines)
+      if (json) {
+        printf "{\"time\":\"2021-03-%02dT%02d:%02d:%02d\",\"host\":\"10.%d.%d.%d\",", day, int(r / 7) % 24, int(r / 11) % 60, int(r / 13) % 60, r % 4, int(r / 4) % 250, int(r / 1000) % 250
+        printf "\"request\":{\"method\":\"%s\",\"uri\":\"/page/%d?id=%d\",\"protocol\":\"HTTP/1.1\"},", methods[1 + r % 5], int(r / 17) % 500, int(r / 19) % 1000
+        printf "\"status\":\"%s\",\"size\":\"%d\",", codes[1 + int(r / 23) % 6], int(r / 29) % 50000
+        printf "\"referer\":\"%s\",\"ua\":\"%s\"}\n", refs[1 + int(r / 31) % 4], agents[1 + int(r / 37) % 7]
+        continue
+      }
+      printf "10.%d.%d.%d - - [%02d/Mar/2021:%02d:%02d:%02d +0000] ", r % 4, int(r / 4) % 250, int(r / 1000) % 250, day, int(r / 7) % 24, int(r / 11) % 60, int(r / 13) % 60
+      printf "\"%s /page/%d?id=%d HTTP/1.1\" %s %d ", methods[1 + r % 5], int(r / 17) % 500, int(r / 19) % 1000, codes[1 + int(r / 23) % 6], int(r / 29) % 50000
+      printf "\"%s\" \"%s\"\n", refs[1 + int(r / 31) % 4], agents[1 + int(r / 37) % 7]
+    }
+  }'
+}
+
+case "$mode" in
+alloc)
+  lines=${3:-20000}
+  gen_log "$lines" combined > "$tmp/access.log"
+  cc -O2 -shared -fPIC -o "$tmp/malloc-count.so" "$srcdir/malloc-count.c" -ldl
+  MALLOC_COUNT="$tmp/count" LD_PRELOAD="$tmp/malloc-count.so" \
+    "$goaccess" "$tmp/access.log" --log-format=COMBINED -o "$tmp/report.json" --no-progress < /dev/null
+  awk -v lines="$lines" '{
+    calls = $2 + $4 + $6
+    printf "%d lines: %d malloc, %d calloc, %d realloc, %d free\n", lines, $2, $4, $6, $8
+    printf "%d allocations, %.1f per line\n", calls, calls / lines
+  }' "$tmp/count"
+  ;;
+json)
+  lines=${3:-1000000}
+  gen_log "$lines" json > "$tmp/access.log"
+  # best of three runs
+  best=
+  for run in 1 2 3; do
+    start=$(date +%s.%N)
+    "$goaccess" "$tmp/access.log" --log-format="$JSON_FORMAT" --date-format=%Y-%m-%d \
+      --time-format=%T -o "$tmp/report.json" --no-progress < /dev/null
+    end=$(date +%s.%N)
+    best=$(echo "$start $end $best" | awk '{ t = $2 - $1; print ($3 == "" || t < $3) ? t : $3 }')
+  done
+  echo "$lines $best" | awk '{ printf "%d lines: %.2fs, %.0f lines/s\n", $1, $2, $1 / $2 }'
+  ;;
+*)
+  echo "Usage: $0 alloc|json [goaccess] [lines]" >&2
+  exit 1
+  ;;
+esac
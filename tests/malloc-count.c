@@ -0,0 +1,119 @@
+/**
+ * malloc-count.c -- count allocator calls of a program, through LD_PRELOAD
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* dlsym() may allocate before calloc() is resolved */
+#define BOOT_SIZE 4096
+
+static void *(*real_malloc) (size_t);
+static void *(*real_calloc) (size_t, size_t);
+static void *(*real_realloc) (void *, size_t);
+static void (*real_free) (void *);
+
+static unsigned long n_malloc, n_calloc, n_realloc, n_free;
+static char boot[BOOT_SIZE];
+static size_t boot_len;
+
+/* Resolve the allocator this library stands in front of. */
+static void
+init (void) {
+  real_malloc = dlsym (RTLD_NEXT, "malloc");
+  real_calloc = dlsym (RTLD_NEXT, "calloc");
+  real_realloc = dlsym (RTLD_NEXT, "realloc");
+  real_free = dlsym (RTLD_NEXT, "free");
+}
+
+void *
+malloc (size_t size) {
+  if (real_malloc == NULL)
+    init ();
+  __atomic_add_fetch (&n_malloc, 1, __ATOMIC_RELAXED);
+
+  return real_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size) {
+  void *ptr = NULL;
+
+  /* called from dlsym() within init() */
+  if (real_calloc == NULL) {
+    size = (nmemb * size + 15) & ~(size_t) 15;
+    if (boot_len + size > BOOT_SIZE)
+      return NULL;
+    ptr = boot + boot_len;
+    boot_len += size;
+    return ptr;
+  }
+  __atomic_add_fetch (&n_calloc, 1, __ATOMIC_RELAXED);
+
+  return real_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size) {
+  if (real_realloc == NULL)
+    init ();
+  __atomic_add_fetch (&n_realloc, 1, __ATOMIC_RELAXED);
+
+  return real_realloc (ptr, size);
+}
+
+void
+free (void *ptr) {
+  if (ptr == NULL || ((char *) ptr >= boot && (char *) ptr < boot + BOOT_SIZE))
+    return;
+  if (real_free == NULL)
+    init ();
+  __atomic_add_fetch (&n_free, 1, __ATOMIC_RELAXED);
+
+  real_free (ptr);
+}
+
+/* Write the counters to the file named by MALLOC_COUNT, or stderr. */
+__attribute__((destructor))
+static void
+report (void) {
+  const char *path = getenv ("MALLOC_COUNT");
+  FILE *fp = path ? fopen (path, "w") : stderr;
+
+  if (fp == NULL)
+    return;
+  fprintf (fp, "malloc %lu calloc %lu realloc %lu free %lu\n", n_malloc, n_calloc,
+           n_realloc, n_free);
+  if (fp != stderr)
+    fclose (fp);
+}
@@ -0,0 +1,192 @@
+/**
+ * test-agents.c -- classify a corpus of user agents against golden results
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "browsers.h"
+#include "opesys.h"
+#include "settings.h"
+#include "ui.h"
+#include "xmalloc.h"
+
+#define AGENTS_FILE "tests/agents.tsv"
+#define AGENT_LINE  4096
+/* browser, browser type, OS, OS type, --real-os OS, agent */
+#define AGENT_COLS  6
+
+/* otherwise defined by goaccess.c */
+GConf conf = { 0 };
+GSpinner *parsing_spinner;
+
+/* Classify the given user agent the way the storage does, each
+ * classifier working on its own copy of the agent. The returned
+ * strings are malloc'd. */
+static void
+classify (const char *agent, char **cols) {
+  char btype[BROWSER_TYPE_LEN] = "", otype[OPESYS_TYPE_LEN] = "";
+  char rtype[OPESYS_TYPE_LEN] = "", *str = NULL;
+
+  str = xstrdup (agent);
+  cols[0] = verify_browser (str, btype);
+  cols[1] = xstrdup (btype);
+  free (str);
+
+  conf.real_os = 0;
+  str = xstrdup (agent);
+  cols[2] = verify_os (str, otype);
+  cols[3] = xstrdup (otype);
+  free (str);
+
+  conf.real_os = 1;
+  str = xstrdup (agent);
+  cols[4] = verify_os (str, rtype);
+  free (str);
+  conf.real_os = 0;
+}
+
+/* Print the classification of each agent read from stdin, one line per
+ * agent in the format of the golden file. */
+static void
+print_agents (void) {
+  char line[AGENT_LINE], *cols[AGENT_COLS - 1];
+  int i;
+
+  while (fgets (line, sizeof (line), stdin) != NULL) {
+    line[strcspn (line, "\r\n")] = '\0';
+    if (*line == '\0')
+      continue;
+
+    classify (line, cols);
+    for (i = 0; i < AGENT_COLS - 1; ++i) {
+      printf ("%s\t", cols[i] ? cols[i] : "");
+      free (cols[i]);
+    }
+    printf ("%s\n", line);
+  }
+}
+
+/* Split a line of the golden file into its columns, in place.
+ *
+ * On error, 1 is returned.
+ * On success, 0 is returned. */
+static int
+split_line (char *line, char **cols) {
+  int i;
+
+  for (i = 0; i < AGENT_COLS - 1; ++i) {
+    cols[i] = line;
+    if ((line = strchr (line, '\t')) == NULL)
+      return 1;
+    *line++ = '\0';
+  }
+  cols[i] = line;
+
+  return 0;
+}
+
+/* Classify each agent of the golden file and compare the results.
+ *
+ * On error, the number of mismatches is returned.
+ * On success, 0 is returned. */
+static int
+check_agents (const char *path) {
+  static const char *names[] = { "browser", "browser type", "os", "os type", "real os" };
+  char line[AGENT_LINE], *want[AGENT_COLS], *got[AGENT_COLS - 1];
+  FILE *fp = NULL;
+  int i, n = 0, agents = 0, failed = 0;
+
+  if ((fp = fopen (path, "r")) == NULL) {
+    fprintf (stderr, "Unable to open %s: %s\n", path, strerror (errno));
+    return 1;
+  }
+
+  while (fgets (line, sizeof (line), fp) != NULL) {
+    n++;
+    line[strcspn (line, "\r\n")] = '\0';
+    if (*line == '\0' || *line == '#')
+      continue;
+    if (split_line (line, want)) {
+      fprintf (stderr, "%s:%d: expected %d columns\n", path, n, AGENT_COLS);
+      failed++;
+      continue;
+    }
+
+    agents++;
+    classify (want[AGENT_COLS - 1], got);
+    for (i = 0; i < AGENT_COLS - 1; ++i) {
+      if (strcmp (got[i] ? got[i] : "", want[i]) != 0) {
+        fprintf (stderr, "%s:%d: %s '%s', expected '%s'\n", path, n, names[i],
+                 got[i] ? got[i] : "", want[i]);
+        failed++;
+      }
+      free (got[i]);
+    }
+  }
+  fclose (fp);
+
+  if (agents == 0) {
+    fprintf (stderr, "%s: no agents\n", path);
+    failed++;
+  }
+
+  return failed;
+}
+
+/* Check the golden file, or with -p, print the classification of the
+ * agents given on stdin to extend it. */
+int
+main (int argc, char **argv) {
+  const char *srcdir = getenv ("srcdir");
+  char path[AGENT_LINE];
+  int failed = 0;
+
+  parse_browsers_file ();
+  compile_os ();
+
+  if (argc > 1 && strcmp (argv[1], "-p") == 0) {
+    print_agents ();
+  } else {
+    snprintf (path, sizeof (path), "%s/%s", srcdir ? srcdir : ".", AGENTS_FILE);
+    if ((failed = check_agents (path)))
+      fprintf (stderr, "test-agents: %d failures\n", failed);
+  }
+
+  free_os ();
+  free_browsers_hash ();
+
+  return failed ? 1 : 0;
+}
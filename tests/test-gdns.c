@@ -0,0 +1,253 @@
+/**
+ * test-gdns.c -- exercise the resolver pool through a hosts file
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* the cache and the resolver are internal to gdns.c */
+#include "gdns.c"
+
+#include "ui.h"
+
+#define CHECK(cond)                                                     \
+  do {                                                                  \
+    if (!(cond)) {                                                      \
+      fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+               #cond);                                                  \
+      failed++;                                                         \
+    }                                                                   \
+  } while (0)
+
+/* otherwise defined by goaccess.c */
+GConf conf = { 0 };
+GSpinner *parsing_spinner;
+int active_gdns = 0;
+
+static int failed = 0;
+/* lookups that reached the hosts file */
+static int lookups = 0;
+
+/* Count the lookups done through the hosts file resolver.
+ *
+ * If not found, host is set to the error message and 1 is returned.
+ * On success, host is set to the hostname and 0 is returned. */
+static int
+count_hosts_file (const char *ip, char **host) {
+  pthread_mutex_lock (&gdns_thread.mutex);
+  lookups++;
+  pthread_mutex_unlock (&gdns_thread.mutex);
+
+  return resolve_hosts_file (ip, host);
+}
+
+/* Check the cached hostname of the given IP address. */
+static int
+has_hostname (const char *ip, const char *want) {
+  char *host = gdns_get_hostname (ip);
+  int ret = host != NULL && strcmp (host, want) == 0;
+
+  if (!ret)
+    fprintf (stderr, "%s: '%s', expected '%s'\n", ip, host ? host : "(null)", want);
+  free (host);
+
+  return ret;
+}
+
+/* Move the lookup of the given IP address back in time. */
+static void
+age_dns_entry (const char *ip, time_t secs) {
+  GDnsEntry *entry = NULL;
+
+  pthread_mutex_lock (&gdns_thread.mutex);
+  if ((entry = get_dns_entry (ip)) != NULL)
+    entry->resolved -= secs;
+  pthread_mutex_unlock (&gdns_thread.mutex);
+}
+
+/* Add an address to the loaded hosts file. */
+static void
+add_host (const char *ip, const char *name) {
+  khint_t k;
+  int ret;
+
+  pthread_mutex_lock (&gdns_thread.mutex);
+  k = kh_put (ss32, gdns_hosts, ip, &ret);
+  kh_key (gdns_hosts, k) = xstrdup (ip);
+  kh_val (gdns_hosts, k) = xstrdup (name);
+  pthread_mutex_unlock (&gdns_thread.mutex);
+}
+
+/* Queue each address of the given list, duplicates included, before
+ * any resolver thread runs, then let the pool drain the queue. */
+static void
+test_dedup (void) {
+  GDnsStats st;
+  static char ips[][16] = { "10.0.0.1", "10.0.0.2", "10.0.0.1", "10.0.0.3", "10.0.0.2", "10.0.0.1" };
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (ips); ++i)
+    dns_resolver (ips[i]);
+
+  gdns_stats (&st);
+  CHECK (st.queued == 3);
+  CHECK (st.pending == 3);
+  CHECK (gqueue_size (gdns_queue) == 3);
+
+  gdns_thread_create ();
+  gdns_wait ();
+
+  gdns_stats (&st);
+  CHECK (gqueue_empty (gdns_queue));
+  CHECK (gdns_inflight == 0);
+  CHECK (kh_size (gdns_pending) == 0);
+  CHECK (st.resolved == 2);
+  CHECK (st.failed == 1);
+  CHECK (lookups == 3);
+  CHECK (has_hostname ("10.0.0.1", "one.example"));
+  CHECK (has_hostname ("10.0.0.2", "two.example"));
+
+  /* resolved addresses are not queued again */
+  gdns_prefetch ("10.0.0.1");
+  gdns_prefetch ("10.0.0.3");
+  gdns_wait ();
+  gdns_stats (&st);
+  CHECK (st.queued == 3);
+  CHECK (st.cached == 2);
+  CHECK (lookups == 3);
+}
+
+/* A failed lookup is retried once DNS_NEGATIVE_TTL has passed, while a
+ * hostname is kept for DNS_POSITIVE_TTL. */
+static void
+test_negative_ttl (void) {
+  GDnsStats st;
+  char *host = NULL;
+
+  /* the address can now be resolved, but its failure is still fresh */
+  add_host ("10.0.0.3", "three.example");
+  age_dns_entry ("10.0.0.3", DNS_NEGATIVE_TTL - 10);
+  gdns_prefetch ("10.0.0.3");
+  gdns_wait ();
+  gdns_stats (&st);
+  CHECK (st.queued == 3);
+  CHECK (lookups == 3);
+
+  /* expired, the stale failure is returned while it is retried */
+  age_dns_entry ("10.0.0.3", 20);
+  host = gdns_get_hostname ("10.0.0.3");
+  CHECK (host != NULL && strcmp (host, "three.example") != 0);
+  free (host);
+  gdns_wait ();
+
+  gdns_stats (&st);
+  CHECK (st.stale == 1);
+  CHECK (st.queued == 4);
+  CHECK (st.resolved == 3);
+  CHECK (lookups == 4);
+  CHECK (has_hostname ("10.0.0.3", "three.example"));
+
+  /* a hostname as old as the negative TTL is still fresh */
+  age_dns_entry ("10.0.0.1", DNS_NEGATIVE_TTL + 10);
+  gdns_prefetch ("10.0.0.1");
+  gdns_wait ();
+  gdns_stats (&st);
+  CHECK (st.queued == 4);
+  CHECK (lookups == 4);
+
+  /* until it reaches the positive TTL */
+  age_dns_entry ("10.0.0.1", DNS_POSITIVE_TTL);
+  gdns_prefetch ("10.0.0.1");
+  gdns_wait ();
+  gdns_stats (&st);
+  CHECK (st.queued == 5);
+  CHECK (lookups == 5);
+  CHECK (has_hostname ("10.0.0.1", "one.example"));
+}
+
+/* gdns_wait() returns only once every queued address is resolved, more
+ * addresses than resolver threads. */
+static void
+test_wait (void) {
+  GDnsStats st;
+  char ip[INET6_ADDRSTRLEN];
+  int i;
+
+  for (i = 0; i < 200; ++i) {
+    snprintf (ip, sizeof (ip), "10.0.1.%d", i);
+    gdns_prefetch (ip);
+  }
+  gdns_wait ();
+
+  pthread_mutex_lock (&gdns_thread.mutex);
+  CHECK (gqueue_empty (gdns_queue));
+  CHECK (gdns_inflight == 0);
+  CHECK (kh_size (gdns_pending) == 0);
+  pthread_mutex_unlock (&gdns_thread.mutex);
+
+  gdns_stats (&st);
+  CHECK (st.queued == 205);
+  CHECK (lookups == 205);
+  CHECK (st.failed == 201);
+  CHECK (st.dropped == 0);
+}
+
+int
+main (void) {
+  char path[] = "/tmp/goaccess-hostsXXXXXX";
+  FILE *fp = NULL;
+  int fd;
+
+  if ((fd = mkstemp (path)) == -1 || (fp = fdopen (fd, "w")) == NULL) {
+    fprintf (stderr, "Unable to create the hosts file: %s\n", strerror (errno));
+    return 1;
+  }
+  fprintf (fp, "# hosts\n10.0.0.1 one.example one\n10.0.0.2\ttwo.example\n");
+  fclose (fp);
+
+  conf.dns_hosts_file = path;
+  conf.dns_threads = 2;
+  gdns_init ();
+  unlink (path);
+  gdns_resolver = count_hosts_file;
+
+  test_dedup ();
+  test_negative_ttl ();
+  test_wait ();
+
+  pthread_mutex_lock (&gdns_thread.mutex);
+  active_gdns = 0;
+  gdns_free_queue ();
+  gdns_free_cache ();
+  pthread_mutex_unlock (&gdns_thread.mutex);
+
+  if (failed) {
+    fprintf (stderr, "test-gdns: %d failures\n", failed);
+    return 1;
+  }
+
+  return 0;
+}
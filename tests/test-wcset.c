@@ -0,0 +1,268 @@
+/**
+ * test-wcset.c -- compare the wildcard set against wc_match()
+ *    ______      ___
+ *   / ____/___  /   | _____________  __________
+ *  / / __/ __ \/ /| |/ ___/ ___/ _ \/ ___/ ___/
+ * / /_/ / /_/ / ___ / /__/ /__/  __(__  |__  )
+ * \____/\____/_/  |_\___/\___/\___/____/____/
+ *
+ * The MIT License (MIT)
+ * Copyright (c) 2009-2020 Gerardo Orellana <hello @ goaccess.io>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gwcset.h"
+#include "settings.h"
+
+/* Number of random pattern sets, and strings tried against each. */
+#define RND_SETS    20000
+#define RND_STRINGS 200
+#define MAX_SET     8
+
+GConf conf = { 0 };
+
+/* Patterns run through both matchers, and whether each string must
+ * match the set. */
+typedef struct WCCase_ {
+  const char *patterns[4];
+  const char *str;
+  int match;
+} WCCase;
+
+static const WCCase cases[] = {
+  /* plain */
+  {{"example.com"}, "example.com", 1},
+  {{"example.com"}, "www.example.com", 0},
+  {{"example.com"}, "example.co", 0},
+  /* prefix */
+  {{"www.*"}, "www.example.com", 1},
+  {{"www.*"}, "www.", 0},
+  {{"www.*"}, "ww.example.com", 0},
+  /* suffix */
+  {{"*.com"}, "example.com", 1},
+  {{"*.com"}, "a.b.com", 0},
+  {{"*.com"}, ".com", 1},
+  {{"*.com"}, "example.org", 0},
+  /* both */
+  {{"*google*"}, "www.google.com", 1},
+  {{"*google*"}, "google", 0},
+  {{"*google*"}, "www.google", 0},
+  {{"*goo*"}, "a.gxgoo.com", 0},
+  /* multiple stars, `?` and lone star */
+  {{"**.com"}, "example.com", 1},
+  {{"*.*.com"}, "www.example.com", 1},
+  {{"w?w.*"}, "wxw.example.com", 1},
+  {{"*"}, "anything", 1},
+  {{"*"}, "", 0},
+  /* several shapes in one set */
+  {{"foo", "bar*", "*baz", "*qux*"}, "bar.com", 1},
+  {{"foo", "bar*", "*baz", "*qux*"}, "a.baz", 1},
+  {{"foo", "bar*", "*baz", "*qux*"}, "a.qux.b", 1},
+  {{"foo", "bar*", "*baz", "*qux*"}, "foo.com", 0},
+};
+
+/* The per-pattern matcher used by ignore_referer() and hide_referer()
+ * before the patterns were compiled into a set.
+ *
+ * If it does not match, 0 is returned.
+ * If it matches, 1 is returned. */
+static int
+wc_match (const char *wc, const char *str) {
+  while (*wc && *str) {
+    if (*wc == '*') {
+      while (*wc && *wc == '*')
+        wc++;
+      if (!*wc)
+        return 1;
+      while (*str && *str != *wc)
+        str++;
+    } else if (*wc == '?' || *wc == *str) {
+      wc++;
+      str++;
+    } else {
+      break;
+    }
+  }
+  if (!*wc && !*str)
+    return 1;
+  return 0;
+}
+
+/* Run the given string against each pattern, as ignore_referer() and
+ * hide_referer() used to, skipping empty patterns and strings.
+ *
+ * If no pattern matches, 0 is returned.
+ * If a pattern matches, 1 is returned. */
+static int
+wc_match_any (char **patterns, int n, const char *str) {
+  int i;
+
+  if (*str == '\0')
+    return 0;
+
+  for (i = 0; i < n; ++i) {
+    if (*patterns[i] == '\0')
+      continue;
+    if (wc_match (patterns[i], str))
+      return 1;
+  }
+
+  return 0;
+}
+
+/* A small deterministic generator, so failures can be reproduced. */
+static uint32_t
+rnd (uint32_t * seed) {
+  *seed = *seed * 1103515245u + 12345u;
+  return (*seed >> 16) & 0x7fff;
+}
+
+/* Fill buf with a random string of up to max characters out of the
+ * given alphabet. */
+static void
+rnd_string (uint32_t * seed, char *buf, int max, const char *alphabet) {
+  int i, len = rnd (seed) % (max + 1), n = strlen (alphabet);
+
+  for (i = 0; i < len; ++i)
+    buf[i] = alphabet[rnd (seed) % n];
+  buf[len] = '\0';
+}
+
+/* Fill buf with a random pattern, plain, `lit*`, `*lit`, `*lit*` or
+ * anything out of literals, stars and `?`. */
+static void
+rnd_pattern (uint32_t * seed, char *buf) {
+  char lit[8];
+
+  rnd_string (seed, lit, 4, "ab.");
+  switch (rnd (seed) % 5) {
+  case 0:
+    sprintf (buf, "%s", lit);
+    break;
+  case 1:
+    sprintf (buf, "%s*", lit);
+    break;
+  case 2:
+    sprintf (buf, "*%s", lit);
+    break;
+  case 3:
+    sprintf (buf, "*%s*", lit);
+    break;
+  default:
+    rnd_string (seed, buf, 6, "ab.*?");
+  }
+}
+
+/* Check the hand-written cases against both matchers.
+ *
+ * On error, the number of failed cases is returned.
+ * On success, 0 is returned. */
+static int
+test_cases (void) {
+  GWCSet set;
+  char *pats[4];
+  int i, n, set_m, wc_m, failed = 0;
+
+  for (i = 0; i < (int) (sizeof (cases) / sizeof (cases[0])); ++i) {
+    wcset_init (&set);
+    for (n = 0; n < 4 && cases[i].patterns[n]; ++n) {
+      pats[n] = (char *) cases[i].patterns[n];
+      wcset_add (&set, pats[n]);
+    }
+
+    set_m = wcset_match (&set, cases[i].str);
+    wc_m = wc_match_any (pats, n, cases[i].str);
+    if (set_m != cases[i].match || wc_m != cases[i].match) {
+      fprintf (stderr, "case %d: '%s' expected %d, set %d, wc_match %d\n", i,
+               cases[i].str, cases[i].match, set_m, wc_m);
+      failed++;
+    }
+    wcset_free (&set);
+  }
+
+  return failed;
+}
+
+/* Compare both matchers over random pattern sets and strings.
+ *
+ * On error, the number of mismatches is returned.
+ * On success, 0 is returned. */
+static int
+test_random (void) {
+  GWCSet set;
+  char *pats[MAX_SET], str[16];
+  uint32_t seed = 1;
+  int i, j, k, n, set_m, wc_m, failed = 0;
+
+  for (i = 0; i < MAX_SET; ++i)
+    pats[i] = malloc (16);
+
+  for (i = 0; i < RND_SETS && failed < 10; ++i) {
+    n = 1 + rnd (&seed) % MAX_SET;
+    wcset_init (&set);
+    for (j = 0; j < n; ++j) {
+      rnd_pattern (&seed, pats[j]);
+      wcset_add (&set, pats[j]);
+    }
+
+    for (k = 0; k < RND_STRINGS; ++k) {
+      rnd_string (&seed, str, 10, "ab.");
+      set_m = wcset_match (&set, str);
+      wc_m = wc_match_any (pats, n, str);
+      if (set_m == wc_m)
+        continue;
+
+      fprintf (stderr, "'%s': set %d, wc_match %d, patterns:", str, set_m, wc_m);
+      for (j = 0; j < n; ++j)
+        fprintf (stderr, " '%s'", pats[j]);
+      fprintf (stderr, "\n");
+      failed++;
+    }
+    wcset_free (&set);
+  }
+
+  for (i = 0; i < MAX_SET; ++i)
+    free (pats[i]);
+
+  return failed;
+}
+
+int
+main (void) {
+  int failed = 0;
+
+  failed += test_cases ();
+  failed += test_random ();
+  if (failed) {
+    fprintf (stderr, "test-wcset: %d failures\n", failed);
+    return 1;
+  }
+
+  return 0;
+}